@@ -75,6 +75,16 @@ void adc_enable(void) {
 
 }    
 
+// Enable ADC and start the primer conversion without waiting for it to finish.
+// Call adc_startConversion() once it is done (~200us later) to start the first real conversion.
+
+void adc_enableNoWait(void) {
+	
+	SBI(ADCSRA, ADEN);
+	SBI( ADCSRA , ADSC);             // Kick off a primer conversion (the initial one is noisy)
+	
+}
+
 // Disable and power down the ADC to save power
 
 void adc_disable(void) {
@@ -99,7 +109,16 @@ uint8_t adc_readLastVccX10(void) {              // Return Vcc x10
 	
 	while (TBI(ADCSRA,ADSC)) ;       // Wait for any pending conversion to complete
 
-	uint8_t lastReading = (11 / ADCH);      // Remember the result from the last reading.
+	// We are measuring the 1.1V bandgap against Vcc, so ADCH = 1.1V / Vcc * 256.
+	// That makes Vcc*10 = 11 * 256 / ADCH.
+	
+	uint8_t adch = ADCH;
+	
+	if (adch < 12 ) {                   // Can't happen with a real bandgap, but don't divide by zero or overflow
+		return 255;
+	}
+	
+	uint8_t lastReading = ( (11 * 256) / adch );      // Remember the result from the last reading.
 	
 	return( lastReading  );
 	
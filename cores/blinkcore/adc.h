@@ -18,6 +18,11 @@ void adc_init(void);
 
 void adc_enable(void);
 
+// Enable ADC and start the primer conversion without waiting for it to finish.
+// Call adc_startConversion() once it is done (~200us later) to start the first real conversion.
+
+void adc_enableNoWait(void);
+
 // Start a new conversion. Read the result ~1ms later by calling adc_readLastVccX10().
 // 1ms is safe, but if you need faster then conversion will actually be ready in
 // 13 CPU cycles * ADC prescaller (25 cycles for 1st conversion)
@@ -0,0 +1,106 @@
+/*
+ * gamma.h
+ *
+ * Builds the 32 entry brightness level -> raw PWM tables for each color at compile time.
+ *
+ * Each color gets a curve made of raw PWM values at evenly spaced brightness levels. The first point is level 0
+ * (always 255=off) and the last is level 31 (full on). You can give as few as 2 points or as many as 32. Levels that
+ * fall between points get linearly interpolated between the two nearest ones.
+ *
+ * Use the pixelNormalizer sketch in libraries/blinklib/utils to step though the raw values of one color while
+ * you measure the brightness with a meter. Then for each point, pick the raw value that gives the brightness you
+ * want for that level, and put the list in PIXEL_GAMMA_R, PIXEL_GAMMA_G, or PIXEL_GAMMA_B (in build.extra_flags or
+ * before pixel.cpp includes this file).
+ *
+ * Colors with exactly the same points share a single table in flash.
+ *
+ */
+
+#ifndef GAMMA_H_
+#define GAMMA_H_
+
+#include <avr/pgmspace.h>
+
+// Adafruit's gamma 2.8 table, compressed down to 32 entries, normalized for our raw values that start at 255 off.
+// https://learn.adafruit.com/led-tricks-gamma-correction/the-quick-fix
+
+#define PIXEL_GAMMA_DEFAULT 255,254,253,251,250,248,245,242,238,234,230,224,218,211,204,195,186,176,165,153,140,126,111,95,78,59,40,19,13,9,3,1
+
+// No color has a measured curve yet, so all three use this one and share a single table. That means the colors are
+// NOT calibrated against each other. Blue in particular goes though the charge pump, so its real brightness curve
+// is likely quite different. Per color curves only help once someone measures them with pixelNormalizer.
+
+#ifndef PIXEL_GAMMA_R
+    #define PIXEL_GAMMA_R PIXEL_GAMMA_DEFAULT
+#endif
+
+#ifndef PIXEL_GAMMA_G
+    #define PIXEL_GAMMA_G PIXEL_GAMMA_DEFAULT
+#endif
+
+#ifndef PIXEL_GAMMA_B
+    #define PIXEL_GAMMA_B PIXEL_GAMMA_DEFAULT
+#endif
+
+#define GAMMA_LEVEL_COUNT 32
+
+// Pick the nth value out of a list. No std::tuple here, so we recurse.
+
+constexpr uint8_t gammaNthPoint( uint8_t , uint8_t first ) {
+    return first;
+}
+
+template <typename... T> constexpr uint8_t gammaNthPoint( uint8_t n , uint8_t first , T... rest ) {
+    return n==0 ? first : gammaNthPoint( n-1 , rest... );
+}
+
+// A curve is just its list of points. Two colors with the same points are the same type, which is what
+// lets them share a table.
+
+template <uint8_t... Points> struct GammaCurve {
+
+    static_assert( sizeof...(Points) >= 2 && sizeof...(Points) <= GAMMA_LEVEL_COUNT , "A gamma curve needs between 2 and 32 points" );
+
+    // Where `level` falls between the points, in 8.8 fixed point
+
+    static constexpr uint16_t position( uint8_t level ) {
+        return ( (uint32_t) level * ( sizeof...(Points) - 1 ) * 256 ) / ( GAMMA_LEVEL_COUNT - 1 );
+    }
+
+    static constexpr uint8_t interpolate( uint8_t a , uint8_t b , uint8_t frac ) {
+        return ( a * (256 - frac) + b * frac + 128 ) / 256;
+    }
+
+    static constexpr uint8_t raw( uint8_t level ) {
+        return ( position( level ) & 0xff ) == 0 ?
+            gammaNthPoint( position( level ) >> 8 , Points... ) :
+            interpolate( gammaNthPoint( position( level ) >> 8 , Points... ) , gammaNthPoint( ( position( level ) >> 8 ) + 1 , Points... ) , position( level ) & 0xff );
+    }
+
+};
+
+// Generates the list 0..N-1 so we can expand one table entry per level
+
+template <uint8_t... I> struct GammaLevels {};
+
+template <uint8_t N, uint8_t... I> struct GammaMakeLevels : GammaMakeLevels< N-1 , N-1 , I... > {};
+
+template <uint8_t... I> struct GammaMakeLevels<0, I...> {
+    typedef GammaLevels<I...> type;
+};
+
+template <typename Curve, typename Levels = typename GammaMakeLevels<GAMMA_LEVEL_COUNT>::type> struct GammaTable;
+
+template <typename Curve, uint8_t... I> struct GammaTable< Curve , GammaLevels<I...> > {
+    static const uint8_t table[ GAMMA_LEVEL_COUNT ];
+};
+
+template <typename Curve, uint8_t... I> const uint8_t GammaTable< Curve , GammaLevels<I...> >::table[ GAMMA_LEVEL_COUNT ] PROGMEM = {
+    Curve::raw( I )...
+};
+
+typedef GammaCurve< PIXEL_GAMMA_R > gammaCurveR;
+typedef GammaCurve< PIXEL_GAMMA_G > gammaCurveG;
+typedef GammaCurve< PIXEL_GAMMA_B > gammaCurveB;
+
+#endif /* GAMMA_H_ */
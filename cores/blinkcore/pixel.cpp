@@ -44,6 +44,8 @@
 #include <string.h>             // memcpy()
 
 #include "pixel.h"
+#include "gamma.h"
+#include "adc.h"
 #include "utils.h"
 
 #include "callbacks.h"
@@ -60,6 +62,11 @@ typedef struct  {
     uint8_t rawValueR;
     uint8_t rawValueG;
     uint8_t rawValueB;
+    #if PIXEL_DITHER
+        uint16_t ditherR:3;         // How many frames out of 8 to show the raw value one step brighter
+        uint16_t ditherG:3;
+        uint16_t ditherB:3;
+    #endif
 } rawpixel_t;
 
 // We need these struct gymnastics because C fixed array typedefs do not work 
@@ -71,14 +78,23 @@ typedef struct {
 } rawpixelset_t;    
 
 // Double buffer the raw pixels so we can switch quickly and atomically
+// With triple buffering there is also a finished frame waiting for the ISR, so the foreground never has to wait.
 
-#define RAW_PIXEL_SET_BUFFER_COUNT 2
+#if PIXEL_TRIPLE_BUFFER
+    #define RAW_PIXEL_SET_BUFFER_COUNT 3
+#else
+    #define RAW_PIXEL_SET_BUFFER_COUNT 2
+#endif
 
 static rawpixelset_t rawpixelsetbuffer[RAW_PIXEL_SET_BUFFER_COUNT];
 
 static rawpixelset_t *displayedRawPixelSet=&rawpixelsetbuffer[0];        // Currently being displayed
 static rawpixelset_t *bufferedRawPixelSet =&rawpixelsetbuffer[1];        // Benignly Updateable 
 
+#if PIXEL_TRIPLE_BUFFER
+    static rawpixelset_t * volatile readyRawPixelSet=&rawpixelsetbuffer[2];    // Newest finished frame. Swapped in by the ISR at the end of the frame if pendingRawPixelBufferSwap is set.
+#endif
+
 static void setupPixelPins(void) {
 
 	// TODO: Compare power usage for driving LOW with making input. Maybe slight savings because we don't have to drain capacitance each time? Probably not noticable...
@@ -269,6 +285,8 @@ static void setupTimers(void) {
 
 }
 
+static void compileFrameSchedule(void);
+
 void pixel_init(void) {
     
     // First initialize the buffers
@@ -278,49 +296,20 @@ void pixel_init(void) {
             rawpixelset->rawpixels[j].rawValueR = 255;
             rawpixelset->rawpixels[j].rawValueG = 255;
             rawpixelset->rawpixels[j].rawValueB = 255;
+            #if PIXEL_DITHER
+                rawpixelset->rawpixels[j].ditherR = 0;
+                rawpixelset->rawpixels[j].ditherG = 0;
+                rawpixelset->rawpixels[j].ditherB = 0;
+            #endif
         }                
     }    
             
+    compileFrameSchedule();
+            
 	setupPixelPins();
 	setupTimers();
 }
 
-// Note that LINE is 0-5 whereas the pixels are labeled p1-p6 on the board. 
-
-static void activateAnode( uint8_t line ) {         
-    
-    // TODO: These could probably be compressed with some bit hacking
-    
-    switch (line) {
-        
-        case 0:
-            SBI( PIXEL0_PORT , PIXEL0_BIT );
-            break;
-        
-        case 1:
-            SBI( PIXEL1_PORT , PIXEL1_BIT );
-            break;
-        
-        case 2:
-            SBI( PIXEL2_PORT , PIXEL2_BIT );
-            break;
-            
-        case 3:
-            SBI( PIXEL3_PORT , PIXEL3_BIT );
-            break;
-        
-        case 4:
-            SBI( PIXEL4_PORT , PIXEL4_BIT );
-            break;           
-
-        case 5:
-            SBI( PIXEL5_PORT , PIXEL5_BIT );
-            break;
-        
-    }
-    
-}
-
 // Deactivate all anodes. Faster to blindly do all of them than to figure out which is
 // is currently on and just do that one. 
 
@@ -336,28 +325,6 @@ static void deactivateAnodes(void) {
             
 }
 
-/*
-
-volatile uint8_t vccAboveBlueFlag=0;        // Is the battery voltage higher than the blue LED forward voltage?
-                                            // If so, then we need a different strategy to dim since the LED
-											// will always be on Even when the pump is not pushing. 
-											// Instead we will do straight PWM on the SINK. 
-											// For now, there are only two modes to keep it simple.
-											// TODO: Take into account the brightness level and the Vcc and pick which is the most efficient dimming
-											// strategy cycle-by-cycle. 
-
-#define BLUE_LED_THRESHOLD_V 2.6
-
-void updateVccFlag(void) {                  // Set the flag based on ADC check of the battery voltage. Don't have to do more than once per minute.
-	vccAboveBlueFlag = (adc_lastVccX10() > BLUE_LED_THRESHOLD_V);	
-	vccAboveBlueFlag = 1;	
-}
-
-*/
-
-                                     
-static uint8_t currentPixelIndex;      // Which pixel are we on now?
-
 // Each pixel has 5 phases -
 // 0=Charging blue pump. All anodes are low. 
 // 1=Resting after pump charge. Get ready to show blue.
@@ -373,12 +340,591 @@ static uint8_t currentPixelIndex;      // Which pixel are we on now?
 
 static uint8_t phase=0;
 
+#if PIXEL_TICKS_PER_PHASE > 1
+    static uint8_t phaseTicks=0;                // Timer overflows into the current phase
+#endif
+
 // To swap the display buffer, you set this and then wait until it is unset by the 
 // background display ISR
 // This makes display updates atomic, and swaps always happen between frames to avoid tearing and aliasing
+// With triple buffering nobody waits. It just means there is a new frame in readyRawPixelSet.
 
 static volatile uint8_t pendingRawPixelBufferSwap =0;
 
+// One bit per pixel that has changed in the buffer since the last pixel_displayBufferedPixels()
+// If nothing changed then there is nothing to swap or copy.
+
+static uint8_t dirtyPixelMask =0;
+
+// The color each pixel in the buffer was last set to, packed 5:5:5 like a blinklib Color. This is the only copy,
+// blinklib reads it back for getColorOnFace().
+// Lets us skip the gamma lookups when the same color is set again. Pixels set any way other than pixel_bufferedSetPixel()
+// get the inexact flag along with the nearest color we know (OFF for raw values), so they never match and this can
+// never hide a change. Pixels power up off, which is 0.
+
+#define PIXEL_COLOR_INEXACT 0x8000
+
+static uint16_t bufferedPixelColors[PIXEL_COUNT];
+
+// The level -> raw tables are generated at compile time from the curves in gamma.h.
+// Colors with the same curve get the very same table, so by default all three share one.
+
+static const uint8_t * const gamma8R = GammaTable< gammaCurveR >::table;
+static const uint8_t * const gamma8G = GammaTable< gammaCurveG >::table;
+static const uint8_t * const gamma8B = GammaTable< gammaCurveB >::table;
+
+// Map a brightness level in 5.3 fixed point (0-248, so the top 5 bits index the gamma table) to a raw value
+// by interpolating between the two nearest gamma table entries.
+// With PIXEL_DITHER, the raw value is rounded to the dimmer side and *dither gets how many frames out of 8 to show it
+// one step brighter. Without it, we just round to the nearest raw value.
+
+static uint8_t levelToRaw( const uint8_t *gammaTable , uint8_t level , uint8_t *dither ) {
+    
+    uint8_t index = level >> 3;
+    uint8_t frac  = level & 7;
+    
+    uint8_t a = pgm_read_byte( &gammaTable[index] );
+    
+    *dither = 0;
+    
+    if (!frac) {
+        return a;                           // Right on a table entry. Also keeps us from reading past the end of the table.
+    }
+    
+    uint8_t b = pgm_read_byte( &gammaTable[index+1] );      // Brighter, so smaller
+    
+    uint16_t rawfp = (a<<3) - ( (a-b) * frac );             // Raw value in 8.3 fixed point
+    
+    #if PIXEL_DITHER
+    
+        uint8_t raw = (rawfp + 7) >> 3;
+        *dither = (raw<<3) - rawfp;
+        return raw;
+    
+    #else
+    
+        return (rawfp + 4) >> 3;
+        
+    #endif
+    
+}
+
+static void levelsToRawPixel( rawpixel_t *rawpixel , uint8_t levelR , uint8_t levelG , uint8_t levelB ) {
+    
+    uint8_t dither;
+    
+    rawpixel->rawValueR = levelToRaw( gamma8R , levelR , &dither );
+    #if PIXEL_DITHER
+        rawpixel->ditherR = dither;
+    #endif
+    
+    rawpixel->rawValueG = levelToRaw( gamma8G , levelG , &dither );
+    #if PIXEL_DITHER
+        rawpixel->ditherG = dither;
+    #endif
+    
+    rawpixel->rawValueB = levelToRaw( gamma8B , levelB , &dither );
+    #if PIXEL_DITHER
+        rawpixel->ditherB = dither;
+    #endif
+    
+}
+
+// Which anode goes with each pixel. Only read when compiling a frame schedule.
+
+typedef struct {
+    volatile uint8_t *port;
+    uint8_t mask;
+} anode_t;
+
+static const anode_t PROGMEM anodes[PIXEL_COUNT] = {
+    { &PIXEL0_PORT , _BV( PIXEL0_BIT ) },
+    { &PIXEL1_PORT , _BV( PIXEL1_BIT ) },
+    { &PIXEL2_PORT , _BV( PIXEL2_BIT ) },
+    { &PIXEL3_PORT , _BV( PIXEL3_BIT ) },
+    { &PIXEL4_PORT , _BV( PIXEL4_BIT ) },
+    { &PIXEL5_PORT , _BV( PIXEL5_BIT ) },
+};
+
+// The order we scan the faces in
+
+#if PIXEL_SCAN_INTERLEAVED
+
+static const uint8_t PROGMEM scanOrder[PIXEL_COUNT] = { 0, 2, 4, 1, 3, 5 };
+
+#define SCAN_PIXEL(n) pgm_read_byte( &scanOrder[n] )
+
+#else
+
+#define SCAN_PIXEL(n) (n)
+
+#endif
+
+// How many timer overflows in one full 6 pixel frame. Fades and the frame callback run on this beat
+// so they keep the same pace even when PIXEL_ADAPTIVE_SCAN makes the frames shorter.
+
+#define PIXEL_FRAME_TICKS (TIMER_PHASE_COUNT * PIXEL_COUNT * PIXEL_TICKS_PER_PHASE)
+
+static uint8_t frameTicks=0;            // Timer overflows since the last full frame
+
+static uint8_t frameCallbackFlag=0;     // A full frame finished, so call pixel_callback_onFrame() on the way out of the ISR
+
+#if PIXEL_FADE
+
+typedef struct {
+    uint16_t value[3];          // Current r,g,b brightness in 5.11 fixed point, so full on is 31<<11
+    int16_t  step[3];           // Added to value every fade step
+    uint16_t stepsLeft;
+} pixelfade_t;
+
+static pixelfade_t pixelFades[PIXEL_COUNT];
+
+// One bit per pixel with a fade running. The ISR clears the bit when the fade finishes.
+
+static volatile uint8_t fadingPixelMask =0;
+
+
+static void stepFades(void) {
+    
+    for( uint8_t p=0; p<PIXEL_COUNT; p++ ) {
+        
+        if ( fadingPixelMask & _BV(p) ) {
+            
+            pixelfade_t *fade = &pixelFades[p];
+            
+            fade->value[0] += fade->step[0];
+            fade->value[1] += fade->step[1];
+            fade->value[2] += fade->step[2];
+            
+            if (--fade->stepsLeft == 0 ) {
+                
+                // Done. The displayed buffer already has the final color, so just stop overriding it.
+                
+                fadingPixelMask &= ~_BV(p);
+            }
+            
+        }
+        
+    }
+    
+}
+
+#endif
+
+// Battery
+
+#define PIXEL_VCC_SAMPLE_TICKS 2000         // Timer overflows between battery readings, ~1s
+
+static uint16_t vccTicks=0;                 // Timer overflows since the last reading
+static uint8_t vccSampleStep=0;             // Where we are in taking a reading
+
+static uint8_t vccX10=0;                    // Last reading. 0 until we get the first one.
+
+uint8_t pixel_getVccX10(void) {
+    return vccX10;
+}
+
+#define PIXEL_VCC_SCALING ( PIXEL_VCC_COMPENSATION || PIXEL_LOW_VCC_X10 )
+
+#if PIXEL_VCC_SCALING || PIXEL_POWER_BUDGET_MA_X10
+
+// Cut the on time of a raw value down to scale/256 of what it was
+
+static uint8_t scaleRaw( uint8_t raw , uint16_t scale ) {
+    return 255 - ( ( (uint16_t) (255 - raw) * scale ) >> 8 );
+}
+
+#endif
+
+#if PIXEL_VCC_SCALING
+
+// How much of each color's duty cycle to keep, 256=all of it. Applied when compiling the frame.
+
+static uint16_t channelScales[3] = { 256 , 256 , 256 };
+
+static uint8_t channelScalingFlag=0;        // Is any scale less than 256?
+
+#if PIXEL_VCC_COMPENSATION
+
+// How bright a color is now compared to on a fresh battery, 256=same. LED current goes roughly with how far
+// the voltage it sees is above its forward voltage. 0 means the battery is too low to light it at all.
+
+static uint16_t vccRelativeBrightness( uint8_t boost , uint8_t vfX10 ) {
+    
+    int16_t headroom = ( boost * vccX10 ) - vfX10;
+    int16_t nominalHeadroom = ( boost * PIXEL_VCC_NOMINAL_X10 ) - vfX10;
+    
+    if (headroom < 1) {
+        return 0;
+    }
+    
+    return ( (uint16_t) headroom * 256 ) / nominalHeadroom;
+    
+}
+
+#endif
+
+static void updateChannelScales(void) {
+    
+    uint16_t scales[3] = { 256 , 256 , 256 };
+    
+    #if PIXEL_VCC_COMPENSATION
+    
+        uint16_t relative[3] = {
+            vccRelativeBrightness( 1 , PIXEL_VF_R_X10 ),
+            vccRelativeBrightness( 1 , PIXEL_VF_G_X10 ),
+            vccRelativeBrightness( 2 , PIXEL_VF_B_X10 ),          // Charge pump roughly doubles the voltage blue sees
+        };
+        
+        // Find the weakest color that still lights. Once a color is out completely there is no
+        // matching it, so we stop dragging the others down with it.
+        
+        uint16_t weakest = 0xffff;
+        
+        for( uint8_t c=0; c<3; c++ ) {
+            if ( relative[c] && relative[c] < weakest ) {
+                weakest = relative[c];
+            }
+        }
+        
+        // Turn everyone down to match the weakest color
+        
+        for( uint8_t c=0; c<3; c++ ) {
+            if ( relative[c] > weakest ) {
+                scales[c] = ( (uint32_t) weakest * 256 ) / relative[c];
+            }
+        }
+    
+    #endif
+    
+    #if PIXEL_LOW_VCC_X10
+    
+        if ( vccX10 < PIXEL_LOW_VCC_X10 ) {
+            
+            for( uint8_t c=0; c<3; c++ ) {
+                scales[c] = ( scales[c] * PIXEL_LOW_VCC_SCALE ) >> 8;
+            }
+        }
+    
+    #endif
+    
+    channelScalingFlag = 0;
+    
+    for( uint8_t c=0; c<3; c++ ) {
+        
+        channelScales[c] = scales[c];
+        
+        if ( scales[c] < 256 ) {
+            channelScalingFlag = 1;
+        }
+    }
+    
+}
+
+#endif
+
+#if PIXEL_BLUE_DIRECT_VCC_X10
+
+static uint8_t blueDirectFlag=0;            // Battery is high enough to light blue without the pump
+
+#else
+
+#define blueDirectFlag 0                    // Always use the pump
+
+#endif
+
+// Called between frames. Takes a reading over three calls, so the ADC never makes us wait.
+// Returns true if there is a new reading, so the frame needs to be recompiled.
+
+static uint8_t sampleVcc(void) {
+    
+    if (vccTicks < PIXEL_VCC_SAMPLE_TICKS) {
+        return 0;
+    }
+    
+    switch (vccSampleStep) {
+        
+        case 0:
+            adc_enableNoWait();                 // Primer conversion. Its result is noisy so we toss it.
+            vccSampleStep++;
+            return 0;
+            
+        case 1:
+            adc_startConversion();              // We are at least one timer overflow later, so the primer is done.
+            vccSampleStep++;
+            return 0;
+    }
+    
+    vccX10 = adc_readLastVccX10();
+    adc_disable();
+    
+    vccSampleStep=0;
+    vccTicks=0;
+    
+    #if PIXEL_BLUE_DIRECT_VCC_X10
+        blueDirectFlag = ( vccX10 >= PIXEL_BLUE_DIRECT_VCC_X10 );
+    #endif
+    
+    #if PIXEL_VCC_SCALING
+        updateChannelScales();
+        return 1;
+    #else
+        return 0;
+    #endif
+    
+}
+
+// The displayed frame compiled down to one step per pixel, holding everything the ISR needs for that pixel
+// so it does not have to work anything out while scanning. Rebuilt from displayedRawPixelSet each time
+// a new frame is swapped in.
+
+typedef struct {
+    volatile uint8_t *anodePort;    // Port with this pixel's anode
+    uint8_t anodeMask;              // ...and its bit in that port
+    uint8_t blueOn;                 // Do we need to charge the pump and connect the blue PWM pin?
+    uint8_t rawValueR;
+    uint8_t rawValueG;
+    uint8_t rawValueB;
+    #if PIXEL_DITHER
+        uint8_t ditherR;
+        uint8_t ditherG;
+        uint8_t ditherB;
+    #endif
+} pixelstep_t;
+
+static pixelstep_t frameSchedule[PIXEL_COUNT];
+
+static pixelstep_t *currentStep = frameSchedule;                   // Which pixel are we on now?
+static pixelstep_t *frameScheduleEnd = frameSchedule;              // One past the last step in this frame
+
+// Power
+
+#define PIXEL_POWER_ESTIMATE ( PIXEL_POWER_BUDGET_MA_X10 || PIXEL_POWER_STATS )
+
+#if PIXEL_POWER_ESTIMATE
+
+// Average LED current of the compiled frame in mA*10. Each color is on for 1 of the 5 phases in its pixel's
+// turn, and then only for (255-raw)/256 of that phase. Every step in the schedule gets an equal turn.
+
+static uint16_t estimateFrameMilliampsX10(void) {
+    
+    uint8_t stepCount = frameScheduleEnd - frameSchedule;
+    
+    if (!stepCount) {
+        return 0;
+    }
+    
+    uint32_t sum=0;
+    
+    for( const pixelstep_t *step=frameSchedule; step<frameScheduleEnd; step++ ) {
+        sum += (uint32_t) ( 255 - step->rawValueR ) * PIXEL_LED_MA_X10_R;
+        sum += (uint32_t) ( 255 - step->rawValueG ) * PIXEL_LED_MA_X10_G;
+        sum += (uint32_t) ( 255 - step->rawValueB ) * PIXEL_LED_MA_X10_B;
+    }
+    
+    return sum / ( 256UL * TIMER_PHASE_COUNT * stepCount );
+    
+}
+
+#endif
+
+#if PIXEL_POWER_BUDGET_MA_X10
+
+// Scale the whole compiled frame down so it fits in the budget. Every color gets the same scale
+// so the frame keeps its colors and just gets dimmer.
+
+static void limitFramePower(void) {
+    
+    uint16_t milliampsX10 = estimateFrameMilliampsX10();
+    
+    if ( milliampsX10 <= PIXEL_POWER_BUDGET_MA_X10 ) {
+        return;
+    }
+    
+    uint16_t scale = ( (uint32_t) PIXEL_POWER_BUDGET_MA_X10 * 256 ) / milliampsX10;
+    
+    for( pixelstep_t *step=frameSchedule; step<frameScheduleEnd; step++ ) {
+        step->rawValueR = scaleRaw( step->rawValueR , scale );
+        step->rawValueG = scaleRaw( step->rawValueG , scale );
+        step->rawValueB = scaleRaw( step->rawValueB , scale );
+    }
+    
+}
+
+#endif
+
+#if PIXEL_POWER_STATS
+
+// 1uAh is 3.6mA for a second, so this many timer overflows at 0.1mA. Doubled because it comes out to x.5 at 4Mhz.
+
+#define PIXEL_POWER_X2_PER_UAH ( ( 2UL * 36 * F_CPU ) / TIMER_CYCLES_PER_TICK )
+
+static volatile uint16_t frameMilliampsX10=0;      // Estimate for the frame being shown now
+static uint32_t powerTicksX2=0;                    // Charge used towards the next uAh, in overflows at 0.05mA
+static volatile uint32_t microampHours=0;
+
+uint16_t pixel_getEstimatedMilliampsX10(void) {
+    
+    uint16_t milliampsX10;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        milliampsX10 = frameMilliampsX10;
+    }
+    
+    return milliampsX10;
+}
+
+uint32_t pixel_getEstimatedMicroampHours(void) {
+    
+    uint32_t uah;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uah = microampHours;
+    }
+    
+    return uah;
+}
+
+// Called on every timer overflow
+
+static void countPower(void) {
+    
+    powerTicksX2 += frameMilliampsX10 * 2;
+    
+    if (powerTicksX2 >= PIXEL_POWER_X2_PER_UAH) {
+        powerTicksX2 -= PIXEL_POWER_X2_PER_UAH;
+        microampHours++;
+    }
+    
+}
+
+#endif
+
+#if PIXEL_ISR_STATS
+
+#define PIXEL_ISR_STATS_EMPTY { 0 , 0 , 0 , 255 , 0 , 0 }
+
+static pixelIsrStats_t isrStats = PIXEL_ISR_STATS_EMPTY;
+
+void pixel_getIsrStats( pixelIsrStats_t *stats ) {
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *stats = isrStats;
+        isrStats = PIXEL_ISR_STATS_EMPTY;
+    }
+
+}
+
+// Called on every timer overflow with TCNT0 from before and after the pixel refresh
+
+static void countIsrTime( uint8_t start , uint8_t end ) {
+
+    uint8_t ticks = end - start;
+
+    isrStats.calls++;
+    isrStats.ticks += ticks;
+
+    if (ticks < isrStats.minTicks) {
+        isrStats.minTicks = ticks;
+    }
+
+    if (ticks > isrStats.maxTicks) {
+        isrStats.maxTicks = ticks;
+    }
+
+    if (end > isrStats.maxEndTick) {
+        isrStats.maxEndTick = end;
+    }
+
+}
+
+#endif
+
+// With PIXEL_ADAPTIVE_SCAN, dark pixels are left out of the schedule. If every pixel is dark then the schedule
+// is empty and the ISR idles.
+
+static void compileFrameSchedule(void) {
+
+    pixelstep_t *step = frameSchedule;
+
+    for( uint8_t n=0; n<PIXEL_COUNT; n++ ) {
+        
+        uint8_t p = SCAN_PIXEL(n);
+
+        rawpixel_t rawpixel = displayedRawPixelSet->rawpixels[p];
+        
+        #if PIXEL_FADE
+        
+            if ( fadingPixelMask & _BV(p) ) {               // A running fade overrides the buffer
+                
+                pixelfade_t *fade = &pixelFades[p];
+                
+                // Fade values are 5.11 so the top byte is already a 5.3 level
+                
+                levelsToRawPixel( &rawpixel , fade->value[0] >> 8 , fade->value[1] >> 8 , fade->value[2] >> 8 );
+                
+            }
+        
+        #endif
+
+        #if PIXEL_VCC_SCALING
+        
+            if (channelScalingFlag) {
+                rawpixel.rawValueR = scaleRaw( rawpixel.rawValueR , channelScales[0] );
+                rawpixel.rawValueG = scaleRaw( rawpixel.rawValueG , channelScales[1] );
+                rawpixel.rawValueB = scaleRaw( rawpixel.rawValueB , channelScales[2] );
+            }
+        
+        #endif
+
+        #if PIXEL_DITHER
+            uint8_t blueOn = ( rawpixel.rawValueB != 255 || rawpixel.ditherB );
+        #else
+            uint8_t blueOn = ( rawpixel.rawValueB != 255 );
+        #endif
+
+        #if PIXEL_ADAPTIVE_SCAN
+
+            #if PIXEL_DITHER
+                uint8_t lit = ( rawpixel.rawValueR != 255 || rawpixel.ditherR || rawpixel.rawValueG != 255 || rawpixel.ditherG || blueOn );
+            #else
+                uint8_t lit = ( rawpixel.rawValueR != 255 || rawpixel.rawValueG != 255 || blueOn );
+            #endif
+
+            if (!lit) {
+                continue;
+            }
+
+        #endif
+
+        step->anodePort = (volatile uint8_t *) pgm_read_word( &anodes[p].port );
+        step->anodeMask = pgm_read_byte( &anodes[p].mask );
+        step->blueOn    = blueOn;
+        step->rawValueR = rawpixel.rawValueR;
+        step->rawValueG = rawpixel.rawValueG;
+        step->rawValueB = rawpixel.rawValueB;
+        #if PIXEL_DITHER
+            step->ditherR = rawpixel.ditherR;
+            step->ditherG = rawpixel.ditherG;
+            step->ditherB = rawpixel.ditherB;
+        #endif
+
+        step++;
+
+    }
+
+    frameScheduleEnd = step;
+    
+    #if PIXEL_POWER_BUDGET_MA_X10
+        limitFramePower();
+    #endif
+    
+    #if PIXEL_POWER_STATS
+        frameMilliampsX10 = estimateFrameMilliampsX10();
+    #endif
+
+}
+
 // Need to compute timekeeping based off the pixel interrupt
 
 // This is hard coded into the Timer setup code in pixels.cpp
@@ -399,6 +945,87 @@ static volatile uint8_t pendingRawPixelBufferSwap =0;
 // 6 pixels per frame
 // ... so one frame takes 6 * 2.5ms = ~15ms
 // ... so refresh rate is 1/15ms = ~66Hz
+// (With PIXEL_ADAPTIVE_SCAN only lit pixels count, so with 2 lit a frame is ~5ms = ~200Hz)
+// (With PIXEL_TICKS_PER_PHASE at 2 a phase is 1024us, so a frame is ~30ms = ~33Hz)
+
+// Show the newest finished frame. Only called from the ISR between frames.
+
+static void swapDisplayedRawPixelSet(void) {
+    
+    rawpixelset_t *temp;
+    
+    // Quickly swap the display and buffer sets                    
+    temp = displayedRawPixelSet;
+    
+    #if PIXEL_TRIPLE_BUFFER
+        displayedRawPixelSet = readyRawPixelSet;
+        readyRawPixelSet = temp;
+    #else
+        displayedRawPixelSet = bufferedRawPixelSet;
+        bufferedRawPixelSet = temp;
+    #endif
+    
+    pendingRawPixelBufferSwap=0;
+    
+}
+
+#if PIXEL_DITHER
+
+// Which frames get the brighter raw value. A pixel with dither d is brighter in the frames where d > threshold,
+// so d frames out of every 8. Bit reversed order spreads those frames out as evenly as we can.
+
+static const uint8_t PROGMEM ditherThresholds[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+static uint8_t ditherFrame=0;
+static uint8_t ditherThreshold=0;
+
+// The raw value to load for this frame
+
+#define DITHERED( raw , dither ) ( (raw) - ( (dither) > ditherThreshold ) )
+
+#else
+
+#define DITHERED( raw , dither ) (raw)
+
+#endif
+
+// Called between frames (and on every overflow while idle) to pick up any new frame and step the fades
+
+static void endFrame(void) {
+    
+    #if PIXEL_DITHER
+        ditherFrame++;
+        ditherThreshold = pgm_read_byte( &ditherThresholds[ ditherFrame & 7 ] );
+    #endif
+    
+    uint8_t changed = sampleVcc();
+    
+    if (pendingRawPixelBufferSwap) {
+        swapDisplayedRawPixelSet();
+        changed=1;
+    }
+    
+    if (frameTicks >= PIXEL_FRAME_TICKS) {
+        
+        frameTicks -= PIXEL_FRAME_TICKS;          // Keep the remainder so we keep time even when frames are shorter
+        
+        frameCallbackFlag=1;
+        
+        #if PIXEL_FADE
+        
+            if (fadingPixelMask) {
+                stepFades();
+                changed=1;
+            }
+            
+        #endif
+    }
+    
+    if (changed) {
+        compileFrameSchedule();
+    }
+    
+}
 
 // Called every time pixel timer0 overflows
 // Since OCR PWM values only get loaded from buffers at overflow by the AVR, 
@@ -411,8 +1038,45 @@ static void pixel_isr(void) {
     // THIS IS COMPLICATED
     // Because of the buffering of the OCR registers, we are always setting values that will be loaded
     // the next time the timer overflows. 
+    
+    frameTicks++;
+    
+    vccTicks++;
+    
+    #if PIXEL_POWER_STATS
+        countPower();
+    #endif
+    
+    #if PIXEL_TICKS_PER_PHASE > 1
+    
+        // Only step the display on every PIXEL_TICKS_PER_PHASE overflows. The OCRs just reload the same values
+        // in between, so whatever is lit stays lit.
+    
+        if (++phaseTicks < PIXEL_TICKS_PER_PHASE) {
+            return;
+        }
+        
+        phaseTicks=0;
+        
+    #endif
+    
+    #if PIXEL_ADAPTIVE_SCAN
+    
+        if (currentStep==frameScheduleEnd) {        // Every pixel is dark, so there is nothing to scan
+            
+            // The last lit pixel's green finished at this overflow, so now we can turn off its anode.
+            // All the OCRs are at 255 (off), so phase 0 is ready to go as soon as something is lit.
+            
+            deactivateAnodes();
+            
+            endFrame();
+            
+            return;
+        }
+    
+    #endif
                     
-    rawpixel_t *currentPixel = &(displayedRawPixelSet->rawpixels[currentPixelIndex]);      // TODO: cache this and eliminate currentPixel since buffer only changes at end of frame
+    const pixelstep_t *step = currentStep;
         
     switch (phase) {
         
@@ -424,7 +1088,7 @@ static void pixel_isr(void) {
             // Connect the timer to the output pin. 
             // It might have been disconnected on the the pixel if that pixel did not have any blue in it. 
             
-            if ( currentPixel->rawValueB != 255 ) {          // Is blue on for this pixel?
+            if ( step->blueOn ) {                               // Is blue on for this pixel?
                 
                 // Connect the timer to the PWM pin
                 // Otherwise it floats to prevent current from leaking though the cap
@@ -443,12 +1107,13 @@ static void pixel_isr(void) {
                 SBI( LED_B_DDR , LED_B_BIT );                // Drive BLUE LED output pin - which is high when the LED is not being PWMed.
 
             
-                SBI( BLUE_SINK_DDR , BLUE_SINK_BIT );        // Enable output on sink pin. Since this pin port is always 0, this will drive it low.
+                if (!blueDirectFlag) {                       // If the battery can light blue on its own, then no need to charge the pump
+                    
+                    SBI( BLUE_SINK_DDR , BLUE_SINK_BIT );    // Enable output on sink pin. Since this pin port is always 0, this will drive it low.
                                                              // Allows capacitor charge though the diode
+                }
                                     
                 // Ok, now the pump capacitor is charging.  No LEDs are on.
-                                    
-                // TODO: Handle the case where battery is high enough to drive blue directly and skip the pump
                 
             }                
             
@@ -480,13 +1145,18 @@ static void pixel_isr(void) {
             // A little current will flow now though the capactor, but that ok. 
             // when the PWM goes low, then the boost will kick in and make the BLUE really light
                     
-            activateAnode( currentPixelIndex );
+            // The IR LED anodes share these ports and get changed from inside the nested timer ISRs,
+            // so this read-modify-write must not be interrupted
+            
+            ATOMIC_BLOCK(ATOMIC_FORCEON) {
+                *step->anodePort |= step->anodeMask;
+            }
         
             // Ok, now we are ready for all the PWMing to happen on this pixel 
 
             // Load up the blue PWM to go low and show blue (if the pump and PWM were activeated in phase #0)....        
         
-            OCR2B=currentPixel->rawValueB;             // Load OCR to turn on blue at next overflow
+            OCR2B=DITHERED( step->rawValueB , step->ditherB );             // Load OCR to turn on blue at next overflow
         
             phase++;
         
@@ -500,7 +1170,7 @@ static void pixel_isr(void) {
                            
                 
             OCR2B = 255;                        // Load OCR to turn off blue at next overflow
-            OCR0A = currentPixel->rawValueR;    // Load OCR to turn on red at next overflow
+            OCR0A = DITHERED( step->rawValueR , step->ditherR );    // Load OCR to turn on red at next overflow
 
             phase++;           
             break;
@@ -535,7 +1205,7 @@ static void pixel_isr(void) {
         
                                     
             OCR0A = 255;                        // Load OCR to turn off red at next overflow
-            OCR0B = currentPixel->rawValueG;    // Load OCR to turn on green at next overflow
+            OCR0B = DITHERED( step->rawValueG , step->ditherG );    // Load OCR to turn on green at next overflow
             
             phase++;
             break;
@@ -550,23 +1220,16 @@ static void pixel_isr(void) {
             
             phase=0;                            // Step to next pixel and start over
             
-            currentPixelIndex++;
+            currentStep++;
             
-            if (currentPixelIndex==PIXEL_COUNT) {
-                currentPixelIndex=0;
+            if (currentStep==frameScheduleEnd) {
+                currentStep=frameSchedule;
                 
-                if (pendingRawPixelBufferSwap) {
-                    
-                    rawpixelset_t *temp;
-                    
-                    // Quickly swap the display and buffer sets                    
-                    temp = displayedRawPixelSet;
-                    displayedRawPixelSet = bufferedRawPixelSet;
-                    bufferedRawPixelSet = temp;
-                    
-                    pendingRawPixelBufferSwap=0;
-                    
-                }                    
+                #if PIXEL_ISR_STATS
+                    isrStats.frames++;
+                #endif
+                
+                endFrame();
                                     
             }
                                             
@@ -610,6 +1273,24 @@ static void pixelTimerOff(void) {
 }
                          
             
+// Reentrant so if the frame callback runs longer than a frame, the frames that end in the meantime
+// get combined into one trailing call.
+
+struct ISR_CALLBACK_PIXEL_FRAME : CALLBACK_BASE<ISR_CALLBACK_PIXEL_FRAME> {
+    
+    static const uint8_t running_bit = CALLBACK_PIXEL_FRAME_RUNNING_BIT;
+    static const uint8_t pending_bit = CALLBACK_PIXEL_FRAME_PENDING_BIT;
+    
+    static inline void callback(void) {
+        
+        if (pixel_callback_onFrame) {           // Weak, so might not be there
+            pixel_callback_onFrame();
+        }
+        
+    }
+    
+};
+
 // Called when Timer0 overflows, which happens at the end of the PWM cycle for each pixel. We advance to the next pixel.
 
 // This fires every 500us (2Khz)
@@ -631,10 +1312,31 @@ ISR(TIMER0_OVF_vect)
     // Deal with the PWM stuff. There is a deadline here since we must get the new values
     // loaded into the double-buffered registers before the next overflow.
                                 
-    pixel_isr();
+    #if PIXEL_ISR_STATS
+
+        uint8_t isrStart = TCNT0;
+        pixel_isr();
+        countIsrTime( isrStart , TCNT0 );
+
+    #else
+
+        pixel_isr();
+
+    #endif
     
     timer_256us_callback_sei();    // Do the doubletime callback
     timer_512us_callback_sei();       // Do everything else non-timing sensitive. 
+    
+    // Last so that a slow frame callback can not hold up the timekeeping above.
+    // Interrupts off so a nested overflow can not also see the flag. They come back on with the reti.
+    
+    cli();
+    
+    if (frameCallbackFlag) {
+        frameCallbackFlag=0;
+        ISR_CALLBACK_PIXEL_FRAME::invokeCallback();
+    }
+    
     return;	
 }
 
@@ -672,9 +1374,13 @@ void pixel_disable(void) {
     // and turn on the next pixel while we are trying to turn them off. 
     
     pixelTimerOff();
-    
 
-    
+    // A battery reading may be halfway done with the ADC still on. Drop it so the ADC
+    // does not stay powered through sleep. The next reading starts over from the primer.
+
+    adc_disable();
+    vccSampleStep=0;
+
     // Ok, now all the anodes should be low so all LEDs off
     // and no timer running to turn any anodes back on
     
@@ -707,62 +1413,264 @@ void pixel_enable(void) {
 // This is mostly useful for utilities to find the pwm -> brightness mapping to be used
 // in the gamma lookup table below.
 
-void pixel_bufferedSetPixelRaw( uint8_t pixel, uint8_t r_pwm , uint8_t g_pwm , uint8_t b_pwm ) {
+static void bufferedSetRawPixel( uint8_t pixel, const rawpixel_t *newRawPixel ) {
+
+    #if PIXEL_FADE
+    
+        if ( fadingPixelMask & _BV(pixel) ) {           // Setting a pixel directly cancels any fade on it
+            
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                fadingPixelMask &= ~_BV(pixel);
+            }
+            
+        }
+    
+    #endif
 
     rawpixel_t *rawpixel = &(bufferedRawPixelSet->rawpixels[pixel]);
+    
+    if ( rawpixel->rawValueR != newRawPixel->rawValueR || rawpixel->rawValueG != newRawPixel->rawValueG || rawpixel->rawValueB != newRawPixel->rawValueB 
+         #if PIXEL_DITHER
+            || rawpixel->ditherR != newRawPixel->ditherR || rawpixel->ditherG != newRawPixel->ditherG || rawpixel->ditherB != newRawPixel->ditherB
+         #endif
+        ) {
         
-    rawpixel->rawValueR= r_pwm;
-    rawpixel->rawValueG= g_pwm;
-    rawpixel->rawValueB= b_pwm;
+        *rawpixel = *newRawPixel;
+        
+        dirtyPixelMask |= _BV( pixel );
+        
+    }        
+    
+    bufferedPixelColors[pixel] = PIXEL_COLOR_INEXACT;      // Callers that know the nearest color fill it in after
+    
+}
+
+void pixel_bufferedSetPixelRaw( uint8_t pixel, uint8_t r_pwm , uint8_t g_pwm , uint8_t b_pwm ) {
+
+    rawpixel_t rawpixel;
+    
+    rawpixel.rawValueR = r_pwm;
+    rawpixel.rawValueG = g_pwm;
+    rawpixel.rawValueB = b_pwm;
+    
+    #if PIXEL_DITHER
+        rawpixel.ditherR = 0;
+        rawpixel.ditherG = 0;
+        rawpixel.ditherB = 0;
+    #endif
+    
+    bufferedSetRawPixel( pixel , &rawpixel );
     
 }
 
+// 8 bits per channel. 0-255 maps onto levels 0-248 in 5.3 fixed point.
 
-// Gamma table courtesy of adafruit...
-// https://learn.adafruit.com/led-tricks-gamma-correction/the-quick-fix
-// Compressed down to 32 entries, normalized for our raw values that start at 255 off. 
+void pixel_bufferedSetPixel8( uint8_t pixel, uint8_t r , uint8_t g , uint8_t b ) {
+    
+    rawpixel_t rawpixel;
+    
+    uint8_t levelR = ( r * 249 ) >> 8;
+    uint8_t levelG = ( g * 249 ) >> 8;
+    uint8_t levelB = ( b * 249 ) >> 8;
+    
+    levelsToRawPixel( &rawpixel , levelR , levelG , levelB );
+    
+    bufferedSetRawPixel( pixel , &rawpixel );
+    
+    // Nearest of the 32 levels, rounded
+    
+    bufferedPixelColors[pixel] = PIXEL_COLOR_INEXACT | ( ( ( levelR + 4 ) >> 3 ) << 10 ) | ( ( ( levelG + 4 ) >> 3 ) << 5 ) | ( ( levelB + 4 ) >> 3 );
+    
+}
 
-// TODO: Possible that green and red are similar enough that we can combine them into one table and save some flash space
+static uint16_t packPixelColor( pixelColor_t color ) {
+    return ( color.r << 10 ) | ( color.g << 5 ) | color.b;
+}
 
-static const uint8_t PROGMEM gamma8R[32] = {
-    255,254,253,251,250,248,245,242,238,234,230,224,218,211,204,195,186,176,165,153,140,126,111,95,78,59,40,19,13,9,3,1
-};
+static pixelColor_t unpackPixelColor( uint16_t packed ) {
+    
+    pixelColor_t color;
+    
+    color.r = packed >> 10;         // The bit field drops the inexact flag
+    color.g = packed >> 5;
+    color.b = packed;
+    
+    return color;
+    
+}
 
-static const uint8_t PROGMEM gamma8G[32] = {
-    255,254,253,251,250,248,245,242,238,234,230,224,218,211,204,195,186,176,165,153,140,126,111,95,78,59,40,19,13,9,3,1
-};
+// Raw values for each palette entry, worked out when the entry is set. Left out by the linker if no one uses the palette.
+// Stored flipped (255-raw) so that the entries start out zeroed in BSS and that means off.
 
-static const uint8_t PROGMEM gamma8B[32] = {
-    255,254,253,251,250,248,245,242,238,234,230,224,218,211,204,195,186,176,165,153,140,126,111,95,78,59,40,19,13,9,3,1
-};
+static rawpixel_t paletteFlippedRawPixels[PIXEL_PALETTE_SIZE];
 
+// The color each entry was set to, packed like bufferedPixelColors[]
+
+static uint16_t paletteColors[PIXEL_PALETTE_SIZE];
+
+void pixel_setPaletteEntry( uint8_t index , pixelColor_t color ) {
+    
+    paletteColors[index] = packPixelColor( color );
+    
+    rawpixel_t *entry = &paletteFlippedRawPixels[index];
+    
+    levelsToRawPixel( entry , color.r << 3 , color.g << 3 , color.b << 3 );
+    
+    entry->rawValueR = ~entry->rawValueR;
+    entry->rawValueG = ~entry->rawValueG;
+    entry->rawValueB = ~entry->rawValueB;
+    
+}
+
+void pixel_bufferedSetPixelIndex( uint8_t pixel , uint8_t index ) {
+    
+    rawpixel_t rawpixel = paletteFlippedRawPixels[index];
+    
+    rawpixel.rawValueR = ~rawpixel.rawValueR;
+    rawpixel.rawValueG = ~rawpixel.rawValueG;
+    rawpixel.rawValueB = ~rawpixel.rawValueB;
+    
+    bufferedSetRawPixel( pixel , &rawpixel );
+    
+    bufferedPixelColors[pixel] = PIXEL_COLOR_INEXACT | paletteColors[index];
+    
+}
+
+pixelColor_t pixel_getPaletteEntry( uint8_t index ) {
+    return unpackPixelColor( paletteColors[index] );
+}
+
+pixelColor_t pixel_getBufferedPixel( uint8_t pixel ) {
+    return unpackPixelColor( bufferedPixelColors[pixel] );
+}
 
 // Update the pixel buffer.
 
 void pixel_bufferedSetPixel( uint8_t pixel, pixelColor_t newColor) {
 
-    // TODO: OMG, this could be so much more efficient by reducing the size of the gamma table 
-    // to 32 entries per color and having direct mapping to raw values. 
-    // We will do that when we normalize the colors. 
+    uint16_t packed = packPixelColor( newColor );
+    
+    if ( bufferedPixelColors[pixel] == packed ) {
+        return;                                     // Already there, or already fading there
+    }
 
-    rawpixel_t *rawpixel = &(bufferedRawPixelSet->rawpixels[pixel]);
+    pixel_bufferedSetPixelRaw( pixel , pgm_read_byte(&gamma8R[newColor.r]) , pgm_read_byte(&gamma8G[newColor.g]) , pgm_read_byte(&gamma8B[newColor.b]) );
     
-    rawpixel->rawValueR= pgm_read_byte(&gamma8R[newColor.r]);
-    rawpixel->rawValueG= pgm_read_byte(&gamma8G[newColor.g]);
-    rawpixel->rawValueB= pgm_read_byte(&gamma8B[newColor.b]);
+    bufferedPixelColors[pixel] = packed;
     
 }    
 
+#if PIXEL_FADE
+
+// Start a background fade. The ISR does the stepping at frame rate.
+
+void pixel_fadePixel( uint8_t pixel, pixelColor_t fromColor , pixelColor_t toColor , uint16_t steps ) {
+    
+    if ( bufferedPixelColors[pixel] == packPixelColor( toColor ) ) {
+        return;                                     // Already there, or already fading there
+    }
+    
+    uint16_t from[3] = { (uint16_t) (fromColor.r << 11) , (uint16_t) (fromColor.g << 11) , (uint16_t) (fromColor.b << 11) };
+    
+    pixelfade_t *fade = &pixelFades[pixel];
+        
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        
+        if ( fadingPixelMask & _BV(pixel) ) {       // Already fading, so pick up from where it is now
+            from[0] = fade->value[0];
+            from[1] = fade->value[1];
+            from[2] = fade->value[2];
+        }
+        
+    }
+    
+    pixel_bufferedSetPixel( pixel , toColor );      // Where we end up. This also stops any fade that was running.
+    
+    if (steps<2) {                                  // Nothing to fade though, so we can just go there
+        return;
+    }
+    
+    int16_t step[3] = {
+        (int16_t) ( ( (int32_t) (toColor.r << 11) - from[0] ) / steps ),
+        (int16_t) ( ( (int32_t) (toColor.g << 11) - from[1] ) / steps ),
+        (int16_t) ( ( (int32_t) (toColor.b << 11) - from[2] ) / steps ),
+    };
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        
+        for( uint8_t c=0; c<3; c++ ) {
+            fade->value[c] = from[c];
+            fade->step[c] = step[c];
+        }
+        
+        fade->stepsLeft = steps;
+        
+        fadingPixelMask |= _BV(pixel);
+        
+    }
+    
+}
+
+#endif
+
+#if PIXEL_TRIPLE_BUFFER
+
+// Hand the buffered pixels off to be displayed at the start of the next frame. Does not block.
+
+void pixel_displayBufferedPixels(void) {
+    
+    if (!dirtyPixelMask) {
+        return;                             // Same as the last frame, so nothing to do
+    }
+    
+    dirtyPixelMask = 0;
+    
+    rawpixelset_t *finished = bufferedRawPixelSet;
+    
+    // Trade the finished frame for the ready one. If the ISR has not picked up the ready one yet, 
+    // it is older than this one so we can just draw over it.
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        
+        bufferedRawPixelSet = readyRawPixelSet;
+        readyRawPixelSet = finished;
+        
+        pendingRawPixelBufferSwap = 1;      // Signal to background that there is a new frame
+        
+    }
+    
+    // Insure continuity by making sure the buffer starts off with the frame we just finished. 
+    // The ISR only ever reads it, so it is safe to copy from even if it gets swapped in while we are copying. 
+    memcpy( bufferedRawPixelSet , finished , sizeof( rawpixelset_t  ) );  
+        
+}    
+
+#else
+
 // Display the buffered pixels by swapping the buffer. Blocks until next frame starts.
 
 void pixel_displayBufferedPixels(void) {
     
+    if (!dirtyPixelMask) {
+        return;                             // Same as the last frame, so no need to wait for a swap
+    }
+    
     pendingRawPixelBufferSwap = 1;      // Signal to background that we want to swap buffers
     
     while (pendingRawPixelBufferSwap);  // wait for that to actually happen
     
     // Insure continuity by making sure that after the swap the (now) buffer starts 
-    // off with the same values that the old buffer ended with 
-    memcpy( bufferedRawPixelSet , displayedRawPixelSet , sizeof( rawpixelset_t  ) );  
+    // off with the same values that the old buffer ended with. 
+    // The two sets only differ in the pixels that changed, so those are all we need to copy.
+    
+    for( uint8_t p=0; p<PIXEL_COUNT; p++ ) {
+        if ( dirtyPixelMask & _BV(p) ) {
+            bufferedRawPixelSet->rawpixels[p] = displayedRawPixelSet->rawpixels[p];
+        }
+    }
+    
+    dirtyPixelMask = 0;
         
 }    
+
+#endif
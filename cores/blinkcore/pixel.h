@@ -31,6 +31,56 @@ void pixel_enable(void);
 
 void pixel_disable(void);
         
+/** Display profiles ***/
+
+// A profile picks defaults for the scan options below. Any option you set yourself (in build.extra_flags) still wins.
+// The timer itself is the same in every profile since millis() and the IR sampling run off it.
+
+//  PIXEL_PROFILE_LOW_CPU       The pixel ISR only does its work on every other timer overflow, and dark pixels
+//                              are skipped. Halves the display's share of the CPU but refreshes at ~33Hz, which
+//                              can flicker. Scans the faces out of order so the flicker is less noticeable.
+//  PIXEL_PROFILE_STANDARD      Every pixel every frame, ~66Hz. The default.
+//  PIXEL_PROFILE_HIGH_REFRESH  Dark pixels are skipped, so the refresh goes up to ~66Hz*6/lit pixels.
+//                              Scans out of order.
+
+#define PIXEL_PROFILE_LOW_CPU       1
+#define PIXEL_PROFILE_STANDARD      2
+#define PIXEL_PROFILE_HIGH_REFRESH  3
+
+#ifndef PIXEL_PROFILE
+    #define PIXEL_PROFILE PIXEL_PROFILE_STANDARD
+#endif
+
+#if PIXEL_PROFILE == PIXEL_PROFILE_LOW_CPU
+
+    #ifndef PIXEL_TICKS_PER_PHASE
+        #define PIXEL_TICKS_PER_PHASE 2
+    #endif
+    
+    #ifndef PIXEL_ADAPTIVE_SCAN
+        #define PIXEL_ADAPTIVE_SCAN 1
+    #endif
+    
+    #ifndef PIXEL_SCAN_INTERLEAVED
+        #define PIXEL_SCAN_INTERLEAVED 1
+    #endif
+
+#elif PIXEL_PROFILE == PIXEL_PROFILE_HIGH_REFRESH
+
+    #ifndef PIXEL_ADAPTIVE_SCAN
+        #define PIXEL_ADAPTIVE_SCAN 1
+    #endif
+    
+    #ifndef PIXEL_SCAN_INTERLEAVED
+        #define PIXEL_SCAN_INTERLEAVED 1
+    #endif
+
+#elif PIXEL_PROFILE != PIXEL_PROFILE_STANDARD
+
+    #error PIXEL_PROFILE must be PIXEL_PROFILE_LOW_CPU, PIXEL_PROFILE_STANDARD, or PIXEL_PROFILE_HIGH_REFRESH
+
+#endif
+
 /** Display interface ***/
 
 // Each pixel has 32 brightness levels for each of the three colors (red,green,blue)
@@ -42,11 +92,69 @@ typedef struct {
     uint8_t b:5;
 } pixelColor_t;
 
-// Update the pixel buffer. 
+// Update the pixel buffer. Setting a pixel to the color it already has is quick since it skips the gamma lookups.
 
 void pixel_bufferedSetPixel( uint8_t pixel, pixelColor_t newColor );
 
-// Display the buffered pixels. Blocks until next frame starts. 
+// Update the pixel buffer with 8 bits (0-255) per color. The raw values are interpolated between the entries
+// of the 32 level gamma tables, which gives finer steps wherever those entries are more than one raw value apart.
+
+void pixel_bufferedSetPixel8( uint8_t pixel, uint8_t r , uint8_t g , uint8_t b );
+
+// The color the pixel was last set to in the buffer. If it was set with 8 bits per color or from the palette you get the
+// nearest of the 32 levels, and if it was set with raw values you get off. A fading pixel gives the color it is fading to.
+
+pixelColor_t pixel_getBufferedPixel( uint8_t pixel );
+
+// With PIXEL_DITHER on, levels that fall between two raw values are shown by switching between the two from
+// frame to frame (up to 8 frames per cycle), so every 8 bit level and every fade step gets its own brightness.
+// Costs 2 bytes of RAM per pixel in each buffer and a few cycles in the ISR. The very dimmest levels can shimmer
+// a bit since one raw step there is a big change in brightness. Off by default.
+
+#ifndef PIXEL_DITHER
+    #define PIXEL_DITHER 0
+#endif
+
+// With PIXEL_TRIPLE_BUFFER on (the default), pixel_displayBufferedPixels() hands the finished frame off and returns
+// right away. The ISR always picks up the newest finished frame at the start of the next display frame, and
+// any older ones that it never got to are just skipped. This costs one extra buffer of RAM (3 bytes per pixel).
+
+// Set it to 0 (in build.extra_flags) to go back to double buffering, where pixel_displayBufferedPixels()
+// waits for the next frame to start. That paces loop() to the display at about 66Hz.
+
+#ifndef PIXEL_TRIPLE_BUFFER
+    #define PIXEL_TRIPLE_BUFFER 1
+#endif
+
+// With PIXEL_ADAPTIVE_SCAN on, the display only steps though the pixels that are lit in the frame being shown.
+// Dark pixels get no time at all, and when every pixel is dark the ISR does nothing but watch for the next frame.
+// The catch is that each lit pixel now gets 1/(number lit) of the time rather than 1/6, so a face looks brighter
+// when fewer faces are lit (up to 6x with only one lit). The refresh rate goes up the same way (~66Hz*6/lit).
+// Off by default so brightness stays the same as before.
+
+#ifndef PIXEL_ADAPTIVE_SCAN
+    #define PIXEL_ADAPTIVE_SCAN 0
+#endif
+
+// Each of the 5 phases of a pixel normally lasts one timer overflow (512us). With PIXEL_TICKS_PER_PHASE at 2,
+// the ISR only steps the display on every other overflow and each phase lasts two. The LEDs stay lit
+// for the same share of the time so brightness is about the same, but the refresh rate is halved. Blue can
+// come out a little dimmer since the pump only gets charged once for its two pulses.
+
+#ifndef PIXEL_TICKS_PER_PHASE
+    #define PIXEL_TICKS_PER_PHASE 1
+#endif
+
+// With PIXEL_SCAN_INTERLEAVED on, the faces are scanned in the order 0,2,4,1,3,5 so neighbors are never lit
+// one right after the other. Makes flicker at low refresh rates less noticeable.
+
+#ifndef PIXEL_SCAN_INTERLEAVED
+    #define PIXEL_SCAN_INTERLEAVED 0
+#endif
+
+// Display the buffered pixels. Blocks until next frame starts unless PIXEL_TRIPLE_BUFFER is on.
+// Either way the buffer starts out holding the frame just displayed, so you only need to set the pixels that change.
+// Returns right away without doing anything if no pixel changed since last time.
 
 void pixel_displayBufferedPixels(void);
 
@@ -58,13 +166,191 @@ void pixel_displayBufferedPixels(void);
 // interrupts generated by that timer combined with the number of
 // phases in the pixel ISR handler
 
-#define PIXEL_CYCLES_PER_FRAME (8 * 256 * 5)
+#define PIXEL_CYCLES_PER_FRAME (8 * 256 * 5 * PIXEL_TICKS_PER_PHASE)
 
-// Called at the end of each display frame, which is currently
-// about 66Hz
+// Called at the end of each full display frame, every PIXEL_CYCLES_PER_FADE_STEP cycles (about 66Hz).
+// A newly displayed buffer gets picked up at the start of the next frame.
+// Runs in the timer ISR with interrupts on, after the timekeeping is done. If it is still running when the
+// next frame ends, then it is called one more time when it returns rather than being reentered.
 
 void pixel_callback_onFrame(void) __attribute__((weak));
 
+/** Fade interface **/
+
+// The pixel ISR can fade pixels in the background so a smooth fade does not cost any time in loop()
+// and does not stutter when loop() is slow. Every pixel gets a 14 byte fade slot whether it is
+// fading or not, so this is off unless you set PIXEL_FADE to 1 (in build.extra_flags).
+// With it off, a fade just sets the pixel to the new color right away.
+
+#ifndef PIXEL_FADE
+    #define PIXEL_FADE 0
+#endif
+
+// Fades step once per this many cycles, which is one full 6 pixel frame (~15ms). This is also how often
+// pixel_callback_onFrame() gets called. It stays the same even when PIXEL_ADAPTIVE_SCAN makes the frames shorter.
+
+#define PIXEL_CYCLES_PER_FADE_STEP (PIXEL_CYCLES_PER_FRAME * PIXEL_COUNT)
+
+#if PIXEL_FADE
+
+// Fade a pixel from fromColor to toColor in `steps` fade steps. The buffer gets toColor right away, so
+// the pixel ends up there once pixel_displayBufferedPixels() is called and the fade finishes.
+// If the pixel is already fading, the new fade starts from wherever the old one got to rather than fromColor.
+// Setting the pixel any other way while it is fading cancels the fade, except that setting it to the color it is
+// already fading to just lets the fade carry on. Fading to the color the pixel already has (or is fading to) does nothing.
+
+void pixel_fadePixel( uint8_t pixel, pixelColor_t fromColor , pixelColor_t toColor , uint16_t steps );
+
+#endif
+
+/** Palette interface **/
+
+// Up to 16 colors can be converted to raw values ahead of time. Showing one of them on a pixel is then just a
+// copy, with no gamma lookups. The palette costs 3 bytes of RAM per entry (5 with PIXEL_DITHER), but only if you use it.
+
+#define PIXEL_PALETTE_SIZE 16
+
+// Set palette entry `index` (0-15). The pixel layer does not keep track of which pixels show which entry, so pixels
+// already showing this entry keep the old color until they are set again with pixel_bufferedSetPixelIndex().
+// blinklib's setPaletteColor() does that for every face showing the entry, so there they change right away.
+
+void pixel_setPaletteEntry( uint8_t index , pixelColor_t color );
+
+// The color palette entry `index` was last set to
+
+pixelColor_t pixel_getPaletteEntry( uint8_t index );
+
+// Update the pixel buffer with palette entry `index`. Entries start out off.
+
+void pixel_bufferedSetPixelIndex( uint8_t pixel , uint8_t index );
+
+/** Battery interface **/
+
+// The pixel ISR checks the battery voltage about once a second. The ADC is only powered up for the
+// couple of frames it takes to get each reading.
+
+// Returns the last battery reading in volts*10 (so 30 = 3.0V), or 0 if there has not been a reading yet.
+
+uint8_t pixel_getVccX10(void);
+
+// As the battery runs down, the LEDs with the highest forward voltage dim the fastest, so colors drift.
+// With PIXEL_VCC_COMPENSATION on, the other colors get turned down to match so colors stay the same
+// (just dimmer). The forward voltages below are nominal, so measure yours for best results.
+// Blue is boosted by the charge pump so it sees about twice the battery voltage.
+
+#ifndef PIXEL_VCC_COMPENSATION
+    #define PIXEL_VCC_COMPENSATION 0
+#endif
+
+#ifndef PIXEL_VCC_NOMINAL_X10
+    #define PIXEL_VCC_NOMINAL_X10 30            // Colors look right at this voltage
+#endif
+
+#ifndef PIXEL_VF_R_X10
+    #define PIXEL_VF_R_X10 18
+#endif
+
+#ifndef PIXEL_VF_G_X10
+    #define PIXEL_VF_G_X10 26
+#endif
+
+#ifndef PIXEL_VF_B_X10
+    #define PIXEL_VF_B_X10 30
+#endif
+
+// Below PIXEL_LOW_VCC_X10 every LED gets scaled by PIXEL_LOW_VCC_SCALE/256 to save what is left of the battery
+// and to keep the current peaks from browning out the chip. 0 turns this off.
+
+#ifndef PIXEL_LOW_VCC_X10
+    #define PIXEL_LOW_VCC_X10 0
+#endif
+
+#ifndef PIXEL_LOW_VCC_SCALE
+    #define PIXEL_LOW_VCC_SCALE 128
+#endif
+
+// At or above PIXEL_BLUE_DIRECT_VCC_X10 the battery can light blue by itself, so we skip charging the pump.
+// Saves the pump current, but blue will be somewhat dimmer than when boosted. 0 always uses the pump.
+
+#ifndef PIXEL_BLUE_DIRECT_VCC_X10
+    #define PIXEL_BLUE_DIRECT_VCC_X10 0
+#endif
+
+/** Power interface **/
+
+// Each LED only gets one of the 5 phases of its pixel's time, and the pixels take turns, so the average
+// current is well under what any one LED pulls. It is the average that runs down a coin cell and makes its
+// voltage sag, so that is what we estimate here. The estimate comes from the raw PWM values each time a new
+// frame gets shown, and the pump is just lumped in with blue.
+
+// Current each LED pulls while it is on, in mA*10. The pins are limited to about 20mA.
+
+#ifndef PIXEL_LED_MA_X10_R
+    #define PIXEL_LED_MA_X10_R 200
+#endif
+
+#ifndef PIXEL_LED_MA_X10_G
+    #define PIXEL_LED_MA_X10_G 200
+#endif
+
+#ifndef PIXEL_LED_MA_X10_B
+    #define PIXEL_LED_MA_X10_B 200
+#endif
+
+// Any frame that would average more than PIXEL_POWER_BUDGET_MA_X10 (in mA*10, so 60 = 6.0mA) gets all its
+// colors scaled down until it fits. Full white on all 6 pixels is about 12mA with the LED currents above.
+// 0 means no limit.
+
+#ifndef PIXEL_POWER_BUDGET_MA_X10
+    #define PIXEL_POWER_BUDGET_MA_X10 0
+#endif
+
+// With PIXEL_POWER_STATS on you can read back the estimates below. Costs 10 bytes of RAM and a 32 bit add
+// on every timer overflow. Off by default.
+
+#ifndef PIXEL_POWER_STATS
+    #define PIXEL_POWER_STATS 0
+#endif
+
+#if PIXEL_POWER_STATS
+
+// Estimated average LED current of the frame being shown now (after any budget scaling), in mA*10
+
+uint16_t pixel_getEstimatedMilliampsX10(void);
+
+// Estimated charge the LEDs have used since power up, in uAh (so 1000 = 1mAh)
+
+uint32_t pixel_getEstimatedMicroampHours(void);
+
+#endif
+
+// With PIXEL_ISR_STATS on, the timer overflow ISR reads TCNT0 before and after the pixel refresh, so you can see how
+// long it takes and how close it gets to the next overflow (which is when the new PWM values must be loaded).
+// Times are in Timer0 ticks of TIMER_PRESCALER (8) cycles. Interrupts are on during the refresh, so a time
+// can include an IR interrupt that landed in the middle of it. Also counts finished scans of the display, which
+// gives the refresh rate. Costs 11 bytes of RAM and about 40 cycles on every timer overflow. Off by default. See utils/displayBenchmark.cpp in blinklib.
+
+#ifndef PIXEL_ISR_STATS
+    #define PIXEL_ISR_STATS 0
+#endif
+
+#if PIXEL_ISR_STATS
+
+typedef struct {
+    uint16_t calls;             // Timer overflows counted
+    uint16_t frames;            // Full scans of the lit pixels
+    uint32_t ticks;             // Total time spent in the pixel refresh
+    uint8_t minTicks;           // Shortest refresh (255 if there were no calls)
+    uint8_t maxTicks;           // Longest refresh
+    uint8_t maxEndTick;         // Latest TCNT0 at the end of a refresh. Must stay under 256.
+} pixelIsrStats_t;
+
+// Copy out the stats counted since the last call and start counting again
+
+void pixel_getIsrStats( pixelIsrStats_t *stats );
+
+#endif
+
 // Update the pixel buffer with raw PWM register values.
 // Larger pwm values map to shorter PWM cycles (255=off) so for red and green
 // there is an inverse but very non linear relation between raw value and brightness.
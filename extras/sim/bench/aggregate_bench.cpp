@@ -0,0 +1,181 @@
+/*
+ * aggregate_bench.cpp
+ *
+ * How long the cluster totals take to come out right, and how well they stay right, versus cluster size and diameter.
+ *
+ * Every tile gets a random value. A tile's totals are right when its count, sum, min and max all match the tiles
+ * it is connected to. Each run measures...
+ *
+ *   boot        From power up until every tile has the right totals.
+ *   change      Once things settle, one tile at the edge changes its value. Until every tile has the new totals.
+ *   remove      After that tile is taken away, until every tile has the totals without it.
+ *   right       Over the next HOLD_MS, how much of the time every tile had the right totals.
+ *
+ *    aggregate_bench <tile library> [pulse loss %]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+
+#include "sim.h"
+
+#define RUNS            5
+#define TIMEOUT_MS      60000
+#define SETTLE_MS       10000
+#define HOLD_MS         20000
+#define SAMPLE_MS       50
+
+static std::vector<uint8_t> values;
+static std::vector<bool> removed;
+
+// Does every tile have the right totals for the tiles it is connected to?
+
+static bool allRight(void) {
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+
+        if ( removed[t] ) {
+            continue;
+        }
+
+        std::vector<int> hops = sim_hops_from( t );
+
+        int count = 0 , sum = 0 , low = 255 , high = 0;
+
+        for( int o=0; o<sim_tile_count(); o++ ) {
+            if ( hops[o] >= 0 ) {
+                count++;
+                sum += values[o];
+                low  = std::min( low , (int) values[o] );
+                high = std::max( high , (int) values[o] );
+            }
+        }
+
+        if ( sim_call<uint8_t>( t , "bench_count" ) != count || sim_call<uint16_t>( t , "bench_sum" ) != sum ||
+             sim_call<uint8_t>( t , "bench_min" ) != low || sim_call<uint8_t>( t , "bench_max" ) != high ) {
+            return false;
+        }
+
+    }
+
+    return true;
+
+}
+
+static void setValue( int t , uint8_t value ) {
+    values[t] = value;
+    sim_call<void>( t , "bench_set_value" , value );
+}
+
+// Median of the runs that got there, and how many did
+
+static std::string reached( std::vector<double> times ) {
+
+    std::sort( times.begin() , times.end() );
+    times.erase( times.begin() , std::upper_bound( times.begin() , times.end() , -1.0 ) );
+
+    if ( times.empty() ) {
+        return sim_fmt( "- 0/%d" , RUNS );
+    }
+
+    return sim_fmt( "%.0f %d/%d" , times[ times.size() / 2 ] , (int) times.size() , RUNS );
+
+}
+
+// `layout` adds the tiles and returns the one at the edge that gets changed and then taken away
+
+template <typename L> static void benchLayout( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> bootTimes , changeTimes , removeTimes;
+    int samples = 0 , rightSamples = 0;
+    int tiles = 0 , hops = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        std::mt19937 rng( config.seed );
+
+        sim_init( library , config );
+
+        int edge = layout();
+
+        tiles = sim_tile_count();
+        hops  = sim_diameter();
+
+        values.assign( tiles , 0 );
+        removed.assign( tiles , false );
+
+        for( int t=0; t<tiles; t++ ) {
+            setValue( t , rng() % 256 );
+        }
+
+        bootTimes.push_back( sim_run_until( allRight , TIMEOUT_MS , 10 ) );
+
+        sim_run_ms( SETTLE_MS );
+
+        setValue( edge , values[edge] ^ 0x80 );
+
+        changeTimes.push_back( sim_run_until( allRight , TIMEOUT_MS , 10 ) );
+
+        sim_remove_tile( edge );
+        removed[edge] = true;
+
+        removeTimes.push_back( sim_run_until( allRight , TIMEOUT_MS , 10 ) );
+
+        for( int s=0; s < HOLD_MS / SAMPLE_MS; s++ ) {
+
+            sim_run_ms( SAMPLE_MS );
+
+            samples++;
+
+            if ( allRight() ) {
+                rightSamples++;
+            }
+
+        }
+
+    }
+
+    sim_table_row( { name , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) ,
+                     reached( bootTimes ) , reached( changeTimes ) , reached( removeTimes ) ,
+                     sim_fmt( "%.1f%%" , 100.0 * rightSamples / samples ) } );
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library> [pulse loss %%]\n" , argv[0] );
+        return 1;
+    }
+
+    const char *library = argv[1];
+
+    SimConfig config;
+
+    if ( argc > 2 ) {
+        config.pulseLossPct = atof( argv[2] );
+    }
+
+    printf( "Aggregate: ms until every tile has the right totals (median, runs that got there) "
+            "(%d runs each, %.1f%% clock skew, %.2f%% pulse loss, %uus per loop)\n\n" ,
+            RUNS , config.skewPct , config.pulseLossPct , config.loopUs );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "boot" , "change" , "remove" , "right" } );
+
+    for( int n : { 2 , 4 , 8 , 16 } ) {
+        benchLayout( sim_fmt( "line %d" , n ).c_str() , library , config , [n]() { return sim_add_line( n ).back(); } );
+    }
+
+    for( int radius : { 1 , 2 , 3 , 4 } ) {
+        benchLayout( sim_fmt( "hex r%d" , radius ).c_str() , library , config , [radius]() { return sim_add_hexagon( radius ).front(); } );
+    }
+
+    return 0;
+
+}
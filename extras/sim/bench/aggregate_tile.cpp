@@ -0,0 +1,51 @@
+/*
+ * aggregate_tile.cpp
+ *
+ * Benchmark sketch for aggregate.h. The benchmark sets each tile's value and reads back the cluster totals.
+ *
+ */
+
+#include "blinklib.h"
+#include "blinkstate.h"
+#include "aggregate.h"
+
+#include "simtile.h"
+
+static bool newValueFlag;
+static byte newValue;
+
+// Takes effect on the next pass through loop(), like a real sketch would do it
+
+SIM_EXPORT void bench_set_value( byte value ) {
+    newValue = value;
+    newValueFlag = true;
+}
+
+SIM_EXPORT byte bench_count(void) {
+    return getAggregateCount();
+}
+
+SIM_EXPORT uint16_t bench_sum(void) {
+    return getAggregateSum();
+}
+
+SIM_EXPORT byte bench_min(void) {
+    return getAggregateMin();
+}
+
+SIM_EXPORT byte bench_max(void) {
+    return getAggregateMax();
+}
+
+void setup() {
+    getAggregateCount();            // Start aggregating
+}
+
+void loop() {
+
+    if (newValueFlag) {
+        setAggregateValue( newValue );
+        newValueFlag = false;
+    }
+
+}
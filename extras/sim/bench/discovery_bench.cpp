@@ -0,0 +1,231 @@
+/*
+ * discovery_bench.cpp
+ *
+ * How long discovery takes to find the neighbors and lay out the cluster grid, versus cluster size and diameter.
+ *
+ * Each run times three things...
+ *
+ *   neighbors   From power up until every tile knows the id and touching face of every neighbor.
+ *   grid        From power up until the grid is right everywhere. Every tile follows the leader as root, the root
+ *               is at (0,0), and every pair of neighbors agrees on where they sit and which way they face.
+ *   merge       We split the cluster in two (the middle tile of a line, the middle column of a hexagon), let each half
+ *               settle on its own, then put the missing tiles back and time until the whole grid is right again.
+ *               One half has to give up its root and re-lay itself out on the other half's grid.
+ *
+ *    discovery_bench <tile library> [pulse loss %]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "sim.h"
+
+#define RUNS            5
+#define TIMEOUT_MS      60000
+#define SPLIT_MS        10000           // How long the halves get to settle on their own
+
+static const int directionQ[SIM_FACE_COUNT] = { +1 , +1 ,  0 , -1 , -1 ,  0 };
+static const int directionR[SIM_FACE_COUNT] = {  0 , -1 , -1 ,  0 , +1 , +1 };
+
+static bool neighborsKnown(void) {
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+
+        for( int f=0; f<SIM_FACE_COUNT; f++ ) {
+
+            int theirFace;
+            int n = sim_neighbor( t , f , &theirFace );
+
+            if ( n < 0 ) {
+                continue;
+            }
+
+            if ( !sim_call<bool>( t , "bench_neighbor_known" , (uint8_t) f ) ||
+                 sim_call<uint16_t>( t , "bench_neighbor_id" , (uint8_t) f ) != sim_call<uint16_t>( n , "bench_tile_id" ) ||
+                 sim_call<uint8_t>( t , "bench_neighbor_face" , (uint8_t) f ) != theirFace ) {
+                return false;
+            }
+
+        }
+
+    }
+
+    return true;
+
+}
+
+static bool gridRight(void) {
+
+    uint16_t leader = 0;
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+        leader = std::max( leader , sim_call<uint16_t>( t , "bench_tile_id" ) );
+    }
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+
+        if ( sim_call<uint16_t>( t , "bench_root_id" ) != leader ) {
+            return false;
+        }
+
+        int q   = sim_call<int8_t>( t , "bench_q" );
+        int r   = sim_call<int8_t>( t , "bench_r" );
+        int rot = sim_call<uint8_t>( t , "bench_rotation" );
+
+        if ( sim_call<uint16_t>( t , "bench_tile_id" ) == leader && ( q || r ) ) {
+            return false;
+        }
+
+        for( int f=0; f<SIM_FACE_COUNT; f++ ) {
+
+            int theirFace;
+            int n = sim_neighbor( t , f , &theirFace );
+
+            if ( n < 0 ) {
+                continue;
+            }
+
+            int d = ( f + rot ) % SIM_FACE_COUNT;
+
+            if ( sim_call<int8_t>( n , "bench_q" ) != q + directionQ[d] ||
+                 sim_call<int8_t>( n , "bench_r" ) != r + directionR[d] ||
+                 ( theirFace + sim_call<uint8_t>( n , "bench_rotation" ) ) % SIM_FACE_COUNT != ( d + 3 ) % SIM_FACE_COUNT ) {
+                return false;
+            }
+
+        }
+
+    }
+
+    return true;
+
+}
+
+// Median of the runs that got there, and how many did
+
+static std::string reached( std::vector<double> times ) {
+
+    std::sort( times.begin() , times.end() );
+    times.erase( times.begin() , std::upper_bound( times.begin() , times.end() , -1.0 ) );
+
+    if ( times.empty() ) {
+        return sim_fmt( "- 0/%d" , RUNS );
+    }
+
+    return sim_fmt( "%.0f %d/%d" , times[ times.size() / 2 ] , (int) times.size() , RUNS );
+
+}
+
+// `layout` adds the tiles and returns the ones to take out to split the cluster
+
+template <typename L> static void benchLayout( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> neighborTimes , gridTimes , mergeTimes;
+    int tiles = 0 , hops = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        // Power up as one cluster
+
+        sim_init( library , config );
+
+        layout();
+
+        tiles = sim_tile_count();
+        hops  = sim_diameter();
+
+        neighborTimes.push_back( sim_run_until( neighborsKnown , TIMEOUT_MS , 10 ) );
+
+        sim_init( library , config );
+        layout();
+
+        gridTimes.push_back( sim_run_until( gridRight , TIMEOUT_MS , 10 ) );
+
+        // Power up in two halves and then join them
+
+        sim_init( library , config );
+
+        std::vector<int> split = layout();
+
+        for( int t : split ) {
+            sim_remove_tile( t );
+        }
+
+        sim_run_ms( SPLIT_MS );
+
+        for( int t : split ) {
+            sim_restore_tile( t );
+        }
+
+        mergeTimes.push_back( sim_run_until( gridRight , TIMEOUT_MS , 10 ) );
+
+    }
+
+    sim_table_row( { name , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) ,
+                     reached( neighborTimes ) , reached( gridTimes ) , reached( mergeTimes ) } );
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library> [pulse loss %%]\n" , argv[0] );
+        return 1;
+    }
+
+    const char *library = argv[1];
+
+    SimConfig config;
+
+    if ( argc > 2 ) {
+        config.pulseLossPct = atof( argv[2] );
+    }
+
+    printf( "Discovery: ms until neighbors are known and the grid is right (median, runs that got there) "
+            "(%d runs each, %.1f%% clock skew, %.2f%% pulse loss, %uus per loop)\n\n" ,
+            RUNS , config.skewPct , config.pulseLossPct , config.loopUs );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "neighbors" , "grid" , "merge" } );
+
+    for( int n : { 2 , 4 , 8 , 16 } ) {
+
+        benchLayout( sim_fmt( "line %d" , n ).c_str() , library , config , [n]() {
+            std::vector<int> line = sim_add_line( n );
+            return std::vector<int>{ line[ n / 2 ] };
+        } );
+
+    }
+
+    for( int radius : { 1 , 2 , 3 } ) {
+
+        benchLayout( sim_fmt( "hex r%d" , radius ).c_str() , library , config , [radius]() {
+
+            // Same layout as sim_add_hexagon(), but we need to know which tiles are in the middle column
+
+            std::vector<int> middle;
+
+            for( int q=-radius; q<=radius; q++ ) {
+                for( int r=-radius; r<=radius; r++ ) {
+                    if ( abs( q + r ) <= radius ) {
+                        int t = sim_add_tile( q , r );
+                        if ( q == 0 ) {
+                            middle.push_back( t );
+                        }
+                    }
+                }
+            }
+
+            return middle;
+
+        } );
+
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,51 @@
+/*
+ * discovery_tile.cpp
+ *
+ * Benchmark sketch for discovery.h. The benchmark reads back what each tile thinks of its neighbors and its place on the grid.
+ *
+ */
+
+#include "blinklib.h"
+#include "blinkstate.h"
+#include "discovery.h"
+
+#include "simtile.h"
+
+SIM_EXPORT uint16_t bench_tile_id(void) {
+    return getTileId();
+}
+
+SIM_EXPORT bool bench_neighbor_known( byte face ) {
+    return isNeighborKnownOnFace( face );
+}
+
+SIM_EXPORT uint16_t bench_neighbor_id( byte face ) {
+    return getNeighborIdOnFace( face );
+}
+
+SIM_EXPORT byte bench_neighbor_face( byte face ) {
+    return getNeighborFaceOnFace( face );
+}
+
+SIM_EXPORT uint16_t bench_root_id(void) {
+    return getRootId();
+}
+
+SIM_EXPORT int8_t bench_q(void) {
+    return getPositionQ();
+}
+
+SIM_EXPORT int8_t bench_r(void) {
+    return getPositionR();
+}
+
+SIM_EXPORT byte bench_rotation(void) {
+    return getRotation();
+}
+
+void setup() {
+    getRootId();                    // Start discovering
+}
+
+void loop() {
+}
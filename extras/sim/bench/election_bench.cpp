@@ -0,0 +1,186 @@
+/*
+ * election_bench.cpp
+ *
+ * How long an election takes and how many packets it costs, versus cluster size and diameter.
+ *
+ * Each run measures...
+ *
+ *   boot        From power up until every tile agrees that the highest id is the leader.
+ *   heartbeat   Once things settle, how many election packets each tile gets per second just to keep the leader.
+ *   gone        After the leader is taken away, until every tile agrees on the next highest id. Taking the leader
+ *               out of a line can split it in two, and then each half has to agree on its own leader.
+ *
+ * The packet counts are election packets that made it to a tile, divided by the number of tiles.
+ *
+ *    election_bench <tile library> [pulse loss %]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "sim.h"
+
+#define RUNS            5
+#define TIMEOUT_MS      60000
+#define SETTLE_MS       5000
+#define HEARTBEAT_MS    10000
+
+static std::vector<bool> removed;
+
+static uint16_t tileId( int t ) {
+    return sim_call<uint16_t>( t , "bench_tile_id" );
+}
+
+// Does every tile follow the highest id it is connected to?
+
+static bool agreed(void) {
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+
+        if ( removed[t] ) {
+            continue;
+        }
+
+        std::vector<int> hops = sim_hops_from( t );
+
+        uint16_t highest = 0;
+
+        for( int o=0; o<sim_tile_count(); o++ ) {
+            if ( hops[o] >= 0 ) {
+                highest = std::max( highest , tileId( o ) );
+            }
+        }
+
+        if ( sim_call<uint16_t>( t , "bench_leader_id" ) != highest ) {
+            return false;
+        }
+
+    }
+
+    return true;
+
+}
+
+static double packetsPerTile(void) {
+
+    uint64_t total = 0;
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+        total += sim_call<uint32_t>( t , "bench_election_packets" );
+    }
+
+    return (double) total / sim_tile_count();
+
+}
+
+static double median( std::vector<double> v ) {
+    std::sort( v.begin() , v.end() );
+    return v[ v.size() / 2 ];
+}
+
+// Median of the runs that got there, and how many did
+
+static std::string reached( std::vector<double> times ) {
+
+    std::sort( times.begin() , times.end() );
+    times.erase( times.begin() , std::upper_bound( times.begin() , times.end() , -1.0 ) );
+
+    if ( times.empty() ) {
+        return sim_fmt( "- 0/%d" , RUNS );
+    }
+
+    return sim_fmt( "%.0f %d/%d" , times[ times.size() / 2 ] , (int) times.size() , RUNS );
+
+}
+
+template <typename L> static void benchLayout( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> bootTimes , bootPackets , heartbeatRates , goneTimes , gonePackets;
+    int tiles = 0 , hops = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        sim_init( library , config );
+
+        layout();
+
+        tiles = sim_tile_count();
+        hops  = sim_diameter();
+
+        removed.assign( tiles , false );
+
+        bootTimes.push_back( sim_run_until( agreed , TIMEOUT_MS , 10 ) );
+        bootPackets.push_back( packetsPerTile() );
+
+        sim_run_ms( SETTLE_MS );
+
+        double before = packetsPerTile();
+
+        sim_run_ms( HEARTBEAT_MS );
+
+        heartbeatRates.push_back( ( packetsPerTile() - before ) * 1000 / HEARTBEAT_MS );
+
+        // Take away the leader
+
+        int leader = 0;
+
+        for( int t=0; t<tiles; t++ ) {
+            if ( tileId( t ) > tileId( leader ) ) {
+                leader = t;
+            }
+        }
+
+        sim_remove_tile( leader );
+        removed[leader] = true;
+
+        before = packetsPerTile();
+
+        goneTimes.push_back( sim_run_until( agreed , TIMEOUT_MS , 10 ) );
+        gonePackets.push_back( packetsPerTile() - before );
+
+    }
+
+    sim_table_row( { name , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) ,
+                     reached( bootTimes ) , sim_fmt( "%.1f" , median( bootPackets ) ) ,
+                     sim_fmt( "%.2f" , median( heartbeatRates ) ) ,
+                     reached( goneTimes ) , sim_fmt( "%.1f" , median( gonePackets ) ) } );
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library> [pulse loss %%]\n" , argv[0] );
+        return 1;
+    }
+
+    const char *library = argv[1];
+
+    SimConfig config;
+
+    if ( argc > 2 ) {
+        config.pulseLossPct = atof( argv[2] );
+    }
+
+    printf( "Election: ms until everyone agrees (median, runs that got there) and election packets per tile "
+            "(%d runs each, %.1f%% clock skew, %.2f%% pulse loss, %uus per loop)\n\n" ,
+            RUNS , config.skewPct , config.pulseLossPct , config.loopUs );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "boot ms" , "boot pkts" , "heartbeat pkts/s" , "gone ms" , "gone pkts" } );
+
+    for( int n : { 2 , 4 , 8 , 16 } ) {
+        benchLayout( sim_fmt( "line %d" , n ).c_str() , library , config , [n]() { sim_add_line( n ); } );
+    }
+
+    for( int radius : { 1 , 2 , 3 , 4 } ) {
+        benchLayout( sim_fmt( "hex r%d" , radius ).c_str() , library , config , [radius]() { sim_add_hexagon( radius ); } );
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,51 @@
+/*
+ * election_tile.cpp
+ *
+ * Benchmark sketch for election.h. Besides reading back who we think the leader is, we count the election packets
+ * that reach us so the benchmark can see how much talking an election takes.
+ *
+ */
+
+#include "blinklib.h"
+#include "blinkstate.h"
+#include "election.h"
+
+#include "simtile.h"
+
+static uint32_t electionPackets;
+
+static void countPacket( byte face , const byte *data , byte len ) {
+
+    (void) face;
+    (void) len;
+
+    if ( data[0] == PACKET_TYPE_ELECTION ) {
+        electionPackets++;
+    }
+
+}
+
+static packethandler_t countPacketChain = {
+     .callback = countPacket,
+     .next     = NULL
+};
+
+SIM_EXPORT uint16_t bench_tile_id(void) {
+    return getTileId();
+}
+
+SIM_EXPORT uint16_t bench_leader_id(void) {
+    return getLeaderId();
+}
+
+SIM_EXPORT uint32_t bench_election_packets(void) {
+    return electionPackets;
+}
+
+void setup() {
+    getLeaderId();                  // Start the election
+    addOnPacket( &countPacketChain );
+}
+
+void loop() {
+}
@@ -0,0 +1,150 @@
+/*
+ * flood_bench.cpp
+ *
+ * Time for a flood to reach every tile, versus cluster size and diameter.
+ *
+ * For each layout we start floods from a tile at one end of the cluster (so the flood has to cross the whole
+ * diameter) and from the middle, and time how long until every tile has it. Each row is several runs with
+ * different seeds, so different clock skews, boot times and rotations. A run that has not reached every tile
+ * after TIMEOUT_MS is not done. That happens when a packet runs out of resends on some link, which takes pulse loss.
+ *
+ *    flood_bench <tile library> [pulse loss %]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "sim.h"
+
+#define RUNS            5
+#define SETTLE_MS       2000            // Let the neighbors find each other before we start
+#define TIMEOUT_MS      60000
+
+static double floodFrom( int origin , uint8_t id ) {
+
+    sim_call<void>( origin , "bench_start" , id );
+
+    return sim_run_until( [id]() {
+
+        for( int t=0; t<sim_tile_count(); t++ ) {
+            if ( sim_call<uint8_t>( t , "bench_last_id" ) != id ) {
+                return false;
+            }
+        }
+
+        return true;
+
+    } , TIMEOUT_MS );
+
+}
+
+// Runs that never reached every tile count as not done and are left out of the times
+
+static void report( const char *layout , int tiles , int hops , std::vector<double> times ) {
+
+    std::sort( times.begin() , times.end() );
+
+    times.erase( times.begin() , std::upper_bound( times.begin() , times.end() , -1.0 ) );
+
+    std::string done = sim_fmt( "%d/%d" , (int) times.size() , RUNS );
+
+    if ( times.empty() ) {
+        sim_table_row( { layout , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) , done } );
+        return;
+    }
+
+    double median = times[ times.size() / 2 ];
+
+    sim_table_row( { layout , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) , done ,
+                     sim_fmt( "%.0f" , median ) , sim_fmt( "%.0f" , times.back() ) ,
+                     sim_fmt( "%.0f" , hops ? median / hops : 0 ) } );
+
+}
+
+// `layout` adds the tiles and returns the two origins to flood from (end, middle)
+
+template <typename L> static void benchLayout( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> endTimes , middleTimes;
+    int tiles = 0 , endHops = 0 , middleHops = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        sim_init( library , config );
+
+        std::pair<int,int> origins = layout();
+
+        sim_run_ms( SETTLE_MS );
+
+        tiles = sim_tile_count();
+
+        std::vector<int> fromEnd    = sim_hops_from( origins.first );
+        std::vector<int> fromMiddle = sim_hops_from( origins.second );
+
+        endHops    = *std::max_element( fromEnd.begin() , fromEnd.end() );
+        middleHops = *std::max_element( fromMiddle.begin() , fromMiddle.end() );
+
+        endTimes.push_back( floodFrom( origins.first , 1 ) );
+
+        sim_run_ms( 1000 );
+
+        middleTimes.push_back( floodFrom( origins.second , 2 ) );
+
+    }
+
+    report( sim_fmt( "%s end" , name ).c_str() , tiles , endHops , endTimes );
+    report( sim_fmt( "%s mid" , name ).c_str() , tiles , middleHops , middleTimes );
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library> [pulse loss %%]\n" , argv[0] );
+        return 1;
+    }
+
+    const char *library = argv[1];
+
+    SimConfig config;
+
+    if ( argc > 2 ) {
+        config.pulseLossPct = atof( argv[2] );
+    }
+
+    printf( "Flood time to full coverage (%d runs each, %.1f%% clock skew, %.2f%% pulse loss, %uus per loop)\n\n" ,
+            RUNS , config.skewPct , config.pulseLossPct , config.loopUs );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "done" , "median ms" , "max ms" , "ms/hop" } );
+
+    for( int n : { 2 , 4 , 8 , 16 } ) {
+
+        benchLayout( sim_fmt( "line %d" , n ).c_str() , library , config , [n]() {
+            std::vector<int> line = sim_add_line( n );
+            return std::make_pair( line.front() , line[ n / 2 ] );
+        } );
+
+    }
+
+    for( int radius : { 1 , 2 , 3 , 4 } ) {
+
+        benchLayout( sim_fmt( "hex r%d" , radius ).c_str() , library , config , [radius]() {
+
+            std::vector<int> hexagon = sim_add_hexagon( radius );
+
+            // The first tile added is a corner. The middle one is the center.
+
+            return std::make_pair( hexagon.front() , hexagon[ hexagon.size() / 2 ] );
+
+        } );
+
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,50 @@
+/*
+ * flood_tile.cpp
+ *
+ * Benchmark sketch for flood.h. The benchmark starts a flood on one tile and watches for it to show up on the rest.
+ *
+ */
+
+#include "blinklib.h"
+#include "blinkstate.h"
+#include "flood.h"
+
+#include "simtile.h"
+
+static byte startId;                // Flood to start on the next pass, 0=none
+static byte lastIdReceived;
+static byte lastHops;
+
+SIM_EXPORT void bench_start( byte id ) {
+    startId = id;
+}
+
+// Id of the last flood we got (or started), and how many hops it took to get here
+
+SIM_EXPORT byte bench_last_id(void) {
+    return lastIdReceived;
+}
+
+SIM_EXPORT byte bench_last_hops(void) {
+    return lastHops;
+}
+
+void setup() {
+    floodReceived();                // Start listening
+}
+
+void loop() {
+
+    if (startId) {
+        floodBroadcast( startId , 255 , 0 );
+        lastIdReceived = startId;
+        lastHops = 0;
+        startId = 0;
+    }
+
+    if ( floodReceived() ) {
+        lastIdReceived = floodGetId();
+        lastHops = floodGetHops();
+    }
+
+}
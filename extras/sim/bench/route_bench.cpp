@@ -0,0 +1,160 @@
+/*
+ * route_bench.cpp
+ *
+ * How often routed messages get there and how long they take, versus cluster size and diameter.
+ *
+ * Each run lets the routes settle for SETTLE_MS and then measures...
+ *
+ *   one at a time   MESSAGES messages between random pairs of tiles, each sent after the last one got there. How
+ *                   many got there within MESSAGE_MS, how long they took, and the time per hop (using the shortest
+ *                   path, so a message that took the long way around the tree counts against it).
+ *   all at once     Every tile sends a message to a random tile at the same moment. How many got there within
+ *                   BURST_MS. This is where the small forwarding queues and the one-message receive slot show.
+ *
+ * Clusters of 37 and 61 tiles have more tiles than fit in ROUTE_TABLE_SIZE, so the tiles near the root have to
+ * fall back on sending to all the tiles below them.
+ *
+ *    route_bench <tile library> [pulse loss %]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <random>
+
+#include "sim.h"
+
+#define RUNS            5
+#define SETTLE_MS       15000
+#define MESSAGES        20
+#define MESSAGE_MS      10000
+#define BURST_MS        20000
+
+static uint16_t tileId( int t ) {
+    return sim_call<uint16_t>( t , "bench_tile_id" );
+}
+
+static bool received( int t , uint16_t value ) {
+    return sim_call<uint8_t>( t , "bench_received" , value ) != 0;
+}
+
+static double percentile( std::vector<double> v , double p ) {
+
+    if ( v.empty() ) {
+        return -1;
+    }
+
+    std::sort( v.begin() , v.end() );
+    return v[ (size_t) ( ( v.size() - 1 ) * p / 100 ) ];
+
+}
+
+template <typename L> static void benchLayout( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> latencies , msPerHop;
+    int sent = 0 , delivered = 0 , burstSent = 0 , burstDelivered = 0;
+    int tiles = 0 , hops = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        std::mt19937 rng( config.seed );
+
+        sim_init( library , config );
+
+        layout();
+
+        tiles = sim_tile_count();
+        hops  = sim_diameter();
+
+        sim_run_ms( SETTLE_MS );
+
+        uint16_t value = 1;
+
+        for( int m=0; m<MESSAGES; m++ ) {
+
+            int from = rng() % tiles;
+            int to   = ( from + 1 + rng() % ( tiles - 1 ) ) % tiles;
+
+            sim_call<void>( from , "bench_send" , tileId( to ) , value );
+
+            double ms = sim_run_until( [to,value]() { return received( to , value ); } , MESSAGE_MS , 5 );
+
+            sent++;
+
+            if ( ms >= 0 ) {
+                delivered++;
+                latencies.push_back( ms );
+                msPerHop.push_back( ms / sim_hops_from( from )[to] );
+            }
+
+            value++;
+
+        }
+
+        // Everyone at once
+
+        std::vector<int> dests( tiles );
+
+        for( int t=0; t<tiles; t++ ) {
+            dests[t] = ( t + 1 + rng() % ( tiles - 1 ) ) % tiles;
+            sim_call<void>( t , "bench_send" , tileId( dests[t] ) , (uint16_t) ( 0x8000 + t ) );
+        }
+
+        sim_run_ms( BURST_MS );
+
+        for( int t=0; t<tiles; t++ ) {
+
+            burstSent++;
+
+            if ( received( dests[t] , 0x8000 + t ) ) {
+                burstDelivered++;
+            }
+
+        }
+
+    }
+
+    sim_table_row( { name , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) ,
+                     sim_fmt( "%.0f%%" , 100.0 * delivered / sent ) ,
+                     sim_fmt( "%.0f" , percentile( latencies , 50 ) ) , sim_fmt( "%.0f" , percentile( latencies , 90 ) ) ,
+                     sim_fmt( "%.0f" , percentile( msPerHop , 50 ) ) ,
+                     sim_fmt( "%.0f%%" , 100.0 * burstDelivered / burstSent ) } );
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library> [pulse loss %%]\n" , argv[0] );
+        return 1;
+    }
+
+    const char *library = argv[1];
+
+    SimConfig config;
+
+    if ( argc > 2 ) {
+        config.pulseLossPct = atof( argv[2] );
+    }
+
+    printf( "Route: messages that got there and ms they took (%d runs of %d messages each, %.1f%% clock skew, "
+            "%.2f%% pulse loss, %uus per loop)\n\n" ,
+            RUNS , MESSAGES , config.skewPct , config.pulseLossPct , config.loopUs );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "delivered" , "median ms" , "90% ms" , "ms/hop" , "all at once" } );
+
+    for( int n : { 2 , 4 , 8 , 16 } ) {
+        benchLayout( sim_fmt( "line %d" , n ).c_str() , library , config , [n]() { sim_add_line( n ); } );
+    }
+
+    for( int radius : { 1 , 2 , 3 , 4 } ) {
+        benchLayout( sim_fmt( "hex r%d" , radius ).c_str() , library , config , [radius]() { sim_add_hexagon( radius ); } );
+    }
+
+    return 0;
+
+}
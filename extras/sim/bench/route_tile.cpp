@@ -0,0 +1,73 @@
+/*
+ * route_tile.cpp
+ *
+ * Benchmark sketch for route.h. The benchmark tells tiles to send messages, and we keep a log of the messages
+ * that reach us so it can tell which ones got through.
+ *
+ */
+
+#include "blinklib.h"
+#include "blinkstate.h"
+#include "route.h"
+
+#include "simtile.h"
+
+#define LOG_SIZE 128
+
+static bool sendFlag;
+static uint16_t sendDest;
+static uint16_t sendValue;
+
+static uint16_t logValues[LOG_SIZE];
+static byte logHops[LOG_SIZE];
+static uint16_t logCount;
+
+SIM_EXPORT uint16_t bench_tile_id(void) {
+    return getTileId();
+}
+
+// Goes out on the next pass through loop(), like a real sketch would do it
+
+SIM_EXPORT void bench_send( uint16_t destId , uint16_t value ) {
+    sendDest  = destId;
+    sendValue = value;
+    sendFlag  = true;
+}
+
+// Has a message with `value` reached us? Returns the hops it took, or 0 if not.
+
+SIM_EXPORT byte bench_received( uint16_t value ) {
+
+    for( uint16_t i=0; i<logCount && i<LOG_SIZE; i++ ) {
+        if ( logValues[i] == value ) {
+            return logHops[i];
+        }
+    }
+
+    return 0;
+
+}
+
+void setup() {
+    routeReceived();                // Start routing
+}
+
+void loop() {
+
+    if (sendFlag) {
+        routeSend( sendDest , sendValue );
+        sendFlag = false;
+    }
+
+    if ( routeReceived() ) {
+
+        if ( logCount < LOG_SIZE ) {
+            logValues[logCount] = routeGetValue();
+            logHops[logCount]   = routeGetHops();
+        }
+
+        logCount++;
+
+    }
+
+}
@@ -0,0 +1,289 @@
+/*
+ * seed_bench.cpp
+ *
+ * Time for a seeded image to reach every tile, versus cluster size and diameter.
+ *
+ * For each layout one tile at the edge seeds a random IMAGE_BYTES image. Each run measures...
+ *
+ *   first       Until the first neighbor has the whole image checked out. This is the speed of one link.
+ *   all         Until every tile has it.
+ *   per hop     What each hop past the first added, (all - first) / (hops - 1). Since blocks get passed on as soon
+ *               as they arrive, this should be a lot less than `first`.
+ *   right       Runs where every tile ended up with exactly the image that was sent.
+ *
+ * Then a second image gets seeded from the other end of a few layouts once the first one is everywhere, to check that
+ * it replaces the first one on every tile.
+ *
+ * Then a full size image (the biggest one SEED_FLASH can install) goes across a few layouts, to show how long a
+ * real reflash takes.
+ *
+ *    seed_bench <tile library> [pulse loss %]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+#include "sim.h"
+
+#define RUNS            3
+#define SETTLE_MS       2000            // Let the neighbors find each other before we start
+#define IMAGE_BYTES     1024
+#define TIMEOUT_MS      ( 10 * 60 * 1000.0 )
+
+#define FULL_BYTES      7936            // SEED_FLASH_MAX_LENGTH
+#define FULL_TIMEOUT_MS ( 60 * 60 * 1000.0 )
+
+static std::vector<uint8_t> image;
+
+static bool complete( int t ) {
+    return sim_call<bool>( t , "bench_complete" );
+}
+
+static bool allComplete(void) {
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+        if ( !complete( t ) ) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+// Did every tile but the origin get exactly the image we sent?
+
+static bool allRight( int origin ) {
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+        if ( t != origin && memcmp( sim_call<const uint8_t *>( t , "bench_received_image" ) , image.data() , image.size() ) ) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+// Does every tile but the origin have exactly the image we sent? Tiles still holding an older image count as complete,
+// so we need both.
+
+static bool allCompleteAndRight( int origin ) {
+    return allComplete() && allRight( origin );
+}
+
+// Put a random image in the origin's flash and seed it. Returns how long until the first neighbor had it,
+// and `allMs` gets how long until everyone did (-1 if that did not happen before `timeoutMs`).
+
+static double seedFrom( int origin , uint16_t length , uint32_t seed , double timeoutMs , double *allMs ) {
+
+    std::mt19937 rng( seed );
+
+    image.resize( length );
+
+    for( uint8_t &b : image ) {
+        b = rng();
+    }
+
+    memcpy( sim_call<uint8_t *>( origin , "sim_tile_flash" ) , image.data() , length );
+
+    sim_call<void>( origin , "bench_start" , length );
+
+    double start = sim_now_ms();
+
+    double firstMs = sim_run_until( [origin]() {
+
+        for( int t=0; t<sim_tile_count(); t++ ) {
+            if ( t != origin && complete( t ) ) {
+                return true;
+            }
+        }
+
+        return false;
+
+    } , timeoutMs , 100 );
+
+    *allMs = sim_run_until( [origin]() { return allCompleteAndRight( origin ); } , timeoutMs - ( sim_now_ms() - start ) , 100 );
+
+    if ( *allMs >= 0 ) {
+        *allMs = sim_now_ms() - start;
+    }
+
+    return firstMs;
+
+}
+
+static double median( std::vector<double> v ) {
+    std::sort( v.begin() , v.end() );
+    return v[ v.size() / 2 ];
+}
+
+// Median of the runs that got there, and how many did
+
+static std::string reached( std::vector<double> times ) {
+
+    std::sort( times.begin() , times.end() );
+    times.erase( times.begin() , std::upper_bound( times.begin() , times.end() , -1.0 ) );
+
+    if ( times.empty() ) {
+        return sim_fmt( "- 0/%d" , RUNS );
+    }
+
+    return sim_fmt( "%.0f %d/%d" , times[ times.size() / 2 ] , (int) times.size() , RUNS );
+
+}
+
+template <typename L> static void benchLayout( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> firstTimes , allTimes , perHop;
+    int tiles = 0 , hops = 0 , right = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        sim_init( library , config );
+
+        int origin = layout();
+
+        tiles = sim_tile_count();
+        hops  = sim_diameter();
+
+        sim_run_ms( SETTLE_MS );
+
+        double allMs;
+
+        firstTimes.push_back( seedFrom( origin , IMAGE_BYTES , config.seed , TIMEOUT_MS , &allMs ) );
+        allTimes.push_back( allMs );
+
+        if ( allMs >= 0 ) {
+
+            if ( hops > 1 ) {
+                perHop.push_back( ( allMs - firstTimes.back() ) / ( hops - 1 ) );
+            }
+
+            if ( allRight( origin ) ) {
+                right++;
+            }
+
+        }
+
+    }
+
+    sim_table_row( { name , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) ,
+                     reached( firstTimes ) , reached( allTimes ) ,
+                     perHop.empty() ? "-" : sim_fmt( "%.0f" , median( perHop ) ) ,
+                     sim_fmt( "%.1f" , IMAGE_BYTES * 1000.0 / median( firstTimes ) ) ,
+                     sim_fmt( "%d/%d" , right , RUNS ) } );
+
+}
+
+// Seed one image from the first tile, then once everyone has it a different one from the last tile
+
+template <typename L> static void benchReplace( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> allTimes;
+    int tiles = 0 , hops = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        sim_init( library , config );
+
+        std::vector<int> ids = layout();
+
+        tiles = sim_tile_count();
+        hops  = sim_diameter();
+
+        sim_run_ms( SETTLE_MS );
+
+        double allMs;
+
+        seedFrom( ids.front() , IMAGE_BYTES , config.seed , TIMEOUT_MS , &allMs );
+
+        if ( allMs < 0 ) {
+            allTimes.push_back( -1 );
+            continue;
+        }
+
+        seedFrom( ids.back() , IMAGE_BYTES , config.seed + 1000 , TIMEOUT_MS , &allMs );
+
+        allTimes.push_back( allMs );
+
+    }
+
+    sim_table_row( { name , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) , reached( allTimes ) } );
+
+}
+
+template <typename L> static void benchFull( const char *name , const char *library , SimConfig config , L layout ) {
+
+    sim_init( library , config );
+
+    int origin = layout();
+
+    sim_run_ms( SETTLE_MS );
+
+    double allMs;
+    double firstMs = seedFrom( origin , FULL_BYTES , config.seed , FULL_TIMEOUT_MS , &allMs );
+
+    sim_table_row( { name , sim_fmt( "%d" , sim_tile_count() ) , sim_fmt( "%d" , sim_diameter() ) ,
+                     sim_fmt( "%.1f" , firstMs / 60000 ) , allMs >= 0 ? sim_fmt( "%.1f" , allMs / 60000 ) : "-" ,
+                     sim_fmt( "%.1f" , FULL_BYTES * 1000.0 / firstMs ) ,
+                     allMs >= 0 && allRight( origin ) ? "yes" : "no" } );
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library> [pulse loss %%]\n" , argv[0] );
+        return 1;
+    }
+
+    const char *library = argv[1];
+
+    SimConfig config;
+
+    if ( argc > 2 ) {
+        config.pulseLossPct = atof( argv[2] );
+    }
+
+    printf( "Seed: ms until a %d byte image is everywhere (median, runs that got there) "
+            "(%d runs each, %.1f%% clock skew, %.2f%% pulse loss, %uus per loop)\n\n" ,
+            IMAGE_BYTES , RUNS , config.skewPct , config.pulseLossPct , config.loopUs );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "first" , "all" , "per hop" , "bytes/s" , "right" } );
+
+    for( int n : { 2 , 4 , 8 , 16 } ) {
+        benchLayout( sim_fmt( "line %d" , n ).c_str() , library , config , [n]() { return sim_add_line( n ).front(); } );
+    }
+
+    for( int radius : { 1 , 2 , 3 } ) {
+        benchLayout( sim_fmt( "hex r%d" , radius ).c_str() , library , config , [radius]() { return sim_add_hexagon( radius ).front(); } );
+    }
+
+    printf( "\nSecond image seeded from the far end once the first is everywhere, ms until every tile had exactly that image\n\n" );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "all" } );
+
+    benchReplace( "line 4" , library , config , []() { return sim_add_line( 4 ); } );
+    benchReplace( "hex r2" , library , config , []() { return sim_add_hexagon( 2 ); } );
+
+    printf( "\nFull size %d byte image, minutes\n\n" , FULL_BYTES );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "first" , "all" , "bytes/s" , "right" } );
+
+    benchFull( "line 2" , library , config , []() { return sim_add_line( 2 ).front(); } );
+    benchFull( "line 8" , library , config , []() { return sim_add_line( 8 ).front(); } );
+    benchFull( "hex r2" , library , config , []() { return sim_add_hexagon( 2 ).front(); } );
+
+    return 0;
+
+}
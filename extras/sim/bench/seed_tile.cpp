@@ -0,0 +1,54 @@
+/*
+ * seed_tile.cpp
+ *
+ * Benchmark sketch for seed.h. We keep a copy of every block that comes in so the benchmark can check that the
+ * image that got here is the one that was sent.
+ *
+ */
+
+#include <string.h>
+
+#include <avr/pgmspace.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+#include "seed.h"
+
+#include "simtile.h"
+
+static bool startFlag;
+static uint16_t startLength;
+
+static byte received[HOST_FLASH_SIZE];
+
+// Goes out on the next pass through loop(), like a real sketch would do it
+
+SIM_EXPORT void bench_start( uint16_t length ) {
+    startLength = length;
+    startFlag   = true;
+}
+
+SIM_EXPORT bool bench_complete(void) {
+    return isSeedComplete();
+}
+
+SIM_EXPORT const byte *bench_received_image(void) {
+    return received;
+}
+
+void seed_callback_onBlock( uint16_t offset , const byte *data ) {
+    memcpy( received + offset , data , SEED_BLOCK_SIZE );
+}
+
+void setup() {
+    isSeeding();                    // Start listening for seeds
+}
+
+void loop() {
+
+    if (startFlag) {
+        seedStart( startLength );
+        startFlag = false;
+    }
+
+}
@@ -0,0 +1,156 @@
+/*
+ * timesync_bench.cpp
+ *
+ * How long timesync takes to pull a cluster onto one clock, and how close the clocks stay after that.
+ *
+ * The tiles power up over BOOT_SPREAD_MS, so they start out with clocks up to that far apart (more than a
+ * big jump, so the second opinion logic gets used). Then we compare every tile's clusterMillis() at the same
+ * moment and call the difference between the biggest and smallest the spread. We time how long until the
+ * spread first gets down to COARSE_MS and to FINE_MS, and then watch it for HOLD_MS to see how far apart the
+ * clocks wander.
+ *
+ * Each layout runs at the default 2% clock skew and at 5%. The timesync docs allow for 10%, but two tiles with
+ * clocks more than about 12% apart can't decode each other's IR at all (the pulse spacing is 300us and the receive
+ * window is 256us), so there is nothing for timesync to do there.
+ *
+ *    timesync_bench <tile library> [pulse loss %]
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "sim.h"
+
+#define RUNS            5
+#define BOOT_SPREAD_MS  5000
+#define COARSE_MS       50              // A few frames of an animation
+#define FINE_MS         20              // About one frame at 50Hz
+#define TIMEOUT_MS      60000
+#define HOLD_MS         30000
+#define SAMPLE_MS       50
+
+static double spread(void) {
+
+    double low = 1e300 , high = -1e300;
+
+    for( int t=0; t<sim_tile_count(); t++ ) {
+
+        double m = sim_tile_ms( t ) + sim_call<long>( t , "bench_cluster_offset" );
+
+        low  = std::min( low , m );
+        high = std::max( high , m );
+
+    }
+
+    return high - low;
+
+}
+
+// Median of the runs that got there, and how many did
+
+static std::string reached( std::vector<double> times ) {
+
+    std::sort( times.begin() , times.end() );
+    times.erase( times.begin() , std::upper_bound( times.begin() , times.end() , -1.0 ) );
+
+    if ( times.empty() ) {
+        return sim_fmt( "- 0/%d" , RUNS );
+    }
+
+    return sim_fmt( "%.0f %d/%d" , times[ times.size() / 2 ] , (int) times.size() , RUNS );
+
+}
+
+template <typename L> static void benchLayout( const char *name , const char *library , SimConfig config , L layout ) {
+
+    std::vector<double> coarseTimes , fineTimes;
+    std::vector<double> spreads;                // Every sample from every run
+    int tiles = 0 , hops = 0;
+
+    for( int run=0; run<RUNS; run++ ) {
+
+        config.seed = run + 1;
+
+        sim_init( library , config );
+
+        layout();
+
+        sim_run_ms( BOOT_SPREAD_MS );
+
+        tiles = sim_tile_count();
+        hops  = sim_diameter();
+
+        double start = sim_now_ms();
+
+        double coarse = sim_run_until( []() { return spread() <= COARSE_MS; } , TIMEOUT_MS , 10 );
+
+        double fine = -1;
+
+        if ( coarse >= 0 ) {
+            fine = sim_run_until( []() { return spread() <= FINE_MS; } , TIMEOUT_MS - coarse , 10 );
+        }
+
+        coarseTimes.push_back( coarse );
+        fineTimes.push_back( fine >= 0 ? sim_now_ms() - start : -1 );
+
+        for( int s=0; s < HOLD_MS / SAMPLE_MS; s++ ) {
+            sim_run_ms( SAMPLE_MS );
+            spreads.push_back( spread() );
+        }
+
+    }
+
+    std::sort( spreads.begin() , spreads.end() );
+
+    sim_table_row( { name , sim_fmt( "%d" , tiles ) , sim_fmt( "%d" , hops ) , sim_fmt( "%.0f%%" , config.skewPct ) ,
+                     reached( coarseTimes ) , reached( fineTimes ) ,
+                     sim_fmt( "%.0f" , spreads[ spreads.size() / 2 ] ) ,
+                     sim_fmt( "%.0f" , spreads[ ( spreads.size() * 99 ) / 100 ] ) ,
+                     sim_fmt( "%.0f" , spreads.back() ) } );
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library> [pulse loss %%]\n" , argv[0] );
+        return 1;
+    }
+
+    const char *library = argv[1];
+
+    SimConfig config;
+
+    config.bootSpreadMs = BOOT_SPREAD_MS;
+
+    if ( argc > 2 ) {
+        config.pulseLossPct = atof( argv[2] );
+    }
+
+    printf( "Timesync: ms until the spread is down to %dms and %dms (median, runs that got there), "
+            "then the spread in ms over the next %ds (%d runs each, %.2f%% pulse loss, %uus per loop)\n\n" ,
+            COARSE_MS , FINE_MS , HOLD_MS / 1000 , RUNS , config.pulseLossPct , config.loopUs );
+
+    sim_table_row( { "layout" , "tiles" , "hops" , "skew" , sim_fmt( "to %dms" , COARSE_MS ) , sim_fmt( "to %dms" , FINE_MS ) ,
+                     "spread med" , "spread 99%" , "spread max" } );
+
+    for( double skew : { 2.0 , 5.0 } ) {
+
+        config.skewPct = skew;
+
+        for( int n : { 2 , 4 , 8 , 16 } ) {
+            benchLayout( sim_fmt( "line %d" , n ).c_str() , library , config , [n]() { sim_add_line( n ); } );
+        }
+
+        for( int radius : { 1 , 2 , 3 } ) {
+            benchLayout( sim_fmt( "hex r%d" , radius ).c_str() , library , config , [radius]() { sim_add_hexagon( radius ); } );
+        }
+
+    }
+
+    return 0;
+
+}
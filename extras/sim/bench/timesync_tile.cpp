@@ -0,0 +1,30 @@
+/*
+ * timesync_tile.cpp
+ *
+ * Benchmark sketch for timesync.h. The benchmark compares everyone's cluster clock at the same moment to see how far apart they are.
+ *
+ * millis() stays frozen for a whole pass through loop(), and a pass can take several ms when blinkstate is sending,
+ * so asking for clusterMillis() from outside could get a stale answer. Instead we keep how far the cluster clock is
+ * from our own, and the benchmark adds that to how long we have been running.
+ *
+ */
+
+#include "blinklib.h"
+#include "blinkstate.h"
+#include "timesync.h"
+
+#include "simtile.h"
+
+static long clusterOffset;
+
+SIM_EXPORT long bench_cluster_offset(void) {
+    return clusterOffset;
+}
+
+void setup() {
+    clusterMillis();                // Start syncing
+}
+
+void loop() {
+    clusterOffset = clusterMillis() - millis();
+}
@@ -0,0 +1,16 @@
+/*
+ * Host stand in for <avr/boot.h>. There is no flash to write on the host, so these only keep the code compiling.
+ */
+
+#ifndef HOST_AVR_BOOT_H_
+#define HOST_AVR_BOOT_H_
+
+#include <avr/io.h>
+
+#define boot_page_fill( address , data )    ( (void) (address) , (void) (data) )
+#define boot_page_erase( address )          ( (void) (address) )
+#define boot_page_write( address )          ( (void) (address) )
+#define boot_spm_busy_wait()                do {} while (0)
+#define boot_rww_enable()                   do {} while (0)
+
+#endif
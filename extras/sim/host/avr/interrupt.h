@@ -0,0 +1,27 @@
+/*
+ * avr/interrupt.h for host builds
+ *
+ * There is only one thread on the host, so interrupts are just functions that the test calls when it wants
+ * the interrupt to happen. sei() and cli() track the I bit in SREG so code that checks it still works.
+ *
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include "avr/io.h"
+
+#define SREG_I 7
+
+#define sei()   ( SREG |= _BV( SREG_I ) )
+#define cli()   ( SREG &= ~_BV( SREG_I ) )
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+
+#define reti()  return
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,144 @@
+/*
+ * avr/io.h for host builds
+ *
+ * Just enough of the ATmega168PB to compile the core and libraries on a PC. Every I/O register is a plain
+ * variable (see avr_host.cpp) so tests can poke inputs in and read outputs back. Bit numbers match the datasheet.
+ *
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+#include "avr/sfr_defs.h"
+
+#define AVR_HOST_REGISTERS(X) \
+    X(ADCH) X(ADCL) X(ADCSRA) X(ADMUX) X(DDRB) X(DDRC) X(DDRD) X(DDRE) X(GTCCR) X(MCUSR) \
+    X(OCR0A) X(OCR0B) X(OCR2A) X(OCR2B) X(PCICR) X(PCIFR) X(PCMSK0) X(PCMSK1) X(PCMSK2) \
+    X(PINB) X(PINC) X(PIND) X(PINE) X(PORTB) X(PORTC) X(PORTD) X(PORTE) X(SREG) X(SMCR) X(PRR0) \
+    X(TCCR0A) X(TCCR0B) X(TCCR1A) X(TCCR1B) X(TCCR2A) X(TCCR2B) X(TCNT0) X(TCNT2) \
+    X(TIFR0) X(TIFR2) X(TIMSK0) X(TIMSK1) X(TIMSK2) X(UCSR0A) X(UCSR0B) X(UCSR0C) X(UDR0) X(UBRR0H) X(UBRR0L) \
+    X(WDTCSR) X(CLKPR) X(EIMSK) X(SPMCSR) X(GPIOR0) X(GPIOR1) X(GPIOR2)
+
+#define AVR_HOST_DECLARE_REGISTER(r) extern volatile uint8_t r;
+AVR_HOST_REGISTERS( AVR_HOST_DECLARE_REGISTER )
+
+extern volatile uint16_t ADC;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t TCNT1;
+
+// ADC
+
+#define ADPS0   0
+#define ADPS1   1
+#define ADPS2   2
+#define ADIE    3
+#define ADIF    4
+#define ADATE   5
+#define ADSC    6
+#define ADEN    7
+
+#define MUX0    0
+#define MUX1    1
+#define MUX2    2
+#define MUX3    3
+#define ADLAR   5
+#define REFS0   6
+#define REFS1   7
+
+// Timers
+
+#define WGM00   0
+#define WGM01   1
+#define COM0B0  4
+#define COM0B1  5
+#define COM0A0  6
+#define COM0A1  7
+#define CS00    0
+#define CS01    1
+#define CS02    2
+#define WGM02   3
+#define FOC0B   6
+#define FOC0A   7
+#define TOIE0   0
+#define OCIE0A  1
+#define TOV0    0
+
+#define WGM20   0
+#define WGM21   1
+#define COM2B0  4
+#define COM2B1  5
+#define COM2A0  6
+#define COM2A1  7
+#define CS20    0
+#define CS21    1
+#define CS22    2
+#define WGM22   3
+#define FOC2B   6
+#define FOC2A   7
+#define TOIE2   0
+#define OCIE2A  1
+#define OCIE2B  2
+
+#define CS10    0
+#define CS11    1
+#define WGM12   3
+#define OCIE1A  1
+
+#define PSRSYNC 0
+#define PSRASY  1
+#define TSM     7
+
+// Pin change interrupts
+
+#define PCIE0   0
+#define PCIE1   1
+#define PCIE2   2
+
+#define PCINT0  0
+#define PCINT5  5
+#define PCINT8  0
+#define PCINT9  1
+#define PCINT10 2
+#define PCINT11 3
+#define PCINT12 4
+#define PCINT13 5
+#define PCINT14 6
+#define PCINT23 7
+
+// Misc
+
+#define RXC0    7
+#define TXC0    6
+#define UDRE0   5
+#define RXEN0   4
+#define TXEN0   3
+#define U2X0    1
+
+#define WDP0    0
+#define WDP1    1
+#define WDP2    2
+#define WDE     3
+#define WDCE    4
+#define WDP3    5
+#define WDIE    6
+#define WDIF    7
+#define WDRF    3
+
+#define CLKPS0  0
+#define CLKPCE  7
+
+#define SE      0
+
+#define SPMEN   0
+#define PGERS   1
+#define PGWRT   2
+#define BLBSET  3
+#define RWWSRE  4
+#define RWWSB   6
+
+#define SPM_PAGESIZE    128
+#define FLASHEND        0x3fff
+
+#endif /* HOST_AVR_IO_H_ */
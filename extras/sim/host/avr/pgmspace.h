@@ -0,0 +1,64 @@
+/*
+ * avr/pgmspace.h for host builds
+ *
+ * Flash is just memory on the host. The one exception is code that reads its own program image by address
+ * (like seed.cpp). Addresses below HOST_FLASH_SIZE can never be real host pointers, so those reads go to
+ * host_flash instead, which a test can fill with a stand-in image.
+ *
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define HOST_FLASH_SIZE 0x4000
+
+extern uint8_t host_flash[HOST_FLASH_SIZE];
+
+static inline const uint8_t *host_pgm_address( const void *p ) {
+    uintptr_t a = (uintptr_t) p;
+    return a < HOST_FLASH_SIZE ? &host_flash[a] : (const uint8_t *) p;
+}
+
+static inline uint8_t host_pgm_read_byte( const void *p ) {
+    return *host_pgm_address( p );
+}
+
+static inline uint16_t host_pgm_read_word( const void *p ) {
+    const uint8_t *b = host_pgm_address( p );
+    uint16_t w;
+    memcpy( &w , b , sizeof( w ) );
+    return w;
+}
+
+// A word is big enough for a pointer on the AVR, but not here. Tables of pointers in flash (like the anode
+// ports in pixel.cpp) are read with pgm_read_word(), so pointer sized entries come back whole.
+
+template <typename T> static inline uintptr_t host_pgm_read_word_sized( const T *p ) {
+    if ( sizeof( T ) > sizeof( uint16_t ) ) {
+        T v;
+        memcpy( (void *) &v , host_pgm_address( (const void *) p ) , sizeof( v ) );
+        return (uintptr_t) v;
+    }
+    return host_pgm_read_word( (const void *) p );
+}
+
+static inline uintptr_t host_pgm_read_word_sized( uintptr_t address ) {
+    return host_pgm_read_word( (const void *) address );
+}
+
+#define pgm_read_byte(p)    host_pgm_read_byte( (const void *) (p) )
+#define pgm_read_word(p)    host_pgm_read_word_sized( p )
+#define pgm_read_byte_near(p) pgm_read_byte(p)
+#define pgm_read_word_near(p) pgm_read_word(p)
+
+#define memcpy_P    memcpy
+#define strlen_P    strlen
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,13 @@
+/*
+ * avr/power.h for host builds. Nothing to power down on the host.
+ */
+
+#ifndef HOST_AVR_POWER_H_
+#define HOST_AVR_POWER_H_
+
+#define power_all_disable()
+#define power_all_enable()
+#define power_adc_disable()
+#define power_adc_enable()
+
+#endif /* HOST_AVR_POWER_H_ */
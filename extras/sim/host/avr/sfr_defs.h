@@ -0,0 +1,13 @@
+/*
+ * avr/sfr_defs.h for host builds
+ */
+
+#ifndef HOST_AVR_SFR_DEFS_H_
+#define HOST_AVR_SFR_DEFS_H_
+
+#define _BV(bit) (1 << (bit))
+
+#define bit_is_set(sfr, bit)    ( (sfr) & _BV(bit) )
+#define bit_is_clear(sfr, bit)  ( !( (sfr) & _BV(bit) ) )
+
+#endif /* HOST_AVR_SFR_DEFS_H_ */
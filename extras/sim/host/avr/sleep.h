@@ -0,0 +1,18 @@
+/*
+ * avr/sleep.h for host builds. Sleeping returns right away.
+ */
+
+#ifndef HOST_AVR_SLEEP_H_
+#define HOST_AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_PWR_DOWN     2
+
+#define set_sleep_mode(mode)    ( (void) (mode) )
+#define sleep_enable()
+#define sleep_disable()
+#define sleep_cpu()
+#define sleep_mode()
+#define sleep_bod_disable()
+
+#endif /* HOST_AVR_SLEEP_H_ */
@@ -0,0 +1,15 @@
+/*
+ * avr/wdt.h for host builds. There is no watchdog on the host.
+ */
+
+#ifndef HOST_AVR_WDT_H_
+#define HOST_AVR_WDT_H_
+
+#define WDTO_15MS   0
+#define WDTO_1S     6
+
+#define wdt_reset()
+#define wdt_enable(timeout) ( (void) (timeout) )
+#define wdt_disable()
+
+#endif /* HOST_AVR_WDT_H_ */
@@ -0,0 +1,18 @@
+/*
+ * avr_host.cpp
+ *
+ * Storage for the stand-in I/O registers and flash declared in the host avr headers.
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#define AVR_HOST_DEFINE_REGISTER(r) volatile uint8_t r;
+AVR_HOST_REGISTERS( AVR_HOST_DEFINE_REGISTER )
+
+volatile uint16_t ADC;
+volatile uint16_t OCR1A;
+volatile uint16_t TCNT1;
+
+uint8_t host_flash[HOST_FLASH_SIZE];
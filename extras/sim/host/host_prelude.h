@@ -0,0 +1,16 @@
+/*
+ * Forced in ahead of everything in host builds.
+ *
+ * glibc already has a ulong type that is not the same as the one in ArduinoTypes.h, so get glibc's out of the way
+ * first and then point ours at a different name.
+ */
+
+#ifndef HOST_PRELUDE_H_
+#define HOST_PRELUDE_H_
+
+#include <stdlib.h>
+#include <sys/types.h>
+
+#define ulong blink_ulong
+
+#endif /* HOST_PRELUDE_H_ */
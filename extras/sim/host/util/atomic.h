@@ -0,0 +1,19 @@
+/*
+ * util/atomic.h for host builds
+ *
+ * Nothing can interrupt us on the host, so an atomic block is just a block.
+ *
+ */
+
+#ifndef HOST_UTIL_ATOMIC_H_
+#define HOST_UTIL_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON      1
+#define NONATOMIC_RESTORESTATE 0
+#define NONATOMIC_FORCEOFF  1
+
+#define ATOMIC_BLOCK(type)      for ( int host_atomic_once = ( (void) (type) , 1 ) ; host_atomic_once ; host_atomic_once = 0 )
+#define NONATOMIC_BLOCK(type)   ATOMIC_BLOCK(type)
+
+#endif /* HOST_UTIL_ATOMIC_H_ */
@@ -0,0 +1,24 @@
+/*
+ * util/crc16.h for host builds. Same math as the avr-libc versions, in plain C.
+ */
+
+#ifndef HOST_UTIL_CRC16_H_
+#define HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update( uint16_t crc , uint8_t data ) {
+    data ^= crc & 0xff;
+    data ^= data << 4;
+    return ( ( (uint16_t) data << 8 ) | ( crc >> 8 ) ) ^ (uint8_t) ( data >> 4 ) ^ ( (uint16_t) data << 3 );
+}
+
+static inline uint16_t _crc16_update( uint16_t crc , uint8_t a ) {
+    crc ^= a;
+    for ( int i = 0 ; i < 8 ; ++i ) {
+        crc = ( crc & 1 ) ? ( crc >> 1 ) ^ 0xA001 : ( crc >> 1 );
+    }
+    return crc;
+}
+
+#endif /* HOST_UTIL_CRC16_H_ */
@@ -0,0 +1,631 @@
+/*
+ * sim.cpp
+ *
+ * The scheduler, the IR medium and the tile loader behind sim.h.
+ *
+ * Each tile gets its own copy of the tile library (dlopen() only loads a given file once, so we copy it), which
+ * gives every tile its own set of globals. The tile runs in a ucontext coroutine of its own, and only gives the CPU
+ * back when it waits for tile time to pass (sending IR, or the cost of a pass through loop()). Timer interrupts are
+ * delivered between those points. Time is kept in nanoseconds so clock skew does not round away.
+ *
+ */
+
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <map>
+#include <queue>
+
+#include "sim.h"
+#include "simtile.h"
+
+#define TICK_US             256         // Timer interrupt period in tile time
+#define PULSE_BLIND_NS      12000       // How long an LED is busy flashing (and can not see anything)
+#define STACK_SIZE          ( 256 * 1024 )
+
+#define NEVER               UINT64_MAX
+
+struct SimLink {
+    int tile;                           // -1=nobody there
+    uint8_t face;
+};
+
+struct SimTile {
+
+    void *library;
+
+    sim_tile_tick_t tick;
+
+    ucontext_t context;
+    std::vector<char> stack;
+
+    double nsPerUs;                     // Real nanoseconds per microsecond of this tile's time
+    uint64_t bootTime;
+    uint64_t ticks;
+
+    int q , r;
+    uint8_t rotation;                   // Grid direction our face 0 points
+    bool removedFlag;
+
+    SimLink links[SIM_FACE_COUNT];
+    uint64_t lastPulseTime[SIM_FACE_COUNT];
+
+    uint8_t irTriggered;                // LEDs that saw light since the last sample
+
+    std::map<std::string,void *> symbols;
+
+};
+
+enum SimEventKind { EVENT_TICK , EVENT_RESUME };
+
+struct SimEvent {
+
+    uint64_t time;
+    uint64_t order;                     // Keeps ties in the order they were scheduled, so runs are repeatable
+    int tile;
+    SimEventKind kind;
+
+    bool operator>( const SimEvent &other ) const {
+        return time != other.time ? time > other.time : order > other.order;
+    }
+
+};
+
+static SimConfig config;
+static std::string libraryPath;
+static std::vector<char> libraryImage;
+
+static std::vector<SimTile *> tiles;
+static std::priority_queue<SimEvent,std::vector<SimEvent>,std::greater<SimEvent>> events;
+static uint64_t eventOrder;
+
+static uint64_t now;                    // Nanoseconds since sim_init()
+static int current = -1;                // Tile whose code is running
+static bool coroutineFlag;              // Is it running in its own coroutine (so it can wait)?
+static ucontext_t schedulerContext;
+
+static SimStats stats;
+
+static uint64_t rngState;
+
+// xorshift64*. Plenty for picking skews and dropping pulses, and the same everywhere.
+
+static uint64_t rngNext(void) {
+
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+
+    return rngState * 2685821657736338717ULL;
+
+}
+
+static double rngUniform(void) {
+    return ( rngNext() >> 11 ) * ( 1.0 / 9007199254740992.0 );
+}
+
+static void die( const char *format , ... ) {
+
+    va_list args;
+    va_start( args , format );
+    vfprintf( stderr , format , args );
+    va_end( args );
+
+    fputc( '\n' , stderr );
+
+    exit( 1 );
+
+}
+
+static void schedule( int tile , uint64_t time , SimEventKind kind ) {
+    events.push( SimEvent{ time , eventOrder++ , tile , kind } );
+}
+
+static uint64_t tickTime( SimTile *t , uint64_t tick ) {
+    return t->bootTime + (uint64_t) ( tick * TICK_US * t->nsPerUs );
+}
+
+/** Called by the tiles **/
+
+extern "C" void sim_host_wait_us( uint32_t us ) {
+
+    if ( !coroutineFlag ) {
+        die( "sim: tile %d tried to wait outside of its own loop (in a sim_call?)" , current );
+    }
+
+    SimTile *t = tiles[current];
+
+    schedule( current , now + (uint64_t) ( ( us ? us : 1 ) * t->nsPerUs ) , EVENT_RESUME );
+
+    swapcontext( &t->context , &schedulerContext );
+
+}
+
+extern "C" void sim_host_loop_pass(void) {
+
+    stats.loopPasses++;
+
+    sim_host_wait_us( config.loopUs );
+
+}
+
+extern "C" void sim_host_ir_pulse( uint8_t bitmask ) {
+
+    SimTile *t = tiles[current];
+
+    for( int f=0; f<SIM_FACE_COUNT; f++ ) {
+
+        if ( !( bitmask & ( 1 << f ) ) ) {
+            continue;
+        }
+
+        stats.pulsesSent++;
+
+        t->lastPulseTime[f] = now;
+
+        SimLink link = t->links[f];
+
+        if ( link.tile < 0 ) {
+            continue;
+        }
+
+        if ( rngUniform() * 100 < config.pulseLossPct ) {
+            stats.pulsesLost++;
+            continue;
+        }
+
+        SimTile *them = tiles[link.tile];
+
+        uint64_t theirPulse = them->lastPulseTime[link.face];
+
+        if ( theirPulse != NEVER && now - theirPulse < PULSE_BLIND_NS ) {
+            stats.pulsesCollided++;
+            continue;
+        }
+
+        them->irTriggered |= 1 << link.face;
+
+    }
+
+}
+
+extern "C" uint8_t sim_host_ir_sample(void) {
+
+    SimTile *t = tiles[current];
+
+    uint8_t bits = t->irTriggered;
+
+    t->irTriggered = 0;
+
+    return bits;
+
+}
+
+/** Loading **/
+
+static void coroutineEntry( void ) {
+
+    sim_tile_main_t tileMain = (sim_tile_main_t) sim_symbol( current , "sim_tile_main" );
+
+    tileMain();
+
+    die( "sim: tile %d returned from main" , current );
+
+}
+
+static void loadLibraryImage(void) {
+
+    FILE *f = fopen( libraryPath.c_str() , "rb" );
+
+    if ( !f ) {
+        die( "sim: can not open %s" , libraryPath.c_str() );
+    }
+
+    fseek( f , 0 , SEEK_END );
+    libraryImage.resize( ftell( f ) );
+    fseek( f , 0 , SEEK_SET );
+
+    if ( fread( libraryImage.data() , 1 , libraryImage.size() , f ) != libraryImage.size() ) {
+        die( "sim: can not read %s" , libraryPath.c_str() );
+    }
+
+    fclose( f );
+
+}
+
+// A fresh copy of the tile library with its own globals
+
+static void *loadTileLibrary(void) {
+
+    char path[] = "/tmp/blinksim-XXXXXX";
+
+    int fd = mkstemp( path );
+
+    if ( fd < 0 || write( fd , libraryImage.data() , libraryImage.size() ) != (ssize_t) libraryImage.size() ) {
+        die( "sim: can not write %s" , path );
+    }
+
+    close( fd );
+
+    void *library = dlopen( path , RTLD_NOW | RTLD_LOCAL );
+
+    unlink( path );
+
+    if ( !library ) {
+        die( "sim: %s" , dlerror() );
+    }
+
+    return library;
+
+}
+
+void sim_init( const std::string &library , const SimConfig &newConfig ) {
+
+    for( SimTile *t : tiles ) {
+        dlclose( t->library );
+        delete t;
+    }
+
+    tiles.clear();
+    events = decltype( events )();
+
+    config      = newConfig;
+    libraryPath = library;
+    now         = 0;
+    eventOrder  = 0;
+    stats       = SimStats();
+    rngState    = 0x9e3779b97f4a7c15ULL ^ ( (uint64_t) config.seed << 1 );
+
+    loadLibraryImage();
+
+}
+
+/** Layout **/
+
+// Axial grid steps for each of the 6 directions, going around in the same order as the faces
+
+static const int directionQ[SIM_FACE_COUNT] = { 1 , 1 , 0 , -1 , -1 , 0 };
+static const int directionR[SIM_FACE_COUNT] = { 0 , -1 , -1 , 0 , 1 , 1 };
+
+static int tileAt( int q , int r ) {
+
+    for( size_t i=0; i<tiles.size(); i++ ) {
+        if ( tiles[i]->q == q && tiles[i]->r == r ) {
+            return i;
+        }
+    }
+
+    return -1;
+
+}
+
+// Connect tile `a` to whatever is next to it in `direction`
+
+static void linkDirection( int a , int direction ) {
+
+    SimTile *t = tiles[a];
+
+    int b = tileAt( t->q + directionQ[direction] , t->r + directionR[direction] );
+
+    if ( b < 0 || tiles[b]->removedFlag || t->removedFlag ) {
+        return;
+    }
+
+    SimTile *them = tiles[b];
+
+    uint8_t ourFace   = ( direction - t->rotation + SIM_FACE_COUNT ) % SIM_FACE_COUNT;
+    uint8_t theirFace = ( direction + 3 - them->rotation + SIM_FACE_COUNT ) % SIM_FACE_COUNT;
+
+    t->links[ourFace]       = SimLink{ b , theirFace };
+    them->links[theirFace]  = SimLink{ a , ourFace };
+
+}
+
+int sim_add_tile( int q , int r ) {
+
+    if ( tileAt( q , r ) >= 0 ) {
+        die( "sim: there is already a tile at %d,%d" , q , r );
+    }
+
+    SimTile *t = new SimTile();
+
+    int n = tiles.size();
+
+    tiles.push_back( t );
+
+    t->library = loadTileLibrary();
+    t->tick    = (sim_tile_tick_t) sim_symbol( n , "sim_tile_tick" );
+
+    t->q        = q;
+    t->r        = r;
+    t->rotation = rngNext() % SIM_FACE_COUNT;
+    t->nsPerUs  = 1000.0 / ( 1.0 + ( rngUniform() * 2 - 1 ) * config.skewPct / 100 );
+    t->bootTime = now + (uint64_t) ( rngUniform() * config.bootSpreadMs * 1e6 );
+
+    for( int f=0; f<SIM_FACE_COUNT; f++ ) {
+        t->links[f]         = SimLink{ -1 , 0 };
+        t->lastPulseTime[f] = NEVER;
+    }
+
+    uint8_t serialno[9];
+
+    for( int i=0; i<9; i++ ) {
+        serialno[i] = rngNext();
+    }
+
+    sim_call<void>( n , "sim_tile_serialno" , (const uint8_t *) serialno );
+
+    t->stack.resize( STACK_SIZE );
+
+    getcontext( &t->context );
+
+    t->context.uc_stack.ss_sp   = t->stack.data();
+    t->context.uc_stack.ss_size = t->stack.size();
+    t->context.uc_link          = NULL;
+
+    makecontext( &t->context , coroutineEntry , 0 );
+
+    schedule( n , t->bootTime , EVENT_RESUME );
+    schedule( n , tickTime( t , 1 ) , EVENT_TICK );
+
+    for( int d=0; d<SIM_FACE_COUNT; d++ ) {
+        linkDirection( n , d );
+    }
+
+    return n;
+
+}
+
+std::vector<int> sim_add_line( int count ) {
+
+    std::vector<int> added;
+
+    for( int i=0; i<count; i++ ) {
+        added.push_back( sim_add_tile( i , 0 ) );
+    }
+
+    return added;
+
+}
+
+std::vector<int> sim_add_hexagon( int radius ) {
+
+    std::vector<int> added;
+
+    for( int q=-radius; q<=radius; q++ ) {
+        for( int r=-radius; r<=radius; r++ ) {
+            if ( abs( q + r ) <= radius ) {
+                added.push_back( sim_add_tile( q , r ) );
+            }
+        }
+    }
+
+    return added;
+
+}
+
+void sim_remove_tile( int tile ) {
+
+    SimTile *t = tiles[tile];
+
+    for( int f=0; f<SIM_FACE_COUNT; f++ ) {
+
+        SimLink link = t->links[f];
+
+        if ( link.tile >= 0 ) {
+            tiles[link.tile]->links[link.face] = SimLink{ -1 , 0 };
+        }
+
+        t->links[f] = SimLink{ -1 , 0 };
+
+    }
+
+    t->removedFlag = true;
+
+}
+
+void sim_restore_tile( int tile ) {
+
+    tiles[tile]->removedFlag = false;
+
+    for( int d=0; d<SIM_FACE_COUNT; d++ ) {
+        linkDirection( tile , d );
+    }
+
+}
+
+int sim_neighbor( int tile , int face , int *theirFace ) {
+
+    SimLink link = tiles[tile]->links[face];
+
+    if ( theirFace ) {
+        *theirFace = link.face;
+    }
+
+    return link.tile;
+
+}
+
+int sim_tile_count(void) {
+    return tiles.size();
+}
+
+std::vector<int> sim_hops_from( int from ) {
+
+    std::vector<int> hops( tiles.size() , -1 );
+    std::queue<int> todo;
+
+    hops[from] = 0;
+    todo.push( from );
+
+    while ( !todo.empty() ) {
+
+        int a = todo.front();
+        todo.pop();
+
+        for( SimLink link : tiles[a]->links ) {
+
+            if ( link.tile >= 0 && hops[link.tile] < 0 ) {
+                hops[link.tile] = hops[a] + 1;
+                todo.push( link.tile );
+            }
+
+        }
+
+    }
+
+    return hops;
+
+}
+
+int sim_diameter(void) {
+
+    int diameter = 0;
+
+    for( size_t a=0; a<tiles.size(); a++ ) {
+        for( int h : sim_hops_from( a ) ) {
+            if ( h > diameter ) {
+                diameter = h;
+            }
+        }
+    }
+
+    return diameter;
+
+}
+
+/** Running **/
+
+void sim_run_ms( double ms ) {
+
+    uint64_t end = now + (uint64_t) ( ms * 1e6 );
+
+    double noisePerTick = config.noisePerSec * TICK_US / 1e6;
+
+    while ( !events.empty() && events.top().time <= end ) {
+
+        SimEvent e = events.top();
+        events.pop();
+
+        now     = e.time;
+        current = e.tile;
+
+        SimTile *t = tiles[e.tile];
+
+        if ( e.kind == EVENT_TICK ) {
+
+            if ( noisePerTick > 0 ) {
+                for( int f=0; f<SIM_FACE_COUNT; f++ ) {
+                    if ( rngUniform() < noisePerTick ) {
+                        t->irTriggered |= 1 << f;
+                    }
+                }
+            }
+
+            t->tick();
+
+            t->ticks++;
+
+            schedule( e.tile , tickTime( t , t->ticks + 1 ) , EVENT_TICK );
+
+        } else {
+
+            coroutineFlag = true;
+
+            swapcontext( &schedulerContext , &t->context );
+
+            coroutineFlag = false;
+
+        }
+
+        current = -1;
+
+    }
+
+    now = end;
+
+}
+
+double sim_now_ms(void) {
+    return now / 1e6;
+}
+
+double sim_clock_rate( int tile ) {
+    return 1000.0 / tiles[tile]->nsPerUs;
+}
+
+double sim_tile_ms( int tile ) {
+
+    SimTile *t = tiles[tile];
+
+    if ( now < t->bootTime ) {
+        return 0;
+    }
+
+    return ( now - t->bootTime ) / ( t->nsPerUs * 1000 );
+
+}
+
+void sim_enter_tile( int tile ) {
+    current = tile;
+}
+
+void sim_leave_tile(void) {
+    current = -1;
+}
+
+void *sim_symbol( int tile , const char *name ) {
+
+    SimTile *t = tiles[tile];
+
+    auto found = t->symbols.find( name );
+
+    if ( found != t->symbols.end() ) {
+        return found->second;
+    }
+
+    void *symbol = dlsym( t->library , name );
+
+    if ( !symbol ) {
+        die( "sim: the tile library does not export %s" , name );
+    }
+
+    t->symbols[name] = symbol;
+
+    return symbol;
+
+}
+
+SimStats sim_stats(void) {
+    return stats;
+}
+
+/** Output **/
+
+void sim_table_row( const std::vector<std::string> &cells ) {
+
+    for( size_t i=0; i<cells.size(); i++ ) {
+        printf( i ? " %12s" : "%-14s" , cells[i].c_str() );
+    }
+
+    printf( "\n" );
+
+}
+
+std::string sim_fmt( const char *format , ... ) {
+
+    char buffer[64];
+
+    va_list args;
+    va_start( args , format );
+    vsnprintf( buffer , sizeof( buffer ) , format , args );
+    va_end( args );
+
+    return buffer;
+
+}
@@ -0,0 +1,165 @@
+/*
+ * sim.h
+ *
+ * A cluster simulator for benchmarking the blinkstate services on a PC.
+ *
+ * Every tile runs the real blinklib, irdata, blinkstate and service code (see simcore.cpp for the few parts that
+ * are faked). Tiles talk by IR pulse, so the real pulse decoding, packet framing, acks and resends all happen just
+ * like on a tile. What the simulator adds is...
+ *
+ *  - A clock per tile that runs off by up to `skewPct` (the RC oscillator spec is a lot worse than most tiles).
+ *  - A random boot time for each tile in the first `bootSpreadMs`.
+ *  - `loopUs` of tile time for each pass through loop() (the real loop() and the services run in zero time,
+ *    so this stands in for both).
+ *  - Pulses that get lost at random (`pulseLossPct`), or because they land while the receiver is flashing
+ *    that same LED.
+ *  - Random ambient triggers on every LED at `noisePerSec`.
+ *
+ * Runs are repeatable. The same config and seed always give the same result.
+ *
+ * A benchmark loads one tile library (built from the services and a benchmark sketch) for every tile, places the
+ * tiles on a hex grid, and then runs time forward while it checks on the tiles through functions that the sketch
+ * exports.
+ *
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define SIM_FACE_COUNT 6
+
+struct SimConfig {
+
+    uint32_t seed = 1;
+
+    double skewPct = 2.0;               // Each tile's clock is off by a random amount up to this much (either way)
+    double bootSpreadMs = 50;           // Tiles power up at random times in this window
+    uint32_t loopUs = 500;              // Tile time each pass through loop() takes
+    double pulseLossPct = 0;            // Chance that any one pulse just does not make it
+    double noisePerSec = 0;             // Ambient triggers per LED per second
+
+};
+
+// Load the tile library and reset everything. Tiles come from `library`, a shared library built with simcore.cpp.
+
+void sim_init( const std::string &library , const SimConfig &config );
+
+// Add a tile at axial hex position (q,r). Every tile gets a random serial number and rotation.
+// Tiles next to each other on the grid are connected as they are added. Returns the tile number.
+
+int sim_add_tile( int q , int r );
+
+// Handy layouts. Each returns the tile numbers it added.
+
+std::vector<int> sim_add_line( int count );             // A straight row
+std::vector<int> sim_add_hexagon( int radius );         // Every spot within `radius` of the center (1, 7, 19, 37...)
+
+// Take a tile out of (or put it back into) the cluster. A removed tile keeps running but can not see anyone.
+
+void sim_remove_tile( int tile );
+void sim_restore_tile( int tile );
+
+// The tile on the other side of `face` of `tile`, or -1 if nobody is there. `theirFace` gets the face that is touching.
+
+int sim_neighbor( int tile , int face , int *theirFace = NULL );
+
+// How many tiles, and the most hops between any two connected tiles (using the current links)
+
+int sim_tile_count(void);
+int sim_diameter(void);
+
+// Hops from `from` to every tile (-1 if not connected)
+
+std::vector<int> sim_hops_from( int from );
+
+// Run the whole cluster forward
+
+void sim_run_ms( double ms );
+
+// Run until `done()` returns true (checked every `stepMs`) or `maxMs` goes by. Returns the time it took or -1.
+
+template <typename F> double sim_run_until( F done , double maxMs , double stepMs = 1 );
+
+double sim_now_ms(void);
+
+// A tile's own idea of how much time has passed (its millis() runs at this rate)
+
+double sim_clock_rate( int tile );
+
+// How long a tile has been running by its own clock, right now. millis() inside the tile is frozen for each pass
+// through loop(), so reading it from out here can be a few ms behind this.
+
+double sim_tile_ms( int tile );
+
+// Find a function or variable that the tile's sketch exported (with SIM_EXPORT), or die trying
+
+void *sim_symbol( int tile , const char *name );
+
+// Call an exported function on a tile. The tile can not block in there (no IR sends).
+
+template <typename R , typename... A> R sim_call( int tile , const char *name , A... args );
+
+// Counters since sim_init()
+
+struct SimStats {
+
+    uint64_t pulsesSent;                // One per LED flashed
+    uint64_t pulsesLost;                // Dropped at random
+    uint64_t pulsesCollided;            // Landed while the receiver was flashing
+    uint64_t loopPasses;
+
+};
+
+SimStats sim_stats(void);
+
+// Print a line of a table, padded so the columns line up
+
+void sim_table_row( const std::vector<std::string> &cells );
+
+std::string sim_fmt( const char *format , ... );
+
+
+/** Implementation of the templates **/
+
+void sim_enter_tile( int tile );
+void sim_leave_tile(void);
+
+struct SimTileScope {
+    SimTileScope( int tile ) { sim_enter_tile( tile ); }
+    ~SimTileScope() { sim_leave_tile(); }
+};
+
+template <typename F> double sim_run_until( F done , double maxMs , double stepMs ) {
+
+    double start = sim_now_ms();
+
+    while ( sim_now_ms() - start < maxMs ) {
+
+        if ( done() ) {
+            return sim_now_ms() - start;
+        }
+
+        sim_run_ms( stepMs );
+
+    }
+
+    return done() ? sim_now_ms() - start : -1;
+
+}
+
+template <typename R , typename... A> R sim_call( int tile , const char *name , A... args ) {
+
+    R (*f)( A... ) = (R (*)( A... )) sim_symbol( tile , name );
+
+    SimTileScope scope( tile );
+
+    return f( args... );
+
+}
+
+#endif /* SIM_H_ */
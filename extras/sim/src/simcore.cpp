@@ -0,0 +1,202 @@
+/*
+ * simcore.cpp
+ *
+ * Stands in for the hardware half of blinkcore (pixel.cpp, ir.cpp, button.cpp, power.cpp, utils.cpp) inside a
+ * simulated tile. Everything above this line - irdata.cpp, blinklib.cpp, blinkstate and the services - is the
+ * real code, so the simulator exercises the same decoding, timing and packet logic that runs on a tile.
+ *
+ *  - The timer ISR is sim_tile_tick(), which the simulator calls every 256us of tile time. It makes the same calls
+ *    in the same order as the TIMER0_OVF_vect and TIMER2_COMPA_vect handlers in pixel.cpp.
+ *  - IR pulses go out through the simulator, paced in tile time like the timer1 pulse train in ir.cpp.
+ *  - The display is just a buffer the benchmarks can read back. Fades jump straight to their target.
+ *  - The button is never down and sleeping returns right away, so tiles stay awake no matter how long a run is.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "shared.h"
+#include "pixel.h"
+#include "ir.h"
+#include "button.h"
+#include "power.h"
+#include "utils.h"
+#include "timer.h"
+
+#include "run.h"
+
+#include "simtile.h"
+
+// Same as the real pixel ISR: a frame is 5 phases per pixel, each PIXEL_TICKS_PER_PHASE timer overflows
+
+#define SIM_FRAME_OVERFLOWS ( TIMER_PHASE_COUNT * PIXEL_COUNT * PIXEL_TICKS_PER_PHASE )
+
+/** Timer **/
+
+static uint8_t overflowFlag;            // Every other tick is a timer0 overflow, the ones between are the timer2 compare
+static uint16_t frameOverflows;
+
+SIM_EXPORT void sim_tile_tick(void) {
+
+    timer_256us_callback_cli();
+
+    overflowFlag = !overflowFlag;
+
+    timer_256us_callback_sei();
+
+    if (overflowFlag) {
+
+        timer_512us_callback_sei();
+
+        if ( ++frameOverflows == SIM_FRAME_OVERFLOWS ) {
+
+            frameOverflows = 0;
+
+            if (pixel_callback_onFrame) {
+                pixel_callback_onFrame();
+            }
+
+        }
+
+    }
+
+}
+
+/** Startup **/
+
+static utils_serialno_t serialno;
+
+SIM_EXPORT void sim_tile_serialno( const uint8_t *bytes ) {
+    memcpy( serialno.bytes , bytes , SERIAL_NUMBER_LEN );
+}
+
+utils_serialno_t const *utils_serialno(void) {
+    return &serialno;
+}
+
+SIM_EXPORT void sim_tile_main(void) {
+
+    sei();
+
+    while (1) {
+        run();
+    }
+
+}
+
+// Where seed.cpp finds "our own flash", so a benchmark can load an image to send
+
+SIM_EXPORT uint8_t *sim_tile_flash(void) {
+    return host_flash;
+}
+
+/** Display **/
+
+static pixelColor_t bufferedColors[PIXEL_COUNT];
+static pixelColor_t shownColors[PIXEL_COUNT];
+static pixelColor_t palette[PIXEL_PALETTE_SIZE];
+
+void pixel_init(void) {}
+void pixel_enable(void) {}
+void pixel_disable(void) {}
+
+void pixel_bufferedSetPixel( uint8_t pixel , pixelColor_t newColor ) {
+    bufferedColors[pixel] = newColor;
+}
+
+void pixel_bufferedSetPixel8( uint8_t pixel , uint8_t r , uint8_t g , uint8_t b ) {
+    pixelColor_t c;
+    c.r = ( ( ( r * 249 ) >> 8 ) + 4 ) >> 3;       // Same nearest level as pixel.cpp
+    c.g = ( ( ( g * 249 ) >> 8 ) + 4 ) >> 3;
+    c.b = ( ( ( b * 249 ) >> 8 ) + 4 ) >> 3;
+    bufferedColors[pixel] = c;
+}
+
+pixelColor_t pixel_getBufferedPixel( uint8_t pixel ) {
+    return bufferedColors[pixel];
+}
+
+void pixel_fadePixel( uint8_t pixel , pixelColor_t , pixelColor_t toColor , uint16_t ) {
+    bufferedColors[pixel] = toColor;
+}
+
+void pixel_setPaletteEntry( uint8_t index , pixelColor_t color ) {
+    palette[index] = color;
+}
+
+pixelColor_t pixel_getPaletteEntry( uint8_t index ) {
+    return palette[index];
+}
+
+void pixel_bufferedSetPixelIndex( uint8_t pixel , uint8_t index ) {
+    bufferedColors[pixel] = palette[index];
+}
+
+void pixel_displayBufferedPixels(void) {
+
+    memcpy( shownColors , bufferedColors , sizeof( shownColors ) );
+
+    sim_host_loop_pass();
+
+}
+
+SIM_EXPORT void sim_tile_color( uint8_t face , uint8_t *rgb ) {
+    rgb[0] = shownColors[face].r;
+    rgb[1] = shownColors[face].g;
+    rgb[2] = shownColors[face].b;
+}
+
+/** IR **/
+
+static uint8_t txBitmask;
+static uint16_t txSpaceUs;
+
+void ir_init(void) {}
+void ir_enable(void) {}
+void ir_disable(void) {}
+
+uint8_t ir_test_and_charge_cli(void) {
+    return sim_host_ir_sample();
+}
+
+// Like the timer1 pulse train, the first pulse goes right away and the next one `initialSpaces` later
+
+void ir_tx_start( uint16_t spacing_ticks , uint8_t bitmask , uint16_t initialSpaces ) {
+
+    txBitmask = bitmask & IR_ALL_BITS;
+    txSpaceUs = spacing_ticks / CYCLES_PER_US;
+
+    sim_host_ir_pulse( txBitmask );
+
+    ir_tx_sendpulse( initialSpaces );
+
+}
+
+void ir_tx_sendpulse( uint8_t leadingSpaces ) {
+
+    sim_host_wait_us( leadingSpaces * txSpaceUs );
+
+    sim_host_ir_pulse( txBitmask );
+
+}
+
+void ir_tx_end(void) {}
+
+/** Button and power **/
+
+void button_init(void) {}
+void button_enable(void) {}
+void button_disable(void) {}
+void button_ISR_on(void) {}
+void button_ISR_off(void) {}
+
+uint8_t button_down(void) {
+    return 0;
+}
+
+void power_init(void) {}
+void power_sleep(void) {}
@@ -0,0 +1,48 @@
+/*
+ * simtile.h
+ *
+ * The seam between a simulated tile and the simulator.
+ *
+ * Each tile is its own copy of a shared library built from the real blinklib and blinkstate sources, a benchmark
+ * sketch, and simcore.cpp, which stands in for the parts of blinkcore that touch hardware. The tile calls the
+ * sim_host_*() functions (in sim.cpp) whenever it needs the outside world, and the simulator calls the sim_tile_*()
+ * functions (in simcore.cpp) to start the tile and to fire its timer interrupt.
+ *
+ * All times the tile passes in are in its own microseconds. The simulator turns them into real time using
+ * that tile's clock rate.
+ *
+ */
+
+#ifndef SIMTILE_H_
+#define SIMTILE_H_
+
+#include <stdint.h>
+
+#define SIM_EXPORT extern "C" __attribute__((visibility("default")))
+
+// Called by the tile
+
+extern "C" {
+
+    // Let `us` of our time go by before returning. Interrupts keep firing in the meantime.
+    void sim_host_wait_us( uint32_t us );
+
+    // One pass through loop() just finished
+    void sim_host_loop_pass(void);
+
+    // Flash the IR LEDs in `bitmask`
+    void sim_host_ir_pulse( uint8_t bitmask );
+
+    // Which IR LEDs saw light since the last time we asked
+    uint8_t sim_host_ir_sample(void);
+
+}
+
+// Called by the simulator. Looked up by name in each copy of the tile library.
+
+typedef void (*sim_tile_main_t)(void);                                  // Runs the tile. Never returns.
+typedef void (*sim_tile_tick_t)(void);                                  // Timer interrupt, every 256us
+typedef void (*sim_tile_serialno_t)( const uint8_t *bytes );            // Sets the 9 byte serial number before main
+typedef void (*sim_tile_color_t)( uint8_t face , uint8_t *rgb );        // Color (0-31 each) showing on a face
+
+#endif /* SIMTILE_H_ */
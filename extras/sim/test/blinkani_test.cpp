@@ -0,0 +1,151 @@
+/*
+ * blinkani_test.cpp
+ *
+ * Checks that a face gets handed back to the whole tile effect when its own effect is done.
+ *
+ * Each case runs on one tile by itself. A face that is done with its own effect should show what the whole tile
+ * effect has there right away, not whenever the whole tile effect next happens to draw that face.
+ *
+ *    blinkani_test <tile library>
+ *
+ * Prints one line per case and exits with 1 if any of them failed.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+// Packed 5:5:5 like a blinklib Color
+
+#define RED     0x7C00
+#define GREEN   0x03E0
+#define BLUE    0x001F
+#define YELLOW  ( RED | GREEN )
+
+static int failures;
+
+static uint16_t colorOnFace( int face ) {
+
+    uint8_t rgb[3];
+
+    sim_call<void>( 0 , "sim_tile_color" , (uint8_t) face , rgb );
+
+    return ( rgb[0] << 10 ) | ( rgb[1] << 5 ) | rgb[2];
+
+}
+
+static void check( const char *name , int face , uint16_t expected ) {
+
+    uint16_t shown = colorOnFace( face );
+
+    bool ok = shown == expected;
+
+    printf( "%s  %-52s face %d is %04x, want %04x\n" , ok ? "pass" : "FAIL" , name , face , shown , expected );
+
+    if ( !ok ) {
+        failures++;
+    }
+
+}
+
+static void startTile( const char *library ) {
+
+    SimConfig config;
+
+    sim_init( library , config );
+    sim_add_tile( 0 , 0 );
+
+    sim_run_ms( 100 );          // Boot and run setup()
+
+}
+
+int main( int argc , char **argv ) {
+
+    if ( argc < 2 ) {
+        fprintf( stderr , "usage: %s <tile library>\n" , argv[0] );
+        return 2;
+    }
+
+    const char *library = argv[1];
+
+    // A short face flash on top of a long whole tile flash. The whole tile flash never draws again, so the
+    // face has to get its color back when its own flash ends.
+
+    startTile( library );
+
+    sim_call<void>( 0 , "test_flash" , (uint16_t) RED , (uint16_t) 5000 );
+    sim_call<void>( 0 , "test_flash_on_face" , (uint16_t) BLUE , (uint16_t) 100 , (uint8_t) 2 );
+
+    sim_run_ms( 50 );
+
+    check( "face flash shows over the whole tile flash" , 2 , BLUE );
+    check( "other faces keep the whole tile flash" , 1 , RED );
+
+    sim_run_ms( 200 );
+
+    check( "whole tile flash takes the face back" , 2 , RED );
+
+    // Stopping the face effect early hands the face back the same way
+
+    startTile( library );
+
+    sim_call<void>( 0 , "test_flash" , (uint16_t) RED , (uint16_t) 5000 );
+    sim_call<void>( 0 , "test_flash_on_face" , (uint16_t) GREEN , (uint16_t) 5000 , (uint8_t) 3 );
+
+    sim_run_ms( 50 );
+
+    sim_call<void>( 0 , "test_stop_effect_on_face" , (uint8_t) 3 );
+
+    sim_run_ms( 50 );
+
+    check( "stopEffectOnFace() gives the face back" , 3 , RED );
+
+    // A whole tile effect that changes while the face is busy. The face gets the newest color, not the old one.
+
+    startTile( library );
+
+    sim_call<void>( 0 , "test_flash" , (uint16_t) RED , (uint16_t) 5000 );
+    sim_call<void>( 0 , "test_flash_on_face" , (uint16_t) BLUE , (uint16_t) 300 , (uint8_t) 4 );
+
+    sim_run_ms( 50 );
+
+    sim_call<void>( 0 , "test_flash" , (uint16_t) GREEN , (uint16_t) 5000 );
+
+    sim_run_ms( 50 );
+
+    check( "face flash is left alone by a new whole tile flash" , 4 , BLUE );
+
+    sim_run_ms( 400 );
+
+    check( "face gets the newest whole tile color" , 4 , GREEN );
+
+    // With no whole tile effect running, the face goes back to what the sketch had there
+
+    startTile( library );
+
+    sim_call<void>( 0 , "test_set_color" , (uint16_t) YELLOW );
+    sim_call<void>( 0 , "test_flash_on_face" , (uint16_t) BLUE , (uint16_t) 100 , (uint8_t) 0 );
+
+    sim_run_ms( 250 );
+
+    check( "face goes back to the color set by the sketch" , 0 , YELLOW );
+
+    // A whole tile fade that finishes while the face is busy
+
+    startTile( library );
+
+    sim_call<void>( 0 , "test_set_color" , (uint16_t) RED );
+    sim_call<void>( 0 , "test_flash_on_face" , (uint16_t) BLUE , (uint16_t) 500 , (uint8_t) 5 );
+    sim_call<void>( 0 , "test_fade_to" , (uint16_t) GREEN , (uint16_t) 200 );
+
+    sim_run_ms( 700 );
+
+    check( "face gets the end of a whole tile fade" , 5 , GREEN );
+
+    printf( "\n%d failed\n" , failures );
+
+    return failures ? 1 : 0;
+
+}
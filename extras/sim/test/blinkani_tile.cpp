@@ -0,0 +1,39 @@
+/*
+ * blinkani_tile.cpp
+ *
+ * Test sketch for blinkani. Does nothing on its own. The test starts effects through these exports and then
+ * watches the faces.
+ *
+ */
+
+#include "blinklib.h"
+#include "blinkani.h"
+
+#include "simtile.h"
+
+SIM_EXPORT void test_set_color( uint16_t c ) {
+    setColor( c );
+}
+
+SIM_EXPORT void test_flash( uint16_t c , uint16_t duration_ms ) {
+    flash( c , duration_ms );
+}
+
+SIM_EXPORT void test_fade_to( uint16_t c , uint16_t duration_ms ) {
+    fadeTo( c , duration_ms );
+}
+
+SIM_EXPORT void test_flash_on_face( uint16_t c , uint16_t duration_ms , uint8_t face ) {
+    flashOnFace( c , duration_ms , face );
+}
+
+SIM_EXPORT void test_stop_effect_on_face( uint8_t face ) {
+    stopEffectOnFace( face );
+}
+
+void setup() {
+    blinkAniBegin();
+}
+
+void loop() {
+}
@@ -39,19 +39,42 @@
 struct Effect_t {
     
     // Every effect has a nextStep() and an isComplete() function
+    // These defaults are never used, but defining them inline lets the compiler emit the vtable without a
+    // separate definition (and without dragging in the pure virtual handler)
 
-    virtual void nextStep();               // Called once per loop to update the display.
+    virtual void nextStep() {}             // Called once per loop to update the display.
                                       
-    virtual bool isComplete();             // Called to check if the current effect is finished running
+    virtual bool isComplete() { return true; }     // Called to check if the current effect is finished running
     
     Effect_t *prevEffect;                  // A pointer back to the previous effect that called this one    
                                            // NULL at top of chain
 };
 
-// Pointer to the linked list of active effects. HEAD is currently running effect. 
+// Each slot runs its own stack of effects. With BLINKANI_FACE_SLOTS, slot n belongs to face n. Next come
+// the BLINKANI_LAYERS layer slots (if any), and the whole tile slot comes last.
+
+#if BLINKANI_FACE_SLOTS
+    #define BLINKANI_FACE_SLOT_COUNT FACE_COUNT
+#else
+    #define BLINKANI_FACE_SLOT_COUNT 0
+#endif
+
+#define BLINKANI_FIRST_LAYER_SLOT BLINKANI_FACE_SLOT_COUNT
+
+#define BLINKANI_SLOT_COUNT (BLINKANI_FACE_SLOT_COUNT+BLINKANI_LAYERS+1)
+
+#define BLINKANI_TILE_SLOT (BLINKANI_SLOT_COUNT-1)
+
+#define IS_LAYER_SLOT(slot) ( (slot) >= BLINKANI_FIRST_LAYER_SLOT && (slot) < BLINKANI_TILE_SLOT )
+
+// Pointer to the linked list of active effects in each slot. HEAD is currently running effect. 
 // NULL= no active effects.
  
-static Effect_t *currentEffect=NULL;
+static Effect_t *slotEffects[BLINKANI_SLOT_COUNT];
+
+// The slot we are starting or stepping effects in right now
+
+static byte activeSlot = BLINKANI_TILE_SLOT;
 
 // Make a new effect the current one
 // the previous running effect is pushed and will resume when this new effect completes.
@@ -61,22 +84,224 @@ static Effect_t *currentEffect=NULL;
 
     // Save currently running effect      
      
-     effect->prevEffect = currentEffect;
+     effect->prevEffect = slotEffects[activeSlot];
      
      // Set the new effect as currently running one
      
-     currentEffect = effect;
+     slotEffects[activeSlot] = effect;
      
  }   
  
- // Terminates any existing running effects. 
+ // Terminates any existing running effects in the slot and makes it the active one.
  // Use this to initially start an effect. 
  
- static void clearEffects() {
+ static void clearEffects( byte slot = BLINKANI_TILE_SLOT ) {
      
-     currentEffect = NULL;
+     activeSlot = slot;
+
+     slotEffects[slot] = NULL;
      
  }     
+
+#if BLINKANI_LAYERS
+
+// Each layer draws into its own colors, which get blended on top of the faces once per frame
+
+struct Layer_t {
+    Color colors[FACE_COUNT];
+    byte  mode;                     // One of the BLEND_* modes
+    byte  alpha;
+};
+
+static Layer_t layers[BLINKANI_LAYERS];
+
+// What the face and whole tile effects drew, before the layers go on top
+
+static Color baseColors[FACE_COUNT];
+
+// Which layers were blended in last frame. While this is 0 the faces are just showing the base, so
+// effects draw right on them and baseColors[] is not kept up.
+
+static byte layersShowing;
+
+static_assert( BLINKANI_LAYERS <= 8 , "blinkani keeps one bit per layer in a byte, so there can only be 8 layers" );
+
+#define ACTIVE_LAYER() ( &layers[ activeSlot - BLINKANI_FIRST_LAYER_SLOT ] )
+
+#endif
+
+#if BLINKANI_FACE_SLOTS
+
+// What the whole tile would be showing on each face that has an effect of its own running. Starts out as whatever
+// was on the face when its effect started, then follows the whole tile effect. Goes back on the face when the
+// face's effect finishes or is stopped.
+
+static Color heldTileColors[FACE_COUNT];
+
+#endif
+
+// Is the whole tile effect drawing on a face that has its own effect running?
+
+static bool isFaceHeld( byte face ) {
+
+    #if BLINKANI_FACE_SLOTS
+
+        return activeSlot == BLINKANI_TILE_SLOT && face < FACE_COUNT && slotEffects[face] != NULL;
+
+    #else
+
+        (void) face;
+
+        return false;
+
+    #endif
+
+}
+
+// What the face and whole tile effects (or the sketch) have on the face, under any layers
+
+static Color baseColorOnFace( byte face ) {
+
+    #if BLINKANI_LAYERS
+
+        if ( layersShowing ) {
+            return baseColors[face];
+        }
+
+    #endif
+
+    return getColorOnFace( face );
+
+}
+
+static void showBaseColorOnFace( Color c , byte face ) {
+
+    #if BLINKANI_LAYERS
+
+        if ( layersShowing ) {
+            baseColors[face] = c;   // The next composite will put it on the face
+            return;
+        }
+
+    #endif
+
+    setColorOnFace( c , face );
+
+}
+
+// Effects show their colors with these rather than setColor(), so that they only touch the faces that belong
+// to their slot. A whole tile effect leaves alone any face that has an effect of its own running.
+
+static bool isFaceInActiveSlot( byte face ) {
+
+    #if BLINKANI_FACE_SLOTS
+
+        if ( activeSlot < BLINKANI_FACE_SLOT_COUNT ) {
+            return face == activeSlot;
+        }
+
+        if ( activeSlot == BLINKANI_TILE_SLOT ) {
+            return slotEffects[face] == NULL;
+        }
+
+    #endif
+
+    (void) face;
+
+    return true;
+
+}
+
+static void showColorOnFace( Color c , byte face ) {
+
+    #if BLINKANI_FACE_SLOTS
+
+        if ( isFaceHeld( face ) ) {
+            heldTileColors[face] = c;   // Shows once the face's own effect is done
+            return;
+        }
+
+    #endif
+
+    if ( !isFaceInActiveSlot( face ) ) {
+        return;
+    }
+
+    #if BLINKANI_LAYERS
+
+        if ( IS_LAYER_SLOT( activeSlot ) ) {
+            ACTIVE_LAYER()->colors[face] = c;
+            return;
+        }
+
+    #endif
+
+    showBaseColorOnFace( c , face );
+
+}
+
+static void showColorRGBOnFace( byte red , byte green , byte blue , byte face ) {
+
+    // Held faces, layers, and the base only keep Colors
+
+    bool colorsOnly = isFaceHeld( face );
+
+    #if BLINKANI_LAYERS
+
+        colorsOnly = colorsOnly || layersShowing || IS_LAYER_SLOT( activeSlot );
+
+    #endif
+
+    if ( colorsOnly ) {
+        showColorOnFace( makeColorRGB( red , green , blue ) , face );
+        return;
+    }
+
+    if ( isFaceInActiveSlot( face ) ) {
+        setColorRGBOnFace( red , green , blue , face );
+    }
+
+}
+
+// What the active slot last drew on the face
+
+static Color slotColorOnFace( byte face ) {
+
+    #if BLINKANI_FACE_SLOTS
+
+        if ( isFaceHeld( face ) ) {
+            return heldTileColors[face];
+        }
+
+    #endif
+
+    #if BLINKANI_LAYERS
+
+        if ( IS_LAYER_SLOT( activeSlot ) ) {
+            return ACTIVE_LAYER()->colors[face];
+        }
+
+    #endif
+
+    return baseColorOnFace( face );
+
+}
+
+static void showColor( Color c ) {
+
+    FOREACH_FACE(f) {
+        showColorOnFace( c , f );
+    }
+
+}
+
+// Effects built out of other effects start the ones that belong to the active slot
+
+struct FlashEffect_t;
+struct BlinkEffect_t;
+
+static FlashEffect_t *slotFlashEffect(void);
+static BlinkEffect_t *slotBlinkEffect(void);
  
  /* 
 
@@ -99,7 +324,7 @@ struct FlashEffect_t : Effect_t {
     
     void start( Color c , uint16_t duration_ms) {        
         uint32_t now = millis();        
-        setColor( c );
+        showColor( c );
         endTime = now + duration_ms;
         addEffect( this ); 
     }
@@ -139,7 +364,7 @@ struct BlinkEffect_t : Effect_t {
         // We pushed a flash for the on state in start(), so we will not get
         // here until that has completed and we are ready for the off state.
                 
-        flashEffect.start( m_offColor , m_offDurration );
+        slotFlashEffect()->start( m_offColor , m_offDurration );
         
         m_completeFlag = true;      // As soon as the 2nd flash that we started is finished, then we are too. 
         
@@ -163,7 +388,7 @@ struct BlinkEffect_t : Effect_t {
         
         // show the on phase now
                 
-        flashEffect.start( onColor , onDurration_ms );
+        slotFlashEffect()->start( onColor , onDurration_ms );
     }
     
 };    
@@ -209,7 +434,7 @@ struct StrobeEffect_t : Effect_t {
 
         
         if (occurancesLeft) {
-                blinkEffect.start( m_onColor , m_onDurration , m_offColor,  m_offDurration  );            
+                slotBlinkEffect()->start( m_onColor , m_onDurration , m_offColor,  m_offDurration  );            
                 occurancesLeft--;                
         }            
                         
@@ -226,7 +451,7 @@ struct StrobeEffect_t : Effect_t {
         // when flash completes.
 
         m_onColor = onColor;
-        m_onDurration = offDurration;
+        m_onDurration = onDurration_ms;
                 
         m_offColor = offColor;
         m_offDurration = offDurration;   
@@ -289,16 +514,16 @@ struct RotateEffect_t : Effect_t {
             
             if (faceStep==FACE_COUNT) {     // We are done, turn off last pixel
                 
-                setFaceColor( 5 , m_offColor );
+                showColorOnFace( m_offColor , 5 );
                 
             } else {                
             
-                setFaceColor( faceStep , m_onColor );
+                showColorOnFace( m_onColor , faceStep );
             
                 // Clear previous pixel
             
                 if (faceStep>0) {
-                    setFaceColor( faceStep-1 , m_offColor );
+                    showColorOnFace( m_offColor , faceStep-1 );
                 }                    
                 
             }
@@ -411,69 +636,851 @@ void spin( uint16_t occurances, Color onColor, Color offColor , uint16_t stepTim
     spinEffect.start( occurances, onColor,  offColor , stepTime_ms );
 }  
 
-bool effectCompleted() {
-    
-    return currentEffect == NULL;
-    
-}    
+/*
 
-void blinkAniOnLoop(void) {
-    
-  // This is the loop that gets called after every loop
-   
-  // Tail any already completed effects...
-  // Requires that at least one effect always be running (currently the idleEffect at the top)
-    
-  while ( currentEffect && currentEffect->isComplete()) {
-      currentEffect = currentEffect->prevEffect;
-  }      
-       
-  if (currentEffect) {
-    (currentEffect->nextStep)();
-  }    
-        
-}
+    Frame Effects - Effects that take one step per display frame rather than waiting for a time.
 
-// Make a record to add to the callback chain
+    These all share the same bookkeeping. They check frameCount() each pass, and when a new frame has
+    started they take however many steps they missed, so a slow loop() makes them skip ahead rather than
+    slow down. Between frames they cost just the check. They run until duration_ms is up, or forever if it is 0.
+
+*/
+
+// Don't take more steps than this at once, so a very long loop() can not make us spin though a big backlog
+
+#define FRAME_EFFECT_MAX_STEPS 255
+
+struct FrameEffect_t : Effect_t {
+
+    uint32_t m_lastFrame;
+    uint32_t m_endTime;             // 0=run until another effect is started
+
+    // How many frames since we last stepped. 0 means we are still in the same frame.
+
+    uint8_t framesElapsed() {
+
+        uint32_t now = frameCount();
+
+        uint32_t frames = now - m_lastFrame;
+
+        m_lastFrame = now;
+
+        return frames > FRAME_EFFECT_MAX_STEPS ? FRAME_EFFECT_MAX_STEPS : frames;
+
+    }
+
+    bool isComplete() {
+        return m_endTime && m_endTime <= millis();
+    }
+
+    void startFrames( uint16_t duration_ms ) {
+
+        m_lastFrame = frameCount();
+
+        m_endTime = duration_ms ? millis() + duration_ms : 0;
+
+        addEffect( this );
+
+    }
 
-static struct chainfunction_struct blinkAniOnLoopChain = {
-     .callback = blinkAniOnLoop,
-     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
 };
 
-// Something tricky here:  I can not find a good place to automatically add
-// our onLoop() hook at compile time, and we
-// don't want to follow idiomatic Arduino ".begin()" pattern, so we
-// hack it by adding here the first time anything that could use state
-// stuff is called. This is an ugly hack. :/
+// Angle of each face around the tile, where 256 is all the way around
 
-// TODO: This is a good place for a GPIO register bit. Then we could inline the test to a single instruction.,
+#define FACE_ANGLE(f) ( (uint8_t) ( ( (f) * 256 ) / FACE_COUNT ) )
+
+// (1-cos(angle))/2 scaled to 0-255, where 256 is all the way around.
+// Two parabolas pieced together. Within about 4% of the real thing with no float or tables.
+
+static uint8_t waveAt( uint8_t angle ) {
+
+    uint8_t half = angle < 128 ? angle : 255 - angle;          // Symmetric around 128
+
+    uint8_t t = half * 2;                                       // 0-254 for the rising half
+
+    if ( t < 128 ) {
+        return ( (uint16_t) t * t ) >> 7;
+    }
+
+    return 255 - ( ( (uint16_t) ( 255 - t ) * ( 255 - t ) ) >> 7 );
 
-static void registerHook(void) {
-    addOnLoop( &blinkAniOnLoopChain );
 }
 
-// Manually add our hooks
+/*
 
-void blinkAniBegin(void) {    
-    clearEffects();       
-    registerHook();
+    Rainbow Breathing Effect - Red, then green, then blue each fade up and back down
+
+*/
+
+#define BREATHE_STEP        5           // Brightness change per frame
+#define BREATHE_RAMP_FRAMES 51          // 51*5=255
+#define BREATHE_HOLD_FRAMES 7           // About 100ms dark between colors
+
+#define BREATHE_COLOR_FRAMES ( ( 2 * BREATHE_RAMP_FRAMES ) + BREATHE_HOLD_FRAMES )
+
+struct RainbowBreathingEffect_t : FrameEffect_t {
+
+    uint16_t m_frame;               // Frames into the current color. Wide enough for a full color plus FRAME_EFFECT_MAX_STEPS
+    uint8_t m_color;                // 0=red, 1=green, 2=blue
+
+    void nextStep() {
+
+        uint8_t frames = framesElapsed();
+
+        if (!frames) {
+            return;
+        }
+
+        m_frame += frames;
+
+        while ( m_frame >= BREATHE_COLOR_FRAMES ) {
+
+            m_frame -= BREATHE_COLOR_FRAMES;
+
+            m_color = m_color == 2 ? 0 : m_color + 1;
+
+        }
+
+        byte b;
+
+        if ( m_frame < BREATHE_RAMP_FRAMES ) {
+            b = m_frame * BREATHE_STEP;
+        } else if ( m_frame < 2 * BREATHE_RAMP_FRAMES ) {
+            b = ( ( 2 * BREATHE_RAMP_FRAMES ) - m_frame ) * BREATHE_STEP;
+        } else {
+            b = 0;
+        }
+
+        FOREACH_FACE(f) {
+            showColorRGBOnFace( m_color==0 ? b : 0 , m_color==1 ? b : 0 , m_color==2 ? b : 0 , f );
+        }
+
+    }
+
+    void start( uint16_t duration_ms ) {
+
+        m_frame = 0;
+        m_color = 0;
+
+        showColor( OFF );
+
+        startFrames( duration_ms );
+
+    }
+
+};
+
+static RainbowBreathingEffect_t rainbowBreathingEffect;
+
+void rainbowBreathing( uint16_t duration_ms ) {
+    clearEffects();
+    rainbowBreathingEffect.start( duration_ms );
 }
 
+/*
 
-// send the color you want to fade to, the duration of the fade
-void fadeTo( Color newColor, uint16_t duration) {
+    Rainbow Fade Effect - All faces slowly step though the hues together
+
+*/
+
+#define RAINBOW_FADE_STEP 79            // Hue change per frame in 1/256ths, about 1 hue every 50ms
+
+struct RainbowFadeEffect_t : FrameEffect_t {
+
+    uint16_t m_hue;                 // 8.8 fixed point
+
+    void nextStep() {
+
+        uint8_t frames = framesElapsed();
+
+        if (!frames) {
+            return;
+        }
+
+        m_hue += frames * RAINBOW_FADE_STEP;
+
+        showColor( makeColorHSBFast( m_hue >> 8 , 255 , 200 ) );
+
+    }
+
+    void start( uint16_t duration_ms ) {
+
+        m_hue = 0;
+
+        showColor( makeColorHSBFast( 0 , 255 , 200 ) );
+
+        startFrames( duration_ms );
+
+    }
+
+};
+
+static RainbowFadeEffect_t rainbowFadeEffect;
 
+void rainbowFade( uint16_t duration_ms ) {
+    clearEffects();
+    rainbowFadeEffect.start( duration_ms );
 }
 
 /*
-Color getFaceColor(byte face) {
-    //
+
+    Spinner Effects - A brightness or hue ramp spread around the faces that turns
+
+*/
+
+#define RED_SPINNER_STEP     20         // Angle change per frame, about 5 turns a second
+#define RAINBOW_SPINNER_STEP 3          // About 1 turn every 1.3 seconds
+
+struct SpinnerEffect_t : FrameEffect_t {
+
+    uint8_t m_angle;
+    uint8_t m_step;
+    bool    m_rainbow;              // Spin hues rather than red brightness
+
+    void show() {
+
+        FOREACH_FACE(f) {
+
+            uint8_t a = m_angle + FACE_ANGLE(f);
+
+            if (m_rainbow) {
+                showColorOnFace( makeColorHSBFast( a , 255 , 180 ) , f );
+            } else {
+                showColorRGBOnFace( a , 0 , 0 , f );
+            }
+
+        }
+
+    }
+
+    void nextStep() {
+
+        uint8_t frames = framesElapsed();
+
+        if (!frames) {
+            return;
+        }
+
+        m_angle += frames * m_step;
+
+        show();
+
+    }
+
+    void start( bool rainbow , uint16_t duration_ms ) {
+
+        m_rainbow = rainbow;
+        m_step = rainbow ? RAINBOW_SPINNER_STEP : RED_SPINNER_STEP;
+        m_angle = 0;
+
+        show();
+
+        startFrames( duration_ms );
+
+    }
+
+};
+
+static SpinnerEffect_t spinnerEffect;
+
+void redSpinner( uint16_t duration_ms ) {
+    clearEffects();
+    spinnerEffect.start( false , duration_ms );
 }
 
-//
-Color getColor() {
-    // if the color is the same on all faces return the color, otherwise return OFF???
-    // TODO: Think this through
+void rainbowSpinner( uint16_t duration_ms ) {
+    clearEffects();
+    spinnerEffect.start( true , duration_ms );
+}
+
+/*
+
+    Blue Wave Effect - A blue wave washes across the tile, and the direction it comes from slowly turns
+
+*/
+
+#define BLUE_WAVE_STEP   4              // Wave angle change per frame, about 1 wave a second
+#define BLUE_WAVE_TURN   100            // Direction change per frame in 1/256ths, about 1 turn every 10 seconds
+#define BLUE_WAVE_RADIAN 41             // 1 radian in 1/256ths of a turn
+
+struct BlueWaveEffect_t : FrameEffect_t {
+
+    uint8_t  m_wave;                // Where the wave is at the center
+    uint16_t m_direction;           // 8.8 fixed point
+
+    void show() {
+
+        FOREACH_FACE(f) {
+
+            // How far along the direction of the wave this face sits, -1 to 1 (so sin() of its angle)...
+
+            int8_t along = ( ( 128 - (int16_t) waveAt( FACE_ANGLE(f) + ( m_direction >> 8 ) - 64 ) ) * BLUE_WAVE_RADIAN ) >> 7;
+
+            // ...which works out to how far ahead of the center its part of the wave is.
+
+            uint8_t b = ( (uint16_t) waveAt( m_wave + along ) * 200 ) >> 8;
+
+            showColorRGBOnFace( 0 , 0 , b , f );
+
+        }
+
+    }
+
+    void nextStep() {
+
+        uint8_t frames = framesElapsed();
+
+        if (!frames) {
+            return;
+        }
+
+        m_wave += frames * BLUE_WAVE_STEP;
+        m_direction += frames * BLUE_WAVE_TURN;
+
+        show();
+
+    }
+
+    void start( uint16_t duration_ms ) {
+
+        m_wave = 0;
+        m_direction = 0;
+
+        show();
+
+        startFrames( duration_ms );
+
+    }
+
+};
+
+static BlueWaveEffect_t blueWaveEffect;
+
+void blueWave( uint16_t duration_ms ) {
+    clearEffects();
+    blueWaveEffect.start( duration_ms );
+}
+
+/*
+
+    Disco Effect - Random faces flash random colors
+
+*/
+
+#define DISCO_MAX_HOLD_FRAMES 5         // Each flash stays up 1-5 frames
+
+struct DiscoEffect_t : FrameEffect_t {
+
+    uint8_t m_face;
+    uint8_t m_framesLeft;
+
+    void nextStep() {
+
+        uint8_t frames = framesElapsed();
+
+        if (!frames) {
+            return;
+        }
+
+        if ( frames < m_framesLeft ) {
+            m_framesLeft -= frames;
+            return;
+        }
+
+        showColorOnFace( OFF , m_face );
+
+        m_face = rand( FACE_COUNT - 1 );
+
+        showColorOnFace( makeColorHSBFast( rand( 255 ) , 255 , 200 ) , m_face );
+
+        m_framesLeft = rand( DISCO_MAX_HOLD_FRAMES - 1 ) + 1;
+
+    }
+
+    void start( uint16_t duration_ms ) {
+
+        m_face = 0;
+        m_framesLeft = 0;               // Start the first flash on the next frame
+
+        showColor( OFF );
+
+        startFrames( duration_ms );
+
+    }
+
+};
+
+static DiscoEffect_t discoEffect;
+
+void disco( uint16_t duration_ms ) {
+    clearEffects();
+    discoEffect.start( duration_ms );
+}
+
+bool effectCompleted() {
+    
+    return slotEffects[BLINKANI_TILE_SLOT] == NULL;
+    
+}    
+
+#if BLINKANI_FACE_SLOTS
+    static void releaseFace( byte face );
+#endif
+
+void blinkAniOnLoop(void) {
+    
+  // This is the loop that gets called after every loop
+
+  // Face slots go first, so a face that finishes its effect gets picked up by the whole tile effect right away
+    
+  for( byte slot=0; slot<BLINKANI_SLOT_COUNT; slot++ ) {
+
+      activeSlot = slot;
+
+      Effect_t *wasRunning = slotEffects[slot];
+
+      // Tail any already completed effects...
+    
+      while ( slotEffects[slot] && slotEffects[slot]->isComplete()) {
+          slotEffects[slot] = slotEffects[slot]->prevEffect;
+      }      
+
+      #if BLINKANI_FACE_SLOTS
+
+          if ( slot < BLINKANI_FACE_SLOT_COUNT && wasRunning && !slotEffects[slot] ) {
+              releaseFace( slot );
+          }
+
+      #else
+
+          (void) wasRunning;
+
+      #endif
+       
+      if (slotEffects[slot]) {
+        (slotEffects[slot]->nextStep)();
+      }    
+
+  }
+        
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct blinkAniOnLoopChain = {
+     .callback = blinkAniOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+// Something tricky here:  I can not find a good place to automatically add
+// our onLoop() hook at compile time, and we
+// don't want to follow idiomatic Arduino ".begin()" pattern, so we
+// hack it by adding here the first time anything that could use state
+// stuff is called. This is an ugly hack. :/
+
+// TODO: This is a good place for a GPIO register bit. Then we could inline the test to a single instruction.,
+
+#if BLINKANI_LAYERS
+
+static void blinkAniOnFrame(void);
+
+static struct chainfunction_struct blinkAniOnFrameChain = {
+     .callback = blinkAniOnFrame,
+     .next     = NULL
+};
+
+#endif
+
+static void registerHook(void) {
+    addOnLoop( &blinkAniOnLoopChain );
+
+    #if BLINKANI_LAYERS
+        addOnFrame( &blinkAniOnFrameChain );
+    #endif
+}
+
+// Manually add our hooks
+
+void blinkAniBegin(void) {    
+
+    for( byte slot=0; slot<BLINKANI_SLOT_COUNT; slot++ ) {
+        clearEffects( slot );       // Leaves the tile slot active since it is last
+    }
+
+    registerHook();
+}
+
+
+/*
+
+    Fade Effect - Fade every face from whatever it is showing now to a new color
+
+    Timed against millis() rather than frames, so it always takes the same time no matter how often we get called.
+    The one divide happens in start(). Each step after that is a multiply and a shift to find how far along we are.
+
+    The whole tile fade remembers where each face started. A face slot fade only has its own face to remember.
+
+*/
+
+template <byte FACES> struct FadeEffect_t : Effect_t {
+
+    Color m_fromColors[FACES];
+    Color m_toColor;
+
+    uint32_t m_startTime;
+    uint16_t m_duration_ms;
+
+    uint32_t m_rate;                // How far to go each ms, in 1/65536ths of the 0-255 blend amount
+
+    bool m_completeFlag;
+
+    void nextStep() {
+
+        uint32_t elapsed = millis() - m_startTime;
+
+        if ( elapsed >= m_duration_ms ) {
+
+            for( byte i=0; i<FACES; i++ ) {
+                showColorOnFace( m_toColor , face( i ) );
+            }
+
+            m_completeFlag = true;
+
+            return;
+
+        }
+
+        // elapsed is less than the duration here, so this stays under 255<<16 and can not overflow
+
+        uint8_t amount = ( elapsed * m_rate ) >> 16;
+
+        for( byte i=0; i<FACES; i++ ) {
+            showColorOnFace( lerpColor( m_fromColors[i] , m_toColor , amount ) , face( i ) );
+        }
+
+    }
+
+    bool isComplete() {
+        return m_completeFlag;
+    }
+
+    // Which face the nth remembered color goes with
+
+    byte face( byte i ) {
+        return FACES == 1 ? activeSlot : i;
+    }
+
+    void start( Color newColor , uint16_t duration_ms ) {
+
+        for( byte i=0; i<FACES; i++ ) {
+            m_fromColors[i] = slotColorOnFace( face( i ) );
+        }
+
+        m_toColor = newColor;
+
+        m_startTime = millis();
+        m_duration_ms = duration_ms;
+
+        if ( duration_ms ) {
+            m_rate = ( ( 255UL << 16 ) + ( duration_ms / 2 ) ) / duration_ms;
+        }
+
+        m_completeFlag = false;
+
+        addEffect( this );
+
+        nextStep();
+
+    }
+
+};
+
+static FadeEffect_t<FACE_COUNT> fadeEffect;
+
+// send the color you want to fade to, the duration of the fade
+void fadeTo( Color newColor, uint16_t duration) {
+    clearEffects();
+    fadeEffect.start( newColor , duration );
+}
+
+Color getFaceColor(byte face) {
+    return getColorOnFace( face );
+}
+
+// The color if every face is showing the same one, otherwise OFF
+
+Color getColor() {
+
+    Color c = getColorOnFace( 0 );
+
+    FOREACH_FACE(f) {
+
+        if ( getColorOnFace( f ) != c ) {
+            return OFF;
+        }
+
+    }
+
+    return c;
+
+}
+
+/*
+
+    Face Slots - Each face can run its own flash, blink, strobe, or fade on top of whatever the whole tile is doing
+
+    Every face needs its own copy of each of these effects, so they only get compiled in with BLINKANI_FACE_SLOTS.
+
+*/
+
+#if BLINKANI_FACE_SLOTS
+
+struct FaceSlotEffects_t {
+    FlashEffect_t    flash;
+    BlinkEffect_t    blink;
+    StrobeEffect_t   strobe;
+    FadeEffect_t<1>  fade;
+};
+
+static FaceSlotEffects_t faceSlotEffects[FACE_COUNT];
+
+static_assert( sizeof( faceSlotEffects ) + ( FACE_COUNT * sizeof( Effect_t * ) ) + sizeof( heldTileColors ) <= BLINKANI_FACE_SLOTS_RAM , "blinkani face slots take more RAM than BLINKANI_FACE_SLOTS_RAM" );
+
+// Start a new effect on the face. If the face was showing the whole tile, remember what was there.
+
+static void claimFace( byte face ) {
+
+    if ( !slotEffects[face] ) {
+        heldTileColors[face] = baseColorOnFace( face );
+    }
+
+    clearEffects( face );
+
+}
+
+// The face's own effect is done, so put back what the whole tile has there
+
+static void releaseFace( byte face ) {
+    showBaseColorOnFace( heldTileColors[face] , face );
+}
+
+void flashOnFace( Color c , uint16_t durration_ms , byte face ) {
+    claimFace( face );
+    faceSlotEffects[face].flash.start( c , durration_ms );
+}
+
+void blinkOnFace( Color onColor, uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte face ) {
+    claimFace( face );
+    faceSlotEffects[face].blink.start( onColor , onDurration_ms , offColor , offDurration );
+}
+
+void strobeOnFace( uint16_t occurances, Color onColor,  uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte face ) {
+    claimFace( face );
+    faceSlotEffects[face].strobe.start( occurances , onColor , onDurration_ms , offColor , offDurration );
+}
+
+void strobeOnFace( uint16_t occurances, Color onColor,  uint16_t period_ms , byte face ) {
+
+    uint16_t durration = period_ms/2;       // 50% duty cycle
+
+    strobeOnFace( occurances , onColor , durration , OFF , durration , face );
+
+}
+
+void fadeToOnFace( Color newColor, uint16_t duration , byte face ) {
+    claimFace( face );
+    faceSlotEffects[face].fade.start( newColor , duration );
+}
+
+void stopEffectOnFace( byte face ) {
+
+    if ( slotEffects[face] ) {
+        clearEffects( face );
+        releaseFace( face );
+    }
+
+}
+
+bool effectCompletedOnFace( byte face ) {
+    return slotEffects[face] == NULL;
+}
+
+#endif
+
+/*
+
+    Layers - Effects that get blended on top of whatever the faces and whole tile are showing
+
+    The effects underneath keep running and drawing into baseColors[], so when a layer finishes (or is stopped)
+    they are right where they would have been. Once per frame, while any layer is running, we start from the
+    base and blend each running layer on in order, then set the faces to the result.
+
+    That is one blend per face per running layer each frame. Nothing happens in the ISR.
+
+*/
+
+#if BLINKANI_LAYERS
+
+struct LayerEffects_t {
+    FlashEffect_t             flash;
+    BlinkEffect_t             blink;
+    StrobeEffect_t            strobe;
+    FadeEffect_t<FACE_COUNT>  fade;
+};
+
+static LayerEffects_t layerEffects[BLINKANI_LAYERS];
+
+static_assert( sizeof( layerEffects ) + sizeof( layers ) + ( BLINKANI_LAYERS * sizeof( Effect_t * ) ) + sizeof( baseColors ) + sizeof( layersShowing ) <= BLINKANI_LAYERS_RAM , "blinkani layers take more RAM than BLINKANI_LAYERS_RAM" );
+
+static Color blendColors( Color under , Color over , byte mode , byte alpha ) {
+
+    switch (mode) {
+
+        case BLEND_ALPHA:
+            return lerpColor( under , over , alpha );
+
+        case BLEND_ADD:
+            return addColors( under , colorDim( over , alpha ) );
+
+        case BLEND_MAX:
+            return maxColors( under , colorDim( over , alpha ) );
+
+    }
+
+    return over;                    // BLEND_REPLACE
+
+}
+
+static void blinkAniOnFrame(void) {
+
+    byte showing = 0;
+
+    for( byte l=0; l<BLINKANI_LAYERS; l++ ) {
+
+        if ( slotEffects[ BLINKANI_FIRST_LAYER_SLOT + l ] ) {
+            showing |= 1<<l;
+        }
+
+    }
+
+    if ( !showing && !layersShowing ) {
+        return;                     // Nothing on top, so the faces already show the base
+    }
+
+    if ( !layersShowing ) {
+
+        // Up to now effects (and the sketch) have been drawing right on the faces, so that is the base
+
+        FOREACH_FACE(f) {
+            baseColors[f] = getColorOnFace( f );
+        }
+
+    }
+
+    layersShowing = showing;
+
+    FOREACH_FACE(f) {
+
+        Color c = baseColors[f];
+
+        for( byte l=0; l<BLINKANI_LAYERS; l++ ) {
+
+            if ( showing & (1<<l) ) {
+                c = blendColors( c , layers[l].colors[f] , layers[l].mode , layers[l].alpha );
+            }
+
+        }
+
+        setColorOnFace( c , f );    // Puts the base back once the last layer is done
+
+    }
+
+}
+
+// Start drawing on the layer. The blend is left alone, so it stays whatever setLayerBlend() last picked
+// (BLEND_REPLACE if it was never called).
+
+static void clearLayer( byte layer ) {
+
+    clearEffects( BLINKANI_FIRST_LAYER_SLOT + layer );
+
+}
+
+void setLayerBlend( byte layer , byte mode , byte alpha ) {
+    layers[layer].mode  = mode;
+    layers[layer].alpha = alpha;
+}
+
+void flashOnLayer( Color c , uint16_t durration_ms , byte layer ) {
+    clearLayer( layer );
+    layerEffects[layer].flash.start( c , durration_ms );
+}
+
+void blinkOnLayer( Color onColor, uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte layer ) {
+    clearLayer( layer );
+    layerEffects[layer].blink.start( onColor , onDurration_ms , offColor , offDurration );
+}
+
+void strobeOnLayer( uint16_t occurances, Color onColor,  uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte layer ) {
+    clearLayer( layer );
+    layerEffects[layer].strobe.start( occurances , onColor , onDurration_ms , offColor , offDurration );
+}
+
+void strobeOnLayer( uint16_t occurances, Color onColor,  uint16_t period_ms , byte layer ) {
+
+    uint16_t durration = period_ms/2;       // 50% duty cycle
+
+    strobeOnLayer( occurances , onColor , durration , OFF , durration , layer );
+
+}
+
+void fadeToOnLayer( Color newColor, uint16_t duration , byte layer ) {
+    clearLayer( layer );
+    layerEffects[layer].fade.start( newColor , duration );
+}
+
+void stopLayer( byte layer ) {
+    clearLayer( layer );
+}
+
+bool effectCompletedOnLayer( byte layer ) {
+    return slotEffects[ BLINKANI_FIRST_LAYER_SLOT + layer ] == NULL;
+}
+
+#endif
+
+static FlashEffect_t *slotFlashEffect(void) {
+
+    #if BLINKANI_FACE_SLOTS
+        if ( activeSlot < BLINKANI_FACE_SLOT_COUNT ) {
+            return &faceSlotEffects[activeSlot].flash;
+        }
+    #endif
+
+    #if BLINKANI_LAYERS
+        if ( IS_LAYER_SLOT( activeSlot ) ) {
+            return &layerEffects[ activeSlot - BLINKANI_FIRST_LAYER_SLOT ].flash;
+        }
+    #endif
+
+    return &flashEffect;
+
+}
+
+static BlinkEffect_t *slotBlinkEffect(void) {
+
+    #if BLINKANI_FACE_SLOTS
+        if ( activeSlot < BLINKANI_FACE_SLOT_COUNT ) {
+            return &faceSlotEffects[activeSlot].blink;
+        }
+    #endif
+
+    #if BLINKANI_LAYERS
+        if ( IS_LAYER_SLOT( activeSlot ) ) {
+            return &layerEffects[ activeSlot - BLINKANI_FIRST_LAYER_SLOT ].blink;
+        }
+    #endif
+
+    return &blinkEffect;
+
 }
-*/
\ No newline at end of file
@@ -29,8 +29,52 @@
     #error You must #include blinklib.h before blinkani.h
 #endif
 
+// With BLINKANI_FACE_SLOTS on, each face can also run its own flash, blink, strobe, or fade (the *OnFace()
+// functions below) while the rest of the tile keeps running its effect. Every face needs its own copy of those
+// effects, which costs about 52 bytes of RAM per face, so this is off by default.
+// The build stops if the face slots ever take more than BLINKANI_FACE_SLOTS_RAM bytes.
+//
+// Set it to 1 in build.extra_flags (like the PIXEL_* options in pixel.h), not with a #define in your sketch. The
+// library gets compiled on its own, so it would never see a #define in the sketch. If the two ever disagree, the
+// link fails with an undefined reference to blinkAniBegin_faceslots<n>_layers<n> rather than the face slots quietly not working.
+
+#ifndef BLINKANI_FACE_SLOTS
+    #define BLINKANI_FACE_SLOTS 0
+#endif
+
+static_assert( BLINKANI_FACE_SLOTS == 0 || BLINKANI_FACE_SLOTS == 1 , "BLINKANI_FACE_SLOTS must be a plain 0 or 1" );
+
+#ifndef BLINKANI_FACE_SLOTS_RAM
+    #define BLINKANI_FACE_SLOTS_RAM 336
+#endif
+
+// BLINKANI_LAYERS is how many layers of effects can be blended on top of the tile (the *OnLayer() functions
+// below), for things like a damage flash over a running rotate(). Each layer costs about 76 bytes of RAM (plus 13
+// bytes shared by all of them), so there are none by default. The build stops if they ever take more than
+// BLINKANI_LAYERS_RAM bytes.
+//
+// Like BLINKANI_FACE_SLOTS, set this in build.extra_flags so the sketch and the library agree. A mismatch fails the
+// link with an undefined reference to blinkAniBegin_faceslots<n>_layers<n>.
+
+#ifndef BLINKANI_LAYERS
+    #define BLINKANI_LAYERS 0
+#endif
+
+static_assert( BLINKANI_LAYERS >= 0 && BLINKANI_LAYERS <= 8 , "BLINKANI_LAYERS must be a plain number from 0 to 8" );
+
+#ifndef BLINKANI_LAYERS_RAM
+    #define BLINKANI_LAYERS_RAM ( 16 + ( BLINKANI_LAYERS * 80 ) )
+#endif
+
 // Call to initialize the blinkani subsystem before starting any effects
 
+// The real name has the build options in it, so a sketch built with different options than the library can not link
+
+#define BLINKANI_CONFIG_PASTE(name,faceslots,layers) name##_faceslots##faceslots##_layers##layers
+#define BLINKANI_CONFIG_NAME(name,faceslots,layers) BLINKANI_CONFIG_PASTE(name,faceslots,layers)
+
+#define blinkAniBegin BLINKANI_CONFIG_NAME( blinkAniBegin , BLINKANI_FACE_SLOTS , BLINKANI_LAYERS )
+
 void blinkAniBegin(void);
 
 
@@ -62,14 +106,103 @@ void rotate( Color onColor, uint16_t stepTime_ms );
 void spin( uint16_t occurances, Color onColor, Color offColor , uint16_t stepTime_ms );
 
 
+// These effects step once per display frame and keep going until duration_ms is up.
+// Give 0 for the duration and they keep going until another effect is started.
+
+// Red, then green, then blue fade up and back down on all faces
+void rainbowBreathing( uint16_t duration_ms );
+
+// All faces slowly step though the rainbow together
+void rainbowFade( uint16_t duration_ms );
+
+// Red brightness ramp spinning around the faces
+void redSpinner( uint16_t duration_ms );
+
+// Rainbow spinning around the faces
+void rainbowSpinner( uint16_t duration_ms );
+
+// Blue waves washing across the tile from a slowly turning direction
+void blueWave( uint16_t duration_ms );
+
+// Random faces flash random colors
+void disco( uint16_t duration_ms );
+
+
 // send the color you want to fade to, the duration of the fade
+// Each face fades from whatever color it is showing when this is called
 void fadeTo( Color newColor, uint16_t duration);
 
+// The color if all faces are showing the same one, otherwise OFF.
+// During a fadeTo() these give the in-between color that is showing now.
 Color getColor();
 
 Color getFaceColor(byte face);
 
+// True when the whole tile effect is done (face slot effects do not count)
 bool effectCompleted();
 
+#if BLINKANI_FACE_SLOTS
+
+// Same as the whole tile versions, but only on one face. A face running one of these is left alone by
+// the whole tile effect until it finishes, then the whole tile effect takes the face back. The face goes right
+// back to the last color the whole tile effect had for it, or to what was on the face before if no whole tile
+// effect has drawn there since.
+
+void flashOnFace( Color c , uint16_t durration_ms , byte face );
+
+void blinkOnFace( Color onColor, uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte face );
+
+void strobeOnFace( uint16_t occurances, Color onColor,  uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte face );
+
+void strobeOnFace( uint16_t occurances, Color onColor,  uint16_t period_ms , byte face );
+
+void fadeToOnFace( Color newColor, uint16_t duration , byte face );
+
+// Stop any effect on the face and give it back to the whole tile effect
+void stopEffectOnFace( byte face );
+
+bool effectCompletedOnFace( byte face );
+
+#endif
+
+#if BLINKANI_LAYERS
+
+// How a layer goes on top of what is under it. alpha (0-255) is how much of the layer shows, except
+// with BLEND_REPLACE where the layer just covers what is under it.
+//
+// Every layer starts out with BLEND_REPLACE. The blend belongs to the layer, not to an effect, so it stays
+// through stopLayer() and every later effect on that layer until you call setLayerBlend() again.
+
+#define BLEND_REPLACE   0           // Layer replaces what is under it (what every layer starts with)
+#define BLEND_ALPHA     1           // Mix of the two, alpha of the way to the layer
+#define BLEND_ADD       2           // Layer dimmed by alpha and added on top
+#define BLEND_MAX       3           // Brighter of the two in each channel, with the layer dimmed by alpha
+
+void setLayerBlend( byte layer , byte mode , byte alpha );
+
+// Same as the whole tile versions, but drawn on a layer (0 to BLINKANI_LAYERS-1). Layers go on top of each
+// other in order, so layer 1 is on top of layer 0.
+//
+// The effects under a layer keep running. Once per frame while any layer is running, the faces get set to the
+// blend of everything, so while a layer is running you can not set colors on the faces directly.
+// When a layer finishes it just disappears.
+
+void flashOnLayer( Color c , uint16_t durration_ms , byte layer );
+
+void blinkOnLayer( Color onColor, uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte layer );
+
+void strobeOnLayer( uint16_t occurances, Color onColor,  uint16_t onDurration_ms, Color offColor , uint16_t offDurration , byte layer );
+
+void strobeOnLayer( uint16_t occurances, Color onColor,  uint16_t period_ms , byte layer );
+
+// Fades each face of the layer from what the layer last showed there
+void fadeToOnLayer( Color newColor, uint16_t duration , byte layer );
+
+void stopLayer( byte layer );
+
+bool effectCompletedOnLayer( byte layer );
+
+#endif
+
 
 #endif /* BLINKANI_H_ */
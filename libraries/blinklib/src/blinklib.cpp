@@ -73,8 +73,21 @@
 // sure that the final result of any loop() interation will always hit the display for at least
 // one frame to eliminate aliasing and tearing.
 
+// We do not keep our own copy of the face colors. The pixel layer remembers the color each pixel was set to so it can
+// skip setting the same one again, and getColorOnFace() and getPaletteColor() read them back from there.
+
+// Which palette entry each face is showing, 4 bits per face (even faces in the low nibble)...
+
+static byte faceIndexes[ (FACE_COUNT+1) / 2 ];
+
+// ...but only for the faces with their bit set here. Setting a face any other way clears its bit.
+
+static byte paletteFaceMask;
+
 void setFaceColor( byte face , Color newColor ) {
 
+    paletteFaceMask &= ~(1<<face);          // Face is no longer showing a palette entry
+
     pixelColor_t newPixelColor;
 
     // TODO: OMG, this is the most inefficient conversion from a unit16 back to (the same) unit16 ever!
@@ -92,6 +105,8 @@ void setFaceColor( byte face , Color newColor ) {
 
 void setColorOnFace( Color newColor , byte face ) {
 
+    paletteFaceMask &= ~(1<<face);          // Face is no longer showing a palette entry
+
     pixelColor_t newPixelColor;
 
     // TODO: OMG, this is the most inefficient conversion from a unit16 back to (the same) unit16 ever!
@@ -107,6 +122,136 @@ void setColorOnFace( Color newColor , byte face ) {
 
 }
 
+void setColorRGBOnFace( byte red, byte green, byte blue , byte face ) {
+
+    paletteFaceMask &= ~(1<<face);          // Face is no longer showing a palette entry
+
+    pixel_bufferedSetPixel8( face , red , green , blue );
+
+}
+
+Color getColorOnFace( byte face ) {
+
+    pixelColor_t pixelColor = pixel_getBufferedPixel( face );
+
+    return MAKECOLOR_5BIT_RGB( pixelColor.r , pixelColor.g , pixelColor.b );
+
+}
+
+void setColorRGB( byte red, byte green, byte blue ) {
+
+    FOREACH_FACE(f) {
+        setColorRGBOnFace( red , green , blue , f );
+    }
+
+}
+
+void fadeColorOnFace( Color newColor , byte face , uint16_t duration_ms ) {
+
+    paletteFaceMask &= ~(1<<face);          // Face is no longer showing a palette entry
+
+    #if PIXEL_FADE
+
+        pixelColor_t fromPixelColor = pixel_getBufferedPixel( face );
+
+        pixelColor_t newPixelColor;
+
+        newPixelColor.r = GET_5BIT_R( newColor );
+        newPixelColor.g = GET_5BIT_G( newColor );
+        newPixelColor.b = GET_5BIT_B( newColor );
+
+        uint16_t steps = ( (uint32_t) duration_ms * (F_CPU/1000) ) / PIXEL_CYCLES_PER_FADE_STEP;
+
+        pixel_fadePixel( face , fromPixelColor , newPixelColor , steps );
+
+    #else
+
+        (void) duration_ms;
+
+        setColorOnFace( newColor , face );      // No fade engine, so just go there
+
+    #endif
+
+}
+
+void fadeColor( Color newColor , uint16_t duration_ms ) {
+
+    FOREACH_FACE(f) {
+        fadeColorOnFace( newColor , f , duration_ms );
+    }
+
+}
+
+void setPaletteColor( byte index , Color newColor ) {
+
+    index &= PALETTE_SIZE-1;
+
+    pixelColor_t newPixelColor;
+
+    newPixelColor.r = GET_5BIT_R( newColor );
+    newPixelColor.g = GET_5BIT_G( newColor );
+    newPixelColor.b = GET_5BIT_B( newColor );
+
+    pixel_setPaletteEntry( index , newPixelColor );
+
+    // Faces showing this entry change along with it
+
+    FOREACH_FACE(f) {
+
+        if ( ( paletteFaceMask & (1<<f) ) && getColorIndexOnFace( f ) == index ) {
+
+            pixel_bufferedSetPixelIndex( f , index );
+
+        }
+
+    }
+
+}
+
+Color getPaletteColor( byte index ) {
+    pixelColor_t pixelColor = pixel_getPaletteEntry( index & (PALETTE_SIZE-1) );
+
+    return MAKECOLOR_5BIT_RGB( pixelColor.r , pixelColor.g , pixelColor.b );
+}
+
+void setColorIndexOnFace( byte index , byte face ) {
+
+    index &= PALETTE_SIZE-1;
+
+    byte *nibbles = &faceIndexes[ face >> 1 ];
+
+    if ( face & 1 ) {
+        *nibbles = ( *nibbles & 0x0f ) | ( index << 4 );
+    } else {
+        *nibbles = ( *nibbles & 0xf0 ) | index;
+    }
+
+    paletteFaceMask |= (1<<face);
+
+    pixel_bufferedSetPixelIndex( face , index );
+
+}
+
+void setColorIndex( byte index ) {
+
+    FOREACH_FACE(f) {
+        setColorIndexOnFace( index , f );
+    }
+
+}
+
+byte getColorIndexOnFace( byte face ) {
+
+    if ( !( paletteFaceMask & (1<<face) ) ) {
+        return PALETTE_NONE;
+    }
+
+    byte nibbles = faceIndexes[ face >> 1 ];
+
+    return ( face & 1 ) ? ( nibbles >> 4 ) : ( nibbles & 0x0f );
+
+}
+
 // Convenience function to set all pixels to the same color.
 
 void setColor( Color newColor ) {
@@ -204,6 +349,20 @@ Color makeColorHSB( uint8_t hue, uint8_t saturation, uint8_t brightness ) {
     return( makeColorRGB( r , g  , b ) );
 }
 
+// Every hue at full saturation and brightness, built at compile time
+
+#define HUE_WHEEL_4(h)   colorHueWheel(h) , colorHueWheel(h+1) , colorHueWheel(h+2) , colorHueWheel(h+3)
+#define HUE_WHEEL_16(h)  HUE_WHEEL_4(h) , HUE_WHEEL_4(h+4) , HUE_WHEEL_4(h+8) , HUE_WHEEL_4(h+12)
+#define HUE_WHEEL_64(h)  HUE_WHEEL_16(h) , HUE_WHEEL_16(h+16) , HUE_WHEEL_16(h+32) , HUE_WHEEL_16(h+48)
+
+static const Color PROGMEM hueWheel[256] = {
+    HUE_WHEEL_64(0) , HUE_WHEEL_64(64) , HUE_WHEEL_64(128) , HUE_WHEEL_64(192)
+};
+
+Color makeColorHSBFast( byte hue, byte saturation, byte brightness ) {
+    return colorHSBFromWheel( pgm_read_word( &hueWheel[hue] ) , saturation , brightness );
+}
+
 // OMG, the Ardiuno rand() function is just a mod! We at least want a uniform distibution.
 
 // Here we implement the SimpleRNG pseudo-random number generator based on this code...
@@ -268,6 +427,22 @@ byte getSerialNumberByte( byte n ) {
 
 }
 
+// Mix the serial number bytes into 16 bits. Rotate and XOR so that every byte affects the result.
+
+uint16_t getTileId(void) {
+
+    uint16_t id = 0;
+
+    for( byte n=0; n<9 ; n++ ) {
+
+        id = ( ( id << 5 ) | ( id >> 11 ) ) ^ utils_serialno()->bytes[n];
+
+    }
+
+    return id;
+
+}
+
 
 /** IR Functions **/
 
@@ -498,14 +673,24 @@ void button_callback_onChange(void) {
 }
 
 
-// TODO: Need this?
+// Full display frames since power up. Ticked by the pixel ISR at the end of each frame.
+// Overflows after about 2 years.
+
+static volatile uint32_t frameCounter=0;
+
+// Note: this runs in callback context in the timer ISR
+
+void pixel_callback_onFrame(void) {
+    frameCounter++;
+}
+
+// Like millis(), sampled once per pass so it does not change while loop() is looking at it
+
+static uint32_t frame_snapshot=0;
 
-volatile uint8_t verticalRetraceFlag=0;     // Turns to 1 when we are about to start a new refresh cycle at pixel zero
-// Once this turns to 1, you have about 2ms to load new values into the raw array
-// to have them displayed in the next frame.
-// Only matters if you want to have consistent frames and avoid visual tearing
-// which might not even matter for this application at 80hz
-// TODO: Is this empirically necessary?
+uint32_t frameCount(void) {
+    return frame_snapshot;
+}
 
 
 // Will overflow after about 62 days...
@@ -653,6 +838,14 @@ void sleep(void) {
 
 }
 
+void postponeSleep(void) {
+
+    DO_ATOMICALLY {
+        buttonSleepTimout = millis() + BUTTON_SLEEP_TIMEOUT_MS;
+    }
+
+}
+
 // Time to sleep? (No button presses recently?)
 
 void checkSleepTimeout(void) {
@@ -680,6 +873,36 @@ void timer_256us_callback_sei(void) {
 
 static chainfunction_struct *onLoopChain = NULL;
 
+static chainfunction_struct *onFrameChain = NULL;
+
+// Call all the frame functions (if any) if a new frame has started since last pass
+
+static void callOnFrameChain(void) {
+
+    uint32_t tempFrame;
+
+    DO_ATOMICALLY {
+        tempFrame=frameCounter;
+    }
+
+    if (tempFrame == frame_snapshot) {
+        return;
+    }
+
+    frame_snapshot = tempFrame;
+
+    chainfunction_struct *c = onFrameChain;
+
+    while (c) {
+
+        c->callback();
+
+        c= c->next;
+
+    }
+
+}
+
 // Call all the functions on the chain (if any)...
 
 static void callOnLoopChain(void ) {
@@ -711,10 +934,12 @@ void __attribute__ ((weak)) run(void) {
 
     while (1) {
 
+        callOnFrameChain();                 // Once per new frame, ahead of loop() so their updates go out with loop()'s
+
         loop();
 
         pixel_displayBufferedPixels();      // show all display updates that happened in last loop()
-                                            // Also currently blocks until new frame actually starts
+                                            // Only blocks until new frame actually starts if PIXEL_TRIPLE_BUFFER is off
 
         callOnLoopChain();
 
@@ -735,3 +960,13 @@ void addOnLoop( chainfunction_struct *chainfunction ) {
     onLoopChain = chainfunction;
 
 }
+
+// Add a function to be called once per pass though loop() when a new frame has started
+// `cons` onto the linked list of functions
+
+void addOnFrame( chainfunction_struct *chainfunction ) {
+
+    chainfunction->next = onFrameChain;
+    onFrameChain = chainfunction;
+
+}
@@ -14,6 +14,8 @@
 
 #include "chainfunction.h"
 
+#include "colormath.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -167,20 +169,32 @@ Color makeColorRGB( byte red, byte green, byte blue );
 #define MAX_BRIGHTNESS (255)
 
 // Dim the specified color. Brightness is 0-255 (0=off, 255=don't dim at all-keep original color)
-// Inlined to allow static simplification at compile time
-
-inline Color dim( Color color, byte brightness) {
-    return MAKECOLOR_5BIT_RGB(
-        (GET_5BIT_R(color)*brightness)/255,
-        (GET_5BIT_G(color)*brightness)/255,
-        (GET_5BIT_B(color)*brightness)/255
-    );
+// constexpr to allow static simplification at compile time. See colormath.h for more color math.
+
+constexpr Color dim( Color color, byte brightness) {
+    return colorDim( color , brightness );
 }
 
+// Also from colormath.h, all constexpr:
+//
+//   lerpColor( from , to , amount )    Blend from `from` (amount=0) to `to` (amount=255)
+//   addColors( a , b )                 Add channels, each tops out at 31
+//   maxColors( a , b )                 Brighter of each channel
+//   rotateHue( color , amount )        Turn the hue by amount/256 of the way around the color wheel
+
 // Make a new color in the HSB colorspace. All values are 0-255.
 
 Color makeColorHSB( byte hue, byte saturation, byte brightness );
 
+// Same as makeColorHSB(), but looks the hue up in a 512 byte table in flash and then only needs a few 8 bit
+// multiplies, so it is much quicker. A channel can come out at most one step (of 31) different from
+// makeColorHSB(). That was checked against every possible input.
+// The table only takes up flash if you use this.
+// If the hue, saturation, and brightness are all constants, use colorHSB() from colormath.h instead and it
+// costs nothing at run time.
+
+Color makeColorHSBFast( byte hue, byte saturation, byte brightness );
+
 // Change the tile to the specified color
 // NOTE: all color changes are double buffered
 // and the display is updated when loop() returns
@@ -195,6 +209,54 @@ void setFaceColor(  byte face, Color newColor );
 
 void setColorOnFace( Color newColor , byte face );
 
+// Set the face (or all faces) to a color with 8 bits (0-255) per channel. This gives finer control of brightness
+// than a Color, which only has 32 levels per channel. Mostly useful for very dim colors and slow changes.
+
+void setColorRGB( byte red, byte green, byte blue );
+
+void setColorRGBOnFace( byte red, byte green, byte blue , byte face );
+
+// The color last set on the face. There is no extra copy kept for this, it is read back from the pixel layer's
+// record of each pixel's color, the same one that lets it skip setting a face to the color it already has.
+// If the face was set with setColorRGBOnFace() or from the palette you get the nearest Color. If it is fading
+// with fadeColorOnFace() you get the color it is fading to.
+
+Color getColorOnFace( byte face );
+
+// Smoothly fade from the current color to newColor over duration_ms.
+// The fade runs in the background at the display frame rate, so it takes no time in loop()
+// and stays smooth even when loop() is slow.
+// Setting a new color on the face while it is fading stops the fade.
+// Fading costs 84 bytes of RAM, so it is only built in when PIXEL_FADE is set to 1 in build.extra_flags.
+// Otherwise these just set the new color right away.
+
+void fadeColor( Color newColor , uint16_t duration_ms );
+
+void fadeColorOnFace( Color newColor , byte face , uint16_t duration_ms );
+
+// Palette mode. Fill in up to 16 colors, then show them on faces by their index (0-15).
+//
+// Showing an entry is quicker than setting a Color since it was converted to raw LED values when you set it.
+// An index fits in 4 bits, so you can keep a whole board of them in half the RAM of Colors, and one fits in a
+// single setValueSentOnFace() value. Use palette.h to send the palette itself to a neighbor.
+//
+// Changing a palette entry also changes any face that is showing it, since setPaletteColor() sets those faces again.
+// Apart from one byte, the palette and the pixel layer's raw copy of it only take up RAM if you use them.
+
+#define PALETTE_SIZE 16
+
+#define PALETTE_NONE 0xff       // getColorIndexOnFace() when the face was last set some other way
+
+void setPaletteColor( byte index , Color newColor );
+
+Color getPaletteColor( byte index );
+
+void setColorIndex( byte index );
+
+void setColorIndexOnFace( byte index , byte face );
+
+byte getColorIndexOnFace( byte face );
+
 /*
 
     Timing functions
@@ -213,6 +275,17 @@ void setColorOnFace( Color newColor , byte face );
 
 unsigned long millis(void);
 
+// Number of full display frames since power up. Frames come about 66 times a second.
+//
+// Like millis(), this is only updated between loop() iterations.
+// Use it to update an animation once per frame rather than every pass though loop():
+//
+//   if ( frameCount() != lastFrame ) { lastFrame = frameCount(); ... }
+//
+// If loop() takes longer than a frame, you will see it jump by more than 1.
+
+uint32_t frameCount(void);
+
 #define NEVER ( (uint32_t)-1 )          // UINT32_MAX would be correct here, but generates a Symbol Not Found.
 
 
@@ -252,6 +325,11 @@ uint16_t rand( uint16_t limit );
 
 byte getSerialNumberByte( byte n );
 
+// A 16 bit id made by mixing up all the serial number bytes.
+// Not guaranteed to be unique, but two tiles in the same cluster having the same id is very unlikely.
+
+uint16_t getTileId(void);
+
 
 /*
 
@@ -310,6 +388,11 @@ uint8_t irGetData( uint8_t face );
 
 uint8_t hasWoken(void);
 
+// Restart the sleep countdown as if the button had just been pressed. For things like passing a seed along that
+// have to keep going for longer than the sleep timeout. Call it again at least every 10 minutes to stay awake.
+
+void postponeSleep(void);
+
 /*
 
     These hook functions are filled in by the sketch
@@ -331,6 +414,12 @@ void loop();
 
 void addOnLoop( chainfunction_struct *chainfunction );
 
+// Add a function to be called just before loop() on any pass where a new frame has
+// started. If loop() is slow and several frames went by, it still only gets called once,
+// so check frameCount() if you need to know how many.
+
+void addOnFrame( chainfunction_struct *chainfunction );
+
 
 /*
 
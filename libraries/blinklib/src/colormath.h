@@ -0,0 +1,229 @@
+/*
+ * colormath.h
+ *
+ * Math on packed 5:5:5 colors (the same layout as a Color in blinklib.h - red in the top bits, blue in the bottom).
+ *
+ * Everything here is constexpr, so an operation on colors that are known at compile time folds down to a
+ * constant and costs nothing at all. The rest compiles down to shifts, masks, and 8 bit multiplies, which the
+ * AVR does in hardware. There are no divides except in rotateHue().
+ *
+ * Where we can, we work on all three channels at once inside the 16 bit color rather than unpacking them.
+ *
+ */
+
+#ifndef COLORMATH_H_
+#define COLORMATH_H_
+
+#include <stdint.h>
+
+// Where each channel lives in a packed color
+
+#define COLORMATH_R_MASK    0x7C00
+#define COLORMATH_G_MASK    0x03E0
+#define COLORMATH_B_MASK    0x001F
+
+#define COLORMATH_RB_MASK   ( COLORMATH_R_MASK | COLORMATH_B_MASK )
+
+// Top bit of each channel
+
+#define COLORMATH_HIGH_BITS 0x4210
+
+constexpr uint8_t colorR( uint16_t color ) { return ( color >> 10 ) & 31; }
+constexpr uint8_t colorG( uint16_t color ) { return ( color >>  5 ) & 31; }
+constexpr uint8_t colorB( uint16_t color ) { return ( color       ) & 31; }
+
+constexpr uint16_t colorPack( uint8_t r , uint8_t g , uint8_t b ) {
+    return ( (uint16_t) ( r & 31 ) << 10 ) | ( (uint16_t) ( g & 31 ) << 5 ) | ( b & 31 );
+}
+
+// x/255 for any x up to 255*255, but with a multiply-free shift and add rather than a divide.
+// Exactly the same answer as the divide.
+
+constexpr uint8_t colorDiv255( uint16_t x ) {
+    return ( x + ( x >> 8 ) + 1 ) >> 8;
+}
+
+// Scale one channel by amount/255
+
+constexpr uint8_t colorScaleChannel( uint8_t c , uint8_t amount ) {
+    return colorDiv255( (uint16_t) c * amount );
+}
+
+// Dim color to brightness/255 of what it was. 255 leaves it alone, 0 is off.
+// Gives exactly the same answer as multiplying by brightness and dividing by 255.
+
+constexpr uint16_t colorDim( uint16_t color , uint8_t brightness ) {
+    return colorPack(
+        colorScaleChannel( colorR( color ) , brightness ),
+        colorScaleChannel( colorG( color ) , brightness ),
+        colorScaleChannel( colorB( color ) , brightness )
+    );
+}
+
+// Blend from `from` to `to`. amount is 0-255, where 0 gives `from` and 255 gives `to`.
+
+constexpr uint8_t colorLerpChannel( uint8_t from , uint8_t to , uint8_t amount ) {
+    return colorDiv255( (uint16_t) from * ( 255 - amount ) + (uint16_t) to * amount );
+}
+
+constexpr uint16_t lerpColor( uint16_t from , uint16_t to , uint8_t amount ) {
+    return colorPack(
+        colorLerpChannel( colorR( from ) , colorR( to ) , amount ),
+        colorLerpChannel( colorG( from ) , colorG( to ) , amount ),
+        colorLerpChannel( colorB( from ) , colorB( to ) , amount )
+    );
+}
+
+// Add two colors, with each channel topping out at 31 rather than spilling into the next one.
+
+// All three channels get added at once. Adding just the bottom 4 bits of each channel can not carry into the
+// next channel, then we put the top bits back in with an XOR and work out which channels carried out of
+// their top bit. Those get filled with all ones.
+
+constexpr uint16_t colorAddCarries( uint16_t a , uint16_t b , uint16_t sum ) {
+    return ( ( a & b ) | ( ( a | b ) & ~sum ) ) & COLORMATH_HIGH_BITS;
+}
+
+constexpr uint16_t colorAddSaturate( uint16_t sum , uint16_t carries ) {
+    return sum | ( ( carries << 1 ) - ( carries >> 4 ) );       // Each carry bit becomes 31 in its own channel
+}
+
+constexpr uint16_t colorAddLow( uint16_t a , uint16_t b ) {
+    return ( ( a & ~COLORMATH_HIGH_BITS ) + ( b & ~COLORMATH_HIGH_BITS ) ) ^ ( ( a ^ b ) & COLORMATH_HIGH_BITS );
+}
+
+constexpr uint16_t addColors( uint16_t a , uint16_t b ) {
+    return colorAddSaturate( colorAddLow( a , b ) , colorAddCarries( a , b , colorAddLow( a , b ) ) );
+}
+
+// The brighter of the two colors in each channel.
+
+// Red and blue have green's 5 bits between them, and green has room above and below, so we can give each
+// channel a guard bit and compare them with a single subtract. The guard bit survives only where a>=b.
+
+constexpr uint16_t colorChannelMask( uint16_t guards ) {
+    return ( guards >> 5 ) * 31;        // Guard bit sits just above its channel, so this fills the channel
+}
+
+constexpr uint16_t colorPickMax( uint16_t a , uint16_t b , uint16_t mask ) {
+    return ( a & mask ) | ( b & ~mask );
+}
+
+constexpr uint16_t colorMaxRB( uint16_t a , uint16_t b ) {
+    return colorPickMax( a , b , colorChannelMask( ( ( a | 0x8020 ) - b ) & 0x8020 ) );
+}
+
+constexpr uint16_t colorMaxG( uint16_t a , uint16_t b ) {
+    return colorPickMax( a , b , colorChannelMask( ( ( a | 0x0400 ) - b ) & 0x0400 ) );
+}
+
+constexpr uint16_t maxColors( uint16_t a , uint16_t b ) {
+    return colorMaxRB( a & COLORMATH_RB_MASK , b & COLORMATH_RB_MASK ) | colorMaxG( a & COLORMATH_G_MASK , b & COLORMATH_G_MASK );
+}
+
+// Turn the hue of a color by amount/256 of the way around the color wheel (so 85 turns red into
+// about green). Brightness and saturation stay the same.
+
+// We walk around the hexagon of colors with the same brightest and dimmest channel. That hexagon is 6 times
+// the difference between them around, which is small enough that the walk is exact with no trig at all.
+
+constexpr uint8_t colorMax3( uint8_t r , uint8_t g , uint8_t b ) {
+    return r > g ? ( r > b ? r : b ) : ( g > b ? g : b );
+}
+
+constexpr uint8_t colorMin3( uint8_t r , uint8_t g , uint8_t b ) {
+    return r < g ? ( r < b ? r : b ) : ( g < b ? g : b );
+}
+
+// How far around the hexagon this color is, from 0 (red) up to 6*(hi-lo)
+
+constexpr uint8_t colorHuePosition( uint8_t r , uint8_t g , uint8_t b , uint8_t hi , uint8_t lo ) {
+    return
+        ( r==hi && b==lo ) ? ( g - lo ) :                           // Red to yellow
+        ( g==hi && b==lo ) ? ( 1 * ( hi - lo ) ) + ( hi - r ) :     // Yellow to green
+        ( g==hi && r==lo ) ? ( 2 * ( hi - lo ) ) + ( b - lo ) :     // Green to cyan
+        ( b==hi && r==lo ) ? ( 3 * ( hi - lo ) ) + ( hi - g ) :     // Cyan to blue
+        ( b==hi && g==lo ) ? ( 4 * ( hi - lo ) ) + ( r - lo ) :     // Blue to magenta
+                             ( 5 * ( hi - lo ) ) + ( hi - b );      // Magenta to red
+}
+
+// Back to a color from a position `along` the way though `side` of the hexagon
+
+constexpr uint16_t colorHueSide( uint8_t side , uint8_t along , uint8_t hi , uint8_t lo ) {
+    return
+        side==0 ? colorPack( hi , lo + along , lo ) :
+        side==1 ? colorPack( hi - along , hi , lo ) :
+        side==2 ? colorPack( lo , hi , lo + along ) :
+        side==3 ? colorPack( lo , hi - along , hi ) :
+        side==4 ? colorPack( lo + along , lo , hi ) :
+                  colorPack( hi , lo , hi - along );
+}
+
+constexpr uint16_t colorHueAt( uint8_t position , uint8_t hi , uint8_t lo ) {
+    return colorHueSide( position / ( hi - lo ) , position % ( hi - lo ) , hi , lo );
+}
+
+constexpr uint8_t colorHueTurn( uint8_t position , uint8_t amount , uint8_t sideLength ) {
+    return ( position + ( ( (uint16_t) amount * 6 * sideLength + 128 ) >> 8 ) ) % ( 6 * sideLength );
+}
+
+constexpr uint16_t colorRotateHue( uint8_t r , uint8_t g , uint8_t b , uint8_t hi , uint8_t lo , uint8_t amount ) {
+    return hi==lo ? colorPack( r , g , b ) :            // Grey has no hue to turn
+        colorHueAt( colorHueTurn( colorHuePosition( r , g , b , hi , lo ) , amount , hi - lo ) , hi , lo );
+}
+
+constexpr uint16_t colorRotateHueRGB( uint8_t r , uint8_t g , uint8_t b , uint8_t amount ) {
+    return colorRotateHue( r , g , b , colorMax3( r , g , b ) , colorMin3( r , g , b ) , amount );
+}
+
+constexpr uint16_t rotateHue( uint16_t color , uint8_t amount ) {
+    return colorRotateHueRGB( colorR( color ) , colorG( color ) , colorB( color ) , amount );
+}
+
+// HSB colors, with hue, saturation, and brightness all 0-255 like makeColorHSB() in blinklib.
+
+// First find the fully saturated, full brightness color for the hue. That is a walk around the same hexagon
+// as above with hi=31 and lo=0, so each of the 6 sides is 256/6 hues long.
+
+constexpr uint8_t colorHueRamp( uint8_t along ) {
+    return colorDiv255( (uint16_t) along * 31 + 127 );          // 0-255 of the way along a side -> 0-31, rounded
+}
+
+constexpr uint16_t colorHueWheel( uint8_t hue ) {
+    return colorHueSide( ( (uint16_t) hue * 6 ) >> 8 , colorHueRamp( ( (uint16_t) hue * 6 ) & 0xff ) , 31 , 0 );
+}
+
+// Then wash it out towards white for saturation, and scale it for brightness. Any brightness above 0 leaves at least
+// 1 in each channel that was lit, like makeColorRGB().
+
+// The wash rounds a bit low to make up for the brightness rounding up. Rounding both to nearest could land two
+// steps away from makeColorHSB(), which works in 8 bits and only drops to 5 at the end.
+
+constexpr uint8_t colorSaturateChannel( uint8_t c , uint8_t saturation ) {
+    return c + colorDiv255( (uint16_t) ( 31 - c ) * ( 255 - saturation ) + 96 );
+}
+
+constexpr uint8_t colorBrightenChannel( uint8_t c , uint8_t brightness ) {
+    return colorDiv255( (uint16_t) c * brightness + 254 );      // Rounds up
+}
+
+constexpr uint8_t colorHSBChannel( uint8_t c , uint8_t saturation , uint8_t brightness ) {
+    return colorBrightenChannel( colorSaturateChannel( c , saturation ) , brightness );
+}
+
+constexpr uint16_t colorHSBFromWheel( uint16_t wheel , uint8_t saturation , uint8_t brightness ) {
+    return colorPack(
+        colorHSBChannel( colorR( wheel ) , saturation , brightness ),
+        colorHSBChannel( colorG( wheel ) , saturation , brightness ),
+        colorHSBChannel( colorB( wheel ) , saturation , brightness )
+    );
+}
+
+// Use this one when the arguments are constants so it all happens at compile time.
+// At run time makeColorHSBFast() in blinklib gets the same answer quicker by looking up the hue in a table.
+
+constexpr uint16_t colorHSB( uint8_t hue , uint8_t saturation , uint8_t brightness ) {
+    return colorHSBFromWheel( colorHueWheel( hue ) , saturation , brightness );
+}
+
+#endif /* COLORMATH_H_ */
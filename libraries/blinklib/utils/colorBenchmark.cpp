@@ -0,0 +1,156 @@
+/*
+    Color Benchmark
+
+    Counts the CPU cycles the color math in colormath.h takes, next to the per channel code a sketch would
+    otherwise write for itself. Runs once at power up and prints the results on the service port.
+
+    Each row is cycles for one call with interrupts off (4 cycles per microsecond at 4Mhz). The "by hand" rows
+    are the plain way to do the same thing one channel at a time, and "old dim" is how dim() used to work.
+
+    The "constant" rows get all their inputs as constants, so they should fold away at compile time and only
+    cost the few cycles it takes to store the answer.
+
+    The color wheel rows are what a sketch like F-ColorWheel does every pass: one HSB color for each face, with
+    the hue spread out around the wheel.
+
+*/
+
+#include "blinklib.h"
+#include "Serial.h"
+
+#include "cyclecount.h"
+
+ServicePortSerial sp;
+
+// Inputs come from here so the compiler can not work them out ahead of time, and answers go into sink so
+// it can not throw them away
+
+static volatile Color firstColor  = MAKECOLOR_5BIT_RGB( 31 , 20 ,  3 );
+static volatile Color secondColor = MAKECOLOR_5BIT_RGB(  6 , 25 , 17 );
+static volatile byte amount = 100;
+static volatile byte saturation = 200;
+
+static volatile Color sink;
+
+static void report( const __FlashStringHelper *label , uint16_t cycles ) {
+
+    sp.print( label );
+    sp.print( F(": ") );
+    sp.println( cycles );
+
+}
+
+#define MEASURE( label , code ) do { cycleCountStart(); code; report( F(label) , cycleCountStop() ); } while (0)
+
+// How dim() used to work
+
+static Color oldDim( Color color , byte brightness ) {
+    return MAKECOLOR_5BIT_RGB(
+        (GET_5BIT_R(color)*brightness)/255,
+        (GET_5BIT_G(color)*brightness)/255,
+        (GET_5BIT_B(color)*brightness)/255
+    );
+}
+
+static byte lerpByHand( byte from , byte to , byte amount ) {
+    return from + ( ( (int) to - from ) * amount ) / 255;
+}
+
+static Color lerpColorByHand( Color from , Color to , byte amount ) {
+    return MAKECOLOR_5BIT_RGB(
+        lerpByHand( GET_5BIT_R(from) , GET_5BIT_R(to) , amount ),
+        lerpByHand( GET_5BIT_G(from) , GET_5BIT_G(to) , amount ),
+        lerpByHand( GET_5BIT_B(from) , GET_5BIT_B(to) , amount )
+    );
+}
+
+static byte addByHand( byte a , byte b ) {
+    byte sum = a + b;
+    return sum > 31 ? 31 : sum;
+}
+
+static Color addColorsByHand( Color a , Color b ) {
+    return MAKECOLOR_5BIT_RGB(
+        addByHand( GET_5BIT_R(a) , GET_5BIT_R(b) ),
+        addByHand( GET_5BIT_G(a) , GET_5BIT_G(b) ),
+        addByHand( GET_5BIT_B(a) , GET_5BIT_B(b) )
+    );
+}
+
+static byte maxByHand( byte a , byte b ) {
+    return a > b ? a : b;
+}
+
+static Color maxColorsByHand( Color a , Color b ) {
+    return MAKECOLOR_5BIT_RGB(
+        maxByHand( GET_5BIT_R(a) , GET_5BIT_R(b) ),
+        maxByHand( GET_5BIT_G(a) , GET_5BIT_G(b) ),
+        maxByHand( GET_5BIT_B(a) , GET_5BIT_B(b) )
+    );
+}
+
+static void benchColorMath() {
+
+    sp.println( F("-- color math") );
+
+    MEASURE( "old dim"              , sink = oldDim( firstColor , amount ) );
+    MEASURE( "dim"                  , sink = dim( firstColor , amount ) );
+    MEASURE( "dim constant"         , sink = dim( RED , 100 ) );
+
+    MEASURE( "lerp by hand"         , sink = lerpColorByHand( firstColor , secondColor , amount ) );
+    MEASURE( "lerpColor"            , sink = lerpColor( firstColor , secondColor , amount ) );
+    MEASURE( "lerpColor constant"   , sink = lerpColor( RED , BLUE , 100 ) );
+
+    MEASURE( "add by hand"          , sink = addColorsByHand( firstColor , secondColor ) );
+    MEASURE( "addColors"            , sink = addColors( firstColor , secondColor ) );
+    MEASURE( "addColors constant"   , sink = addColors( RED , BLUE ) );
+
+    MEASURE( "max by hand"          , sink = maxColorsByHand( firstColor , secondColor ) );
+    MEASURE( "maxColors"            , sink = maxColors( firstColor , secondColor ) );
+    MEASURE( "maxColors constant"   , sink = maxColors( RED , BLUE ) );
+
+    MEASURE( "rotateHue"            , sink = rotateHue( firstColor , amount ) );
+    MEASURE( "rotateHue constant"   , sink = rotateHue( ORANGE , 100 ) );
+
+}
+
+static void benchHSB() {
+
+    sp.println( F("-- HSB") );
+
+    MEASURE( "makeColorHSB"         , sink = makeColorHSB( amount , saturation , amount ) );
+    MEASURE( "makeColorHSBFast"     , sink = makeColorHSBFast( amount , saturation , amount ) );
+    MEASURE( "colorHSB constant"    , sink = colorHSB( 100 , 200 , 100 ) );
+
+    MEASURE( "color wheel makeColorHSB" , {
+        FOREACH_FACE(f) {
+            sink = makeColorHSB( amount + f * 42 , saturation , 255 );
+        }
+    } );
+
+    MEASURE( "color wheel makeColorHSBFast" , {
+        FOREACH_FACE(f) {
+            sink = makeColorHSBFast( amount + f * 42 , saturation , 255 );
+        }
+    } );
+
+}
+
+void setup() {
+
+    sp.begin();
+
+    sp.println( F("Color benchmark (cycles)") );
+
+    cycleCountBegin();
+
+    benchColorMath();
+    benchHSB();
+
+    sp.println( F("done") );
+
+}
+
+void loop() {
+
+}
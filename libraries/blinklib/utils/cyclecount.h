@@ -0,0 +1,68 @@
+/*
+    Cycle counter for the benchmark sketches in this folder
+
+    Counts CPU cycles with Timer1. The IR code only runs Timer1 while it is sending pulses and stops it again
+    before the send returns, so it is free any time we are not inside a send (like in setup(), or in loop()).
+
+    The count runs at clk/1 with interrupts off, so it is exactly the cycles the code in between took with
+    nothing else mixed in. Good for up to 65535 cycles (about 16ms).
+
+        cycleCountBegin();                  // Once, to measure the cost of the counting itself
+
+        cycleCountStart();
+        ...code to time...
+        uint16_t cycles = cycleCountStop();
+
+    The compiler will happily fold or hoist code that does not depend on anything it can not see, so feed the code
+    being timed from volatile variables and store what it makes into one.
+
+*/
+
+#ifndef CYCLECOUNT_H_
+#define CYCLECOUNT_H_
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+static uint8_t cycleCountSreg;
+static uint16_t cycleCountOverhead;
+
+static inline void cycleCountStart(void) {
+
+    cycleCountSreg = SREG;
+    cli();
+
+    TCNT1  = 0;
+    TCCR1B = _BV( CS10 );               // Normal mode, clk/1
+
+    asm volatile ("" ::: "memory");     // Keep the code being timed from moving out in front of us
+
+}
+
+// Cycles since cycleCountStart(), not counting the start and stop themselves
+
+static inline uint16_t cycleCountStop(void) {
+
+    asm volatile ("" ::: "memory");
+
+    uint16_t count = TCNT1;
+
+    TCCR1B = 0;                         // Stopped with the flags clear is how the IR code expects to find Timer1
+    TIFR1  = _BV( TOV1 ) | _BV( ICF1 );
+
+    SREG = cycleCountSreg;
+
+    return count - cycleCountOverhead;
+
+}
+
+static void cycleCountBegin(void) {
+
+    cycleCountOverhead = 0;
+
+    cycleCountStart();
+    cycleCountOverhead = cycleCountStop();
+
+}
+
+#endif /* CYCLECOUNT_H_ */
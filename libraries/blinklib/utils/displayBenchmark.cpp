@@ -0,0 +1,297 @@
+/*
+    Display Benchmark
+
+    Counts the CPU cycles the display calls take, so changes to the pixel code can be checked on a real tile.
+    Runs once at power up and prints the results on the service port. Build it with the same build.extra_flags as
+    the sketch you care about, since the PIXEL_* options change what gets measured.
+
+    Each row is cycles for one call (4 cycles per microsecond at 4Mhz) with interrupts off, so it is just the
+    cost of the call itself. Rows that set a color to the one a face already has are what most loop() passes
+    do, since most sketches set every face every pass whether it changed or not.
+
+    With PIXEL_TRIPLE_BUFFER off, pixel_displayBufferedPixels() waits for the ISR whenever anything changed, so
+    those rows are skipped.
+
+    Build with PIXEL_ISR_STATS=1 to also get the cost of the pixel refresh in the timer overflow ISR. Each row
+    there is the average, shortest and longest refresh over about a quarter second, the jitter (longest minus
+    shortest), and the latest point in the 2048 cycle overflow period that a refresh finished. These run with
+    interrupts on, so they are only good to the 8 cycles of a Timer0 tick. Then come the refresh rate in Hz, the
+    share of the CPU the pixel refresh takes, and the share left over for loop() after all the interrupts
+    (display, IR and timekeeping) get theirs. The last one comes from timing a spin loop with interrupts off
+    and then seeing how many spins fit in the same time with them on.
+
+    The palette rows compare showing a palette entry with setting the same color as a Color. The palette only
+    takes up RAM once a sketch uses it, so to see how much, build once with BENCH_PALETTE set to 0 below and
+    compare the "Global variables use" line the IDE prints after each build.
+
+    To compare display profiles, run it once for each PIXEL_PROFILE. The options each run was built with get
+    printed at the top.
+
+    The dim rows use an 8 bit level that falls between two raw values, so with PIXEL_DITHER=1 they get dithered.
+    Run it once with and once without PIXEL_DITHER to see what dithering costs in the ISR.
+
+*/
+
+#include "blinklib.h"
+#include "pixel.h"
+#include "Serial.h"
+
+#include "cyclecount.h"
+
+#if PIXEL_ISR_STATS
+    #include "timer.h"
+    #include <util/delay.h>
+#endif
+
+// Set to 0 to leave the palette out of the build and see how much RAM it takes
+
+#ifndef BENCH_PALETTE
+    #define BENCH_PALETTE 1
+#endif
+
+ServicePortSerial sp;
+
+// Colors come from here so the compiler can not work them out ahead of time
+
+static volatile Color firstColor  = RED;
+static volatile Color secondColor = BLUE;
+
+static volatile byte firstLevel  = 100;
+static volatile byte secondLevel = 101;
+
+static void report( const __FlashStringHelper *label , uint16_t cycles ) {
+
+    sp.print( label );
+    sp.print( F(": ") );
+    sp.println( cycles );
+
+}
+
+#define MEASURE( label , code ) do { cycleCountStart(); code; report( F(label) , cycleCountStop() ); } while (0)
+
+static void benchPixels() {
+
+    sp.println( F("-- pixels") );
+
+    setColor( firstColor );
+    pixel_displayBufferedPixels();
+
+    MEASURE( "setColorOnFace() same color" , setColorOnFace( firstColor , 0 ) );
+    MEASURE( "setColorOnFace() new color"  , setColorOnFace( secondColor , 0 ) );
+
+    setColorRGBOnFace( firstLevel , firstLevel , firstLevel , 1 );
+
+    MEASURE( "setColorRGBOnFace() same color" , setColorRGBOnFace( firstLevel  , firstLevel  , firstLevel  , 1 ) );
+    MEASURE( "setColorRGBOnFace() new color"  , setColorRGBOnFace( secondLevel , secondLevel , secondLevel , 1 ) );
+
+    setColor( secondColor );
+
+    MEASURE( "setColor() all same"         , setColor( secondColor ) );
+    MEASURE( "setColor() all new"          , setColor( firstColor ) );
+
+    pixel_displayBufferedPixels();
+
+    MEASURE( "display nothing changed"     , pixel_displayBufferedPixels() );
+
+    #if PIXEL_TRIPLE_BUFFER
+
+        setColorOnFace( secondColor , 0 );
+        MEASURE( "display one face changed" , pixel_displayBufferedPixels() );
+
+        setColor( firstColor );
+        MEASURE( "display all faces changed" , pixel_displayBufferedPixels() );
+
+    #endif
+
+}
+
+// What a loop() that sets every face every pass costs, when the color is the same as last pass and when it is new
+
+static void benchTypicalLoop() {
+
+    sp.println( F("-- typical loop") );
+
+    setColor( firstColor );
+    pixel_displayBufferedPixels();
+
+    MEASURE( "loop colors unchanged" , { setColor( firstColor ); pixel_displayBufferedPixels(); } );
+
+    #if PIXEL_TRIPLE_BUFFER
+
+        MEASURE( "loop colors new"   , { setColor( secondColor ); pixel_displayBufferedPixels(); } );
+
+    #endif
+
+}
+
+#if BENCH_PALETTE
+
+static volatile byte firstIndex  = 1;
+static volatile byte secondIndex = 2;
+
+// Same colors as above, so the rows can be compared with the Color ones
+
+static void benchPalette() {
+
+    sp.println( F("-- palette") );
+
+    setPaletteColor( firstIndex  , firstColor  );
+    setPaletteColor( secondIndex , secondColor );
+
+    setColor( OFF );
+    pixel_displayBufferedPixels();
+
+    MEASURE( "setColorIndexOnFace() new index"  , setColorIndexOnFace( firstIndex , 0 ) );
+    MEASURE( "setColorIndexOnFace() same index" , setColorIndexOnFace( firstIndex , 0 ) );
+    MEASURE( "setColorIndex() all new"          , setColorIndex( secondIndex ) );
+
+    MEASURE( "pixel_bufferedSetPixelIndex()"    , pixel_bufferedSetPixelIndex( 0 , firstIndex ) );
+
+    // Every face is showing secondIndex now, and none are showing firstIndex
+
+    MEASURE( "setPaletteColor() no faces"       , setPaletteColor( firstIndex  , secondColor ) );
+    MEASURE( "setPaletteColor() all faces"      , setPaletteColor( secondIndex , firstColor  ) );
+
+    pixel_displayBufferedPixels();
+
+}
+
+#endif
+
+// Prints tenths as a decimal, so 123 comes out as 12.3
+
+static void printTenths( uint32_t tenths ) {
+
+    sp.print( tenths / 10 );
+    sp.print( '.' );
+    sp.print( (byte) ( tenths % 10 ) );
+
+}
+
+static void reportOptions() {
+
+    sp.print( F("profile ") );
+    sp.print( PIXEL_PROFILE );
+    sp.print( F(" ticks/phase ") );
+    sp.print( PIXEL_TICKS_PER_PHASE );
+    sp.print( F(" adaptive ") );
+    sp.print( PIXEL_ADAPTIVE_SCAN );
+    sp.print( F(" interleaved ") );
+    sp.print( PIXEL_SCAN_INTERLEAVED );
+    sp.print( F(" dither ") );
+    sp.print( PIXEL_DITHER );
+    sp.print( F(" triple buffer ") );
+    sp.println( PIXEL_TRIPLE_BUFFER );
+
+}
+
+#if PIXEL_ISR_STATS
+
+#define SPIN_COUNT  1000        // Spins timed with interrupts off. About 5000 cycles, so well inside what cycleCount can hold.
+#define SPIN_BLOCKS 200         // How many times we do that with interrupts on. About a quarter second.
+
+// Kept out of line so the timed run and the real run are the same code
+
+static void __attribute__((noinline)) spin( uint16_t count ) {
+
+    while (count--) {
+        asm volatile ("");
+    }
+
+}
+
+static uint16_t spinCycles;             // What spin( SPIN_COUNT ) takes with interrupts off
+
+static void reportIsr( const __FlashStringHelper *label , byte level , byte litFaces ) {
+
+    setColor( OFF );
+
+    for( byte f=0; f<litFaces; f++ ) {
+        setColorRGBOnFace( level , level , level , f );
+    }
+
+    pixel_displayBufferedPixels();
+
+    pixelIsrStats_t stats;
+
+    _delay_ms( 50 );                    // Let the new frame get picked up...
+    pixel_getIsrStats( &stats );        // ...and then start counting
+
+    for( uint16_t b=0; b<SPIN_BLOCKS; b++ ) {
+        spin( SPIN_COUNT );
+    }
+
+    pixel_getIsrStats( &stats );
+
+    uint32_t elapsedCycles = (uint32_t) stats.calls * TIMER_CYCLES_PER_TICK;
+
+    sp.print( label );
+    sp.print( F(": avg ") );
+    sp.print( ( stats.ticks * TIMER_PRESCALER ) / stats.calls );
+    sp.print( F(" min ") );
+    sp.print( stats.minTicks * TIMER_PRESCALER );
+    sp.print( F(" max ") );
+    sp.print( stats.maxTicks * TIMER_PRESCALER );
+    sp.print( F(" jitter ") );
+    sp.print( ( stats.maxTicks - stats.minTicks ) * TIMER_PRESCALER );
+    sp.print( F(" end ") );
+    sp.print( stats.maxEndTick * TIMER_PRESCALER );
+
+    sp.print( F(" | refresh ") );
+    printTenths( ( stats.frames * 10UL * ( F_CPU / 256 ) ) / ( stats.calls * ( TIMER_CYCLES_PER_TICK / 256UL ) ) );
+    sp.print( F("Hz load ") );
+    printTenths( ( stats.ticks * 1000 ) / ( (uint32_t) stats.calls * TIMER_TOP ) );
+    sp.print( F("% free ") );
+    printTenths( ( (uint32_t) spinCycles * SPIN_BLOCKS ) / ( elapsedCycles / 1000 ) );
+    sp.println( '%' );
+
+}
+
+static void benchIsr() {
+
+    sp.println( F("-- pixel ISR") );
+
+    cycleCountStart();
+    spin( SPIN_COUNT );
+    spinCycles = cycleCountStop();
+
+    reportIsr( F("all faces lit")  , 255        , FACE_COUNT );
+    reportIsr( F("one face lit")   , 255        , 1 );
+    reportIsr( F("all faces dim")  , firstLevel , FACE_COUNT );
+    reportIsr( F("one face dim")   , firstLevel , 1 );
+    reportIsr( F("all faces dark") , 0          , 0 );
+
+}
+
+#endif
+
+void setup() {
+
+    sp.begin();
+
+    sp.println( F("Display benchmark (cycles)") );
+
+    reportOptions();
+
+    cycleCountBegin();
+
+    benchPixels();
+    benchTypicalLoop();
+
+    #if BENCH_PALETTE
+        benchPalette();
+    #endif
+
+    #if PIXEL_ISR_STATS
+        benchIsr();
+    #else
+        sp.println( F("Build with PIXEL_ISR_STATS=1 for the pixel ISR") );
+    #endif
+
+    sp.println( F("done") );
+
+}
+
+void loop() {
+
+}
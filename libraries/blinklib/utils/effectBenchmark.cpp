@@ -0,0 +1,196 @@
+/*
+    Effect Benchmark
+
+    Shows how much of the CPU is left over for loop() while each blinkani effect runs. Steps through the effects
+    on its own at power up and prints the results on the service port.
+
+    Each pass, loop() does a fixed amount of work that was timed with interrupts off at power up. Counting the
+    passes over a few seconds then gives how much of that time loop() got. The rest went to the interrupts,
+    blinklib, and the effect, which does its work between passes once per display frame. The "none" row is
+    with no effect running, so the difference from it is what each effect costs.
+
+    With BLINKANI_LAYERS on, the last rows add one alpha blended layer at a time on top of rotate(). Each of
+    those rows also gives what its newest layer costs in cycles per display frame, from how much it took away
+    from the row above. Layers get blended between passes and not in the ISR, so this is all of their cost.
+
+    Needs blinkani, so build it with the same BLINKANI_* options as the library.
+
+*/
+
+#include "blinklib.h"
+#include "blinkani.h"
+#include "Serial.h"
+#include "pixel.h"
+#include "timer.h"
+
+#include "cyclecount.h"
+
+ServicePortSerial sp;
+
+#define WORK_COUNT  400             // Work done each pass. About 2000 cycles, so about half a millisecond.
+
+#define SETTLE_MS   200             // Time for each effect to get going before we start counting
+#define WINDOW_MS   4000            // How long we count for each effect
+
+// Kept out of line so the timed run and the real runs are the same code
+
+static void __attribute__((noinline)) work( uint16_t count ) {
+
+    while (count--) {
+        asm volatile ("");
+    }
+
+}
+
+static uint16_t workCycles;         // What work( WORK_COUNT ) takes with interrupts off
+
+static byte effect = 0;             // Which effect is running
+static bool counting;               // Past the settle time, so counting passes
+static uint32_t effectStartMs;
+static uint32_t passes;
+static uint32_t lastTenths;         // Free CPU from the row before
+static uint32_t rotateTenths;       // ...and from the rotate row, which comes before the first layer row
+
+#define EFFECT_COUNT 9              // Rows before the layer rows
+#define ROTATE_ROW   1              // The layer rows go on top of this one
+
+#define LAYER_MS     60000          // Long enough for the layers to last through all of the layer rows
+
+// Start effect number `n`, and return its name. Returns NULL past the last one.
+
+static const __FlashStringHelper *startEffect( byte n ) {
+
+    switch (n) {
+        case 0: setColor( OFF );                    return F("none");
+        case 1: rotate( BLUE , 100 );               return F("rotate");
+        case 2: rainbowBreathing( 0 );              return F("rainbowBreathing");
+        case 3: rainbowFade( 0 );                   return F("rainbowFade");
+        case 4: redSpinner( 0 );                    return F("redSpinner");
+        case 5: rainbowSpinner( 0 );                return F("rainbowSpinner");
+        case 6: blueWave( 0 );                      return F("blueWave");
+        case 7: disco( 0 );                         return F("disco");
+        case 8: fadeTo( WHITE , WINDOW_MS * 2 );    return F("fadeTo");
+    }
+
+    #if BLINKANI_LAYERS
+
+        if ( n < EFFECT_COUNT + BLINKANI_LAYERS ) {
+
+            byte layers = n - EFFECT_COUNT;             // Layers already running from the row before
+
+            if (layers == 0) {
+                rotate( BLUE , 100 );
+            }
+
+            setLayerBlend( layers , BLEND_ALPHA , 128 );
+            flashOnLayer( RED , LAYER_MS , layers );
+
+            return F("rotate + layers");
+        }
+
+    #endif
+
+    return NULL;
+
+}
+
+static const __FlashStringHelper *effectName;
+
+static void nextEffect() {
+
+    effectName = startEffect( effect );
+    effectStartMs = millis();
+    counting = false;
+
+}
+
+void setup() {
+
+    sp.begin();
+
+    sp.println( F("Effect benchmark (% of CPU free for loop)") );
+
+    blinkAniBegin();
+
+    cycleCountBegin();
+
+    cycleCountStart();
+    work( WORK_COUNT );
+    workCycles = cycleCountStop();
+
+    nextEffect();
+
+}
+
+void loop() {
+
+    if (!effectName) {
+        return;                     // All done
+    }
+
+    uint32_t now = millis();
+
+    if (!counting) {
+
+        if (now - effectStartMs >= SETTLE_MS) {
+            counting = true;
+            effectStartMs = now;
+            passes = 0;
+        }
+
+        return;
+    }
+
+    uint32_t elapsedMs = now - effectStartMs;
+
+    if (elapsedMs >= WINDOW_MS) {
+
+        // Tenths of a percent. 1000 is all of the CPU.
+
+        uint32_t tenths = ( passes * workCycles ) / ( elapsedMs * CYCLES_PER_MS / 1000 );
+
+        sp.print( effectName );
+
+        if ( effect >= EFFECT_COUNT ) {
+            sp.print( ' ' );
+            sp.print( effect - EFFECT_COUNT + 1 );
+        }
+
+        sp.print( F(": ") );
+        sp.print( tenths / 10 );
+        sp.print( '.' );
+        sp.print( (byte) ( tenths % 10 ) );
+        sp.print( '%' );
+
+        if ( effect == EFFECT_COUNT ) {
+            lastTenths = rotateTenths;
+        }
+
+        if ( effect >= EFFECT_COUNT && lastTenths > tenths ) {
+            sp.print( F(" (") );
+            sp.print( ( ( lastTenths - tenths ) * ( PIXEL_CYCLES_PER_FADE_STEP / 10 ) ) / 100 );     // One display frame is all 6 pixels
+            sp.print( F(" cycles per display frame for this layer)") );
+        }
+
+        sp.println();
+
+        lastTenths = tenths;
+
+        if ( effect == ROTATE_ROW ) {
+            rotateTenths = tenths;
+        }
+
+        effect++;
+        nextEffect();
+
+        if (!effectName) {
+            sp.println( F("done") );
+        }
+
+        return;
+    }
+
+    work( WORK_COUNT );
+    passes++;
+
+}
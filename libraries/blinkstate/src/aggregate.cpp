@@ -0,0 +1,398 @@
+/*
+ * aggregate.cpp
+ *
+ * Convergecast of count, sum, min and max up a tree rooted at the cluster leader.
+ *
+ * We send two kinds of packets on each face...
+ *
+ *    PACKET_TYPE_AGGREGATE , leaderTag , depth | parentFlag , count , sum (2 bytes, LSB first) , min , max
+ *    PACKET_TYPE_AGGREGATE_RESULT , count , sum (2 bytes, LSB first) , min , max
+ *
+ * The first goes to every neighbor. leaderTag is the low byte of the leader id we are following, depth is
+ * how many steps we are below the leader, and parentFlag is set only on the face to the neighbor we picked as
+ * our parent. The totals are for us plus everything below us.
+ *
+ * Every pass through loop() we pick as our parent the neighbor following the same leader with the lowest depth
+ * (sticking with the one we have on a tie). Our children are the neighbors whose latest packet has the parent flag
+ * set. Our totals are our own value plus the totals from our children.
+ *
+ * The leader's totals are the totals for the whole cluster. It sends them to its children in a result packet, and
+ * each tile passes on the result it got from its parent to its own children.
+ *
+ * Anytime our parent or depth changes we tell all the neighbors right away. If just our totals change we only
+ * tell our parent. Either way changes ripple up and back down the tree one packet per step.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "aggregate.h"
+#include "election.h"
+
+#define AGGREGATE_PACKET_LEN 8
+#define RESULT_PACKET_LEN    6
+
+#define AGGREGATE_PARENT_BIT 0x80       // Set in the depth byte on the face to our parent
+
+// How long a face has to be empty before we forget the neighbor that was there
+
+#define AGGREGATE_FORGET_MS  500
+
+#define ALL_FACES_MASK      (0b00111111)        // One bit per face
+
+typedef struct {
+    byte count;
+    uint16_t sum;
+    byte min;
+    byte max;
+} aggregate_t;
+
+// What we know about the neighbor on each face
+
+typedef struct {
+    byte leaderTag;
+    byte depth;                 // Includes the AGGREGATE_PARENT_BIT if they picked us as their parent
+    aggregate_t below;          // Their totals (them and everything below them)
+} aggregateface_t;
+
+static aggregateface_t neighbors[FACE_COUNT];
+
+static byte knownMask;                      // Faces where we have gotten a packet since the neighbor showed up
+static byte presentMask;                    // Faces that have a neighbor (or had one very recently)
+static byte childMask;                      // Faces with a neighbor that picked us as their parent
+static uint16_t lastSeenTime[FACE_COUNT];   // Low bits of millis() when we last saw a neighbor on each face
+
+// Where we are in the tree
+
+static byte ourValue;
+static byte depth = AGGREGATE_MAX_DEPTH;
+static byte parentFace = FACE_COUNT;        // FACE_COUNT=we are the leader, or lost if depth is AGGREGATE_MAX_DEPTH
+static aggregate_t below;                   // Our totals (us and everything below us)
+
+// Totals for the whole cluster
+
+static aggregate_t result;
+
+// What we still need to send
+
+static byte sendReportMask;
+static byte sendResultMask;
+static byte resultTurnMask;                 // Faces where the result goes ahead of the report next time both are waiting
+static uint32_t nextSendTime;
+
+// Add the totals in `from` into `into`, saturating rather than wrapping
+
+static void addTotals( aggregate_t *into , const aggregate_t *from ) {
+
+    uint16_t count = into->count + from->count;
+    into->count = count > 255 ? 255 : count;
+
+    uint16_t sum = into->sum + from->sum;
+    into->sum = sum < into->sum ? 0xffff : sum;
+
+    if ( from->min < into->min ) {
+        into->min = from->min;
+    }
+
+    if ( from->max > into->max ) {
+        into->max = from->max;
+    }
+
+}
+
+static bool isSameTotals( const aggregate_t *a , const aggregate_t *b ) {
+
+    return a->count == b->count && a->sum == b->sum && a->min == b->min && a->max == b->max;
+
+}
+
+static void unpackTotals( aggregate_t *into , const byte *data ) {
+
+    into->count = data[0];
+    into->sum   = data[1] | ( data[2] << 8 );
+    into->min   = data[3];
+    into->max   = data[4];
+
+}
+
+static void packTotals( byte *data , const aggregate_t *from ) {
+
+    data[0] = from->count;
+    data[1] = (byte) from->sum;
+    data[2] = (byte) ( from->sum >> 8 );
+    data[3] = from->min;
+    data[4] = from->max;
+
+}
+
+// Called for every packet received by blinkstate
+
+static void aggregateOnPacket( byte face , const byte *data , byte len ) {
+
+    if ( data[0]==PACKET_TYPE_AGGREGATE && len==AGGREGATE_PACKET_LEN ) {
+
+        aggregateface_t *n = &neighbors[face];
+
+        n->leaderTag = data[1];
+        n->depth     = data[2];
+        unpackTotals( &n->below , data + 3 );
+
+        knownMask |= 1<<face;
+
+    } else if ( data[0]==PACKET_TYPE_AGGREGATE_RESULT && len==RESULT_PACKET_LEN ) {
+
+        if ( face == parentFace ) {             // Only believe our parent, anyone else may be on an old tree
+
+            aggregate_t r;
+
+            unpackTotals( &r , data + 1 );
+
+            if ( !isSameTotals( &r , &result ) ) {
+                result = r;
+                sendResultMask = childMask;     // Pass it down
+            }
+
+        }
+
+    }
+
+}
+
+// Pick our parent, find our children, and add up our totals.
+// Queues up packets to any neighbors that need to hear about changes.
+
+static void updateTree(void) {
+
+    byte leaderTag = getLeaderId();
+    byte bestDepth = AGGREGATE_MAX_DEPTH;
+    byte bestFace  = FACE_COUNT;
+
+    if ( isLeader() ) {
+
+        bestDepth = 0;
+
+    } else {
+
+        FOREACH_FACE(f) {
+
+            if ( knownMask & (1<<f) ) {
+
+                aggregateface_t *n = &neighbors[f];
+
+                byte d = ( n->depth & ~AGGREGATE_PARENT_BIT ) + 1;
+
+                // Fewest steps wins. On a tie we stick with our current parent so we don't flip back and forth.
+
+                if ( n->leaderTag == leaderTag && ( d < bestDepth || ( d == bestDepth && f == parentFace ) ) ) {
+
+                    bestDepth = d;
+                    bestFace  = f;
+
+                }
+
+            }
+
+        }
+
+    }
+
+    aggregate_t totals = { 1 , ourValue , ourValue , ourValue };
+
+    byte newChildMask = 0;
+
+    if ( bestDepth < AGGREGATE_MAX_DEPTH ) {
+
+        FOREACH_FACE(f) {
+
+            aggregateface_t *n = &neighbors[f];
+
+            if ( (knownMask & (1<<f)) && f != bestFace && n->leaderTag == leaderTag && (n->depth & AGGREGATE_PARENT_BIT) ) {
+
+                addTotals( &totals , &n->below );
+                newChildMask |= 1<<f;
+
+            }
+
+        }
+
+    }
+
+    sendResultMask |= newChildMask & ~childMask;        // New children need the result
+
+    // Everyone needs to know where we are in the tree, but only our parent cares about our totals
+
+    if ( bestDepth != depth || bestFace != parentFace ) {
+        sendReportMask = ALL_FACES_MASK;
+    } else if ( !isSameTotals( &totals , &below ) && bestFace != FACE_COUNT ) {
+        sendReportMask |= 1<<bestFace;
+    }
+
+    depth      = bestDepth;
+    parentFace = bestFace;
+    childMask  = newChildMask;
+    below      = totals;
+
+    // The leader's totals are the result. If we are lost we just hang on to the last result until we find our way.
+
+    if ( depth == 0 && !isSameTotals( &below , &result ) ) {
+        result = below;
+        sendResultMask = childMask;
+    }
+
+}
+
+static void aggregateOnLoop(void) {
+
+    uint32_t now = millis();
+
+    // Forget anyone who left.
+    // A lost symbol can make a face look empty for a moment, so we wait a bit before forgetting a neighbor.
+
+    FOREACH_FACE(f) {
+
+        byte bit = 1<<f;
+
+        if ( !isValueReceivedOnFaceExpired(f) ) {
+
+            lastSeenTime[f] = now;
+
+            if ( !(presentMask & bit) ) {
+
+                presentMask    |= bit;
+                sendReportMask |= bit;
+
+            }
+
+        } else if ( (uint16_t) ( now - lastSeenTime[f] ) > AGGREGATE_FORGET_MS ) {
+
+            presentMask &= ~bit;
+            knownMask   &= ~bit;
+
+        }
+
+    }
+
+    updateTree();
+
+    if ( (int32_t) ( now - nextSendTime ) >= 0 ) {
+        sendReportMask = ALL_FACES_MASK;
+        sendResultMask = childMask;
+        nextSendTime   = now + AGGREGATE_PERIOD_MS;
+    }
+
+    sendReportMask &= presentMask;
+    sendResultMask &= childMask;
+
+    // Only one packet can be in flight per face, so when both are waiting the report and the result take turns.
+    // If the report always went first, a busy face that gets a new report every period would never get the result out.
+
+    FOREACH_FACE(f) {
+
+        byte bit = 1<<f;
+
+        bool resultFirst = ( sendResultMask & bit ) && ( !( sendReportMask & bit ) || ( resultTurnMask & bit ) );
+
+        if ( resultFirst ) {
+
+            byte packet[RESULT_PACKET_LEN] = { PACKET_TYPE_AGGREGATE_RESULT };
+
+            packTotals( packet + 1 , &result );
+
+            if ( sendPacketOnFace( f , packet , RESULT_PACKET_LEN ) ) {
+                sendResultMask &= ~bit;
+                resultTurnMask &= ~bit;
+            }
+
+        } else if ( sendReportMask & bit ) {
+
+            byte packet[AGGREGATE_PACKET_LEN] = { PACKET_TYPE_AGGREGATE , (byte) getLeaderId() , depth };
+
+            if ( f == parentFace ) {
+                packet[2] |= AGGREGATE_PARENT_BIT;
+            }
+
+            packTotals( packet + 3 , &below );
+
+            if ( sendPacketOnFace( f , packet , AGGREGATE_PACKET_LEN ) ) {
+                sendReportMask &= ~bit;
+                resultTurnMask |= bit;
+            }
+
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct aggregateOnLoopChain = {
+     .callback = aggregateOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static packethandler_t aggregateOnPacketChain = {
+     .callback = aggregateOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any aggregate function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        result.count = 1;                   // Just us for now. Our value starts at 0, so the rest of result is right already.
+        addOnLoop( &aggregateOnLoopChain );
+        addOnPacket( &aggregateOnPacketChain );
+        hookRegisteredFlag=1;
+        getLeaderId();                      // Gets the election going. Do this after we hook in so it runs first and its heartbeats get first dibs on the faces.
+    }
+}
+
+void setAggregateValue( byte value ) {
+
+    registerHook();
+
+    ourValue = value;
+
+}
+
+byte getAggregateCount(void) {
+
+    registerHook();
+
+    return result.count;
+
+}
+
+uint16_t getAggregateSum(void) {
+
+    registerHook();
+
+    return result.sum;
+
+}
+
+byte getAggregateMin(void) {
+
+    registerHook();
+
+    return result.min;
+
+}
+
+byte getAggregateMax(void) {
+
+    registerHook();
+
+    return result.max;
+
+}
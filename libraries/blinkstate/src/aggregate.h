@@ -0,0 +1,58 @@
+/*
+ * aggregate.h
+ *
+ * Cluster-wide count, sum, min and max.
+ *
+ * Each tile sets a value (say its team's score, or its health) with setAggregateValue(), and every tile in the
+ * cluster can read back how many tiles there are and the sum, min and max of all their values.
+ *
+ * The tiles build a tree with the cluster leader (see election.h) at the top. Each tile adds up its own value
+ * and the totals from the tiles below it and passes that up the tree, so the leader ends up with the totals for
+ * the whole cluster. The leader then passes the totals back down to everyone.
+ *
+ * RAM use is fixed at about 10 bytes per face no matter how big the cluster gets.
+ *
+ * Results take a couple of packets per step from the leader to settle after anything changes, and until then
+ * may be a bit off. Before we hear anything from the cluster, the results are just our own value.
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so updates
+ * only happen when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ */
+
+#ifndef AGGREGATE_H_
+#define AGGREGATE_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before aggregate.h
+#endif
+
+// How often we repeat our totals to the neighbors. We also send right away whenever anything
+// changes, so this only matters for catching lost packets.
+
+#define AGGREGATE_PERIOD_MS     2000
+
+// Tiles more than this many steps below the leader are left out of the totals.
+// This stops a loop of tiles that lost their way to the leader from counting each other forever.
+
+#define AGGREGATE_MAX_DEPTH     64
+
+// Set the value this tile adds to the cluster totals. Starts at 0.
+
+void setAggregateValue( byte value );
+
+// Number of tiles in the cluster (including us). Saturates at 255.
+
+byte getAggregateCount(void);
+
+// Sum of the values of all tiles in the cluster. Saturates at 65535.
+
+uint16_t getAggregateSum(void);
+
+// Smallest and largest value of any tile in the cluster
+
+byte getAggregateMin(void);
+byte getAggregateMax(void);
+
+#endif /* AGGREGATE_H_ */
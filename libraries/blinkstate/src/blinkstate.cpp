@@ -23,6 +23,7 @@
 #define DEBUG_MODE
 
 #include <stddef.h>
+#include <string.h>         // memset() memcpy()
 
 #include "blinklib.h"
 
@@ -66,6 +67,547 @@ static uint32_t neighboorSendTime[FACE_COUNT];      // inits to 0 on startup, so
 static const uint16_t sendprobeDurration_ms = 200;
 
 
+// ----  Packets
+
+// Packets ride on the same symbol stream as the state values. We steal the value 63 to escape into a packet.
+// A packet on the wire looks like...
+//
+//   ESCAPE, header , data symbols... , check low , check high
+//
+// ...where the data bytes are packed 6 bits at a time into ceil(len*8/6) symbols, and the check is 12 bits
+// so that only about 1 in 4096 garbled packets slips through.
+//
+// The header is len + ( wait * PACKET_MAX_LEN ), where wait is how long the packet sat in our buffer before the
+// escape went out in units of PACKET_WAIT_UNIT_MS. This lets the receiver work out how old the packet is.
+// A state value of 63 is sent as ESCAPE,ESCAPE so it is still available to games. So is a 63 inside a packet, so
+// an escape followed by anything else always means a new packet is starting.
+// Since we only send when the neighbor answers (or the probe times out), we get flow control for free
+// and never overrun the one deep IR receive buffer.
+//
+// When a good packet comes in we send back ESCAPE,0 as an ack. A header is never 0, so this can't be confused
+// with the start of a packet, and it can even go out in the middle of one of our own packets. If the sender does not
+// see the ack within a few symbols it sends the whole packet again, up to PACKET_RETRY_COUNT times. If it is the ack
+// that got lost then the receiver will see the same packet twice.
+//
+// The packet buffers take up a lot of RAM, so the packet layer only starts up the first time something calls
+// addOnPacket() or sendPacketOnFace(). If nothing ever does, the linker drops it altogether. Until then a much smaller
+// version of the symbol handling keeps sending 63 as ESCAPE,ESCAPE and steps over any packets our neighbors send us
+// (without acking them), so we still talk the same way on the wire.
+
+#define PACKET_ESCAPE 63
+
+#define PACKET_SYMBOL_COUNT(len) ( ( ((len) * 8) + 5 ) / 6 )
+
+#define PACKET_WAIT_UNIT_MS 8
+#define PACKET_WAIT_MAX     6           // Waited too long to say. Also keeps the header below the escape value.
+
+#define PACKET_ACK          0           // Sent after an escape to say we got a packet
+
+// How many symbols we send after the last symbol of a packet before giving up on the ack.
+// The ack is normally the next two symbols that come back, but the escape can be held up a
+// symbol if the neighbor was in the middle of sending an escape of its own.
+
+#define PACKET_ACK_WAIT     4
+
+#define PACKET_RETRY_COUNT  3           // How many times we resend a packet that did not get acked
+
+#if PACKET_MAX_LEN != 8
+    #error The packet header encoding assumes PACKET_MAX_LEN is 8
+#endif
+
+#define RX_IDLE     0           // Next symbol is a state value (or an escape)
+#define RX_ESCAPED  1           // Last symbol was an escape
+#define RX_DATA     2           // Collecting symbols of a packet
+#define RX_DATA_ESCAPED 3       // Got an escape in the middle of a packet
+
+typedef struct {
+
+    byte txLen;                             // Length of packet being sent. 0=none.
+    byte txIndex;                           // Next symbol to send (0=escape, 1=len, then data, then check)
+    uint16_t txCheck;                       // Running check of the symbols sent so far
+    byte txLiteralFlag;                     // Sent an escape for a state value of 63, so need to send a second 63 next
+    byte txWait;                            // How long the packet waited before the escape went out, in PACKET_WAIT_UNIT_MS
+    byte txAckWait;                         // Symbols left to wait for the ack after the packet went out. 0=not waiting.
+    byte txRetries;                         // How many more times we will resend the packet if it does not get acked
+    byte txAckState;                        // Ack we owe the neighbor. 0=none, 1=send the escape next, 2=send the PACKET_ACK next.
+    uint16_t txQueueTime;                   // Low bits of millis() when the packet was queued
+    byte txBuffer[PACKET_MAX_LEN+1];        // Extra trailing 0 byte lets us pull the last symbol without a bounds check
+
+    byte rxState;
+    byte rxLen;
+    byte rxIndex;                           // Next data symbol we expect
+    uint16_t rxCheck;
+    uint16_t rxStartTime;                   // Low bits of millis() when we think the escape that started this packet was sent
+    byte rxWait;                            // How long the packet waited on the other side, in PACKET_WAIT_UNIT_MS
+    byte rxBuffer[PACKET_MAX_LEN+1];        // Extra trailing byte lets us drop in the last symbol without a bounds check
+
+} facepacket_t;
+
+static facepacket_t facePackets[FACE_COUNT];
+
+// All we need to keep track of before the packet layer starts
+
+typedef struct {
+
+    byte rxState;
+    byte rxSkip;                            // Symbols left in the packet we are stepping over
+    byte txLiteralFlag;                     // Sent an escape for a state value of 63, so need to send a second 63 next
+
+} faceescape_t;
+
+static faceescape_t faceEscapes[FACE_COUNT];
+
+static packethandler_t *onPacketChain = NULL;
+
+static uint16_t dispatchAge_ms;                 // Age of the packet currently being handed to the handlers
+
+// Cheap check that catches dropped and flipped symbols. Rotate left within 12 bits, then mix in the new symbol.
+
+static uint16_t packetCheckStep( uint16_t check , byte symbol ) {
+
+    return ( ( (check << 1) | (check >> 11) ) ^ symbol ) & 0x0fff;
+
+}
+
+// Pull the nth 6-bit symbol out of a packed buffer
+
+static byte packetGetSymbol( const byte *buffer , byte n ) {
+
+    uint16_t bitOffset = n * 6;
+
+    const byte *p = buffer + (bitOffset >> 3);
+
+    uint16_t w = p[0] | ( p[1] << 8 );
+
+    return ( w >> (bitOffset & 7) ) & 0b00111111;
+
+}
+
+// Drop the nth 6-bit symbol into a packed buffer. Buffer must start zeroed.
+
+static void packetPutSymbol( byte *buffer , byte n , byte symbol ) {
+
+    uint16_t bitOffset = n * 6;
+
+    byte *p = buffer + (bitOffset >> 3);
+
+    uint16_t w = symbol << (bitOffset & 7);
+
+    p[0] |= w;
+    p[1] |= w >> 8;
+
+}
+
+static void dispatchPacket( byte face , const byte *data , byte len ) {
+
+    packethandler_t *h = onPacketChain;
+
+    while (h) {
+
+        h->callback( face , data , len );
+
+        h = h->next;
+
+    }
+
+}
+
+// Is this symbol (after an escape) a good packet header?
+
+static bool isPacketHeader( byte symbol ) {
+
+    return symbol >= 1 && symbol <= PACKET_MAX_LEN * (PACKET_WAIT_MAX+1);
+
+}
+
+// How many symbols follow the header, counting both halves of the check
+
+static byte packetTailLen( byte header ) {
+
+    return PACKET_SYMBOL_COUNT( ( ( header - 1 ) % PACKET_MAX_LEN ) + 1 ) + 2;
+
+}
+
+// Start collecting a packet with the header symbol that came after the escape.
+// Returns false if the header is garbled.
+
+static bool receiveHeader( facepacket_t *fp , byte symbol ) {
+
+    if ( !isPacketHeader( symbol ) ) {
+        return false;
+    }
+
+    byte wait = ( symbol - 1 ) / PACKET_MAX_LEN;
+    if ( fp->rxWait < wait ) {
+        fp->rxWait = wait;
+    }
+    fp->rxLen   = ( ( symbol - 1 ) % PACKET_MAX_LEN ) + 1;
+    fp->rxIndex = 0;
+    fp->rxCheck = symbol;
+    memset( fp->rxBuffer , 0 , sizeof( fp->rxBuffer ) );
+
+    return true;
+
+}
+
+// Add a data or check symbol to the packet we are collecting
+
+static void receivePacketSymbol( byte face , facepacket_t *fp , byte symbol , uint32_t now ) {
+
+    if ( fp->rxIndex < PACKET_SYMBOL_COUNT( fp->rxLen ) ) {
+
+        packetPutSymbol( fp->rxBuffer , fp->rxIndex , symbol );
+        fp->rxCheck = packetCheckStep( fp->rxCheck , symbol );
+        fp->rxIndex++;
+
+    } else if ( fp->rxIndex == PACKET_SYMBOL_COUNT( fp->rxLen ) ) {    // Low half of the check
+
+        if ( symbol != ( fp->rxCheck & 0b00111111 ) ) {
+            fp->rxCheck = 0xffff;                               // Can't match any high half, but we still need to eat it
+        }
+
+        fp->rxIndex++;
+
+    } else {                                                    // High half of the check
+
+        if ( symbol == ( fp->rxCheck >> 6 ) ) {
+            if ( fp->rxWait < PACKET_WAIT_MAX ) {
+                dispatchAge_ms = (uint16_t) now - fp->rxStartTime + ( fp->rxWait * PACKET_WAIT_UNIT_MS );
+            } else {
+                dispatchAge_ms = PACKET_AGE_UNKNOWN;
+            }
+
+            fp->txAckState = 1;
+
+            dispatchPacket( face , fp->rxBuffer , fp->rxLen );
+        }
+
+        fp->rxState = RX_IDLE;
+
+    }
+
+}
+
+// The neighbor got the packet we sent
+
+static void receiveAck( facepacket_t *fp ) {
+
+    if ( fp->txAckWait ) {
+        fp->txAckWait = 0;
+        fp->txLen     = 0;
+    }
+
+}
+
+// Process a newly received symbol on this face. It is either a state value or part of a packet.
+
+static void receiveSymbol( byte face , byte symbol , uint32_t now ) {
+
+    facepacket_t *fp = &facePackets[face];
+
+    switch (fp->rxState) {
+
+        case RX_IDLE:
+
+            if (symbol==PACKET_ESCAPE) {
+
+                // The neighbor sent this sometime between when our last symbol got to them and now, so split the difference.
+                // If that was a long time, then something got lost along the way and we can't tell when this was sent.
+
+                uint16_t sinceSend = 0;
+
+                if (neighboorSendTime[face]) {
+                    sinceSend = now - ( neighboorSendTime[face] - sendprobeDurration_ms );
+                }
+
+                fp->rxStartTime = now - ( sinceSend / 2 );
+                fp->rxWait = ( sinceSend < PACKET_WAIT_UNIT_MS * PACKET_WAIT_MAX ) ? 0 : PACKET_WAIT_MAX;
+
+                fp->rxState = RX_ESCAPED;
+            } else {
+                inValue[face] = symbol;
+            }
+            break;
+
+        case RX_ESCAPED:
+
+            if (symbol==PACKET_ESCAPE) {                                // Escaped escape is just a state value of 63
+                inValue[face] = symbol;
+                fp->rxState = RX_IDLE;
+            } else if (symbol==PACKET_ACK) {
+                receiveAck( fp );
+                fp->rxState = RX_IDLE;
+            } else if ( receiveHeader( fp , symbol ) ) {                // Start of a packet
+                fp->rxState = RX_DATA;
+            } else {                                                    // Garbled, so start over
+                fp->rxState = RX_IDLE;
+            }
+            break;
+
+        case RX_DATA:
+
+            if (symbol==PACKET_ESCAPE) {
+                fp->rxState = RX_DATA_ESCAPED;                          // Wait to see if this is a 63 or the start of a new packet
+            } else {
+                receivePacketSymbol( face , fp , symbol , now );
+            }
+            break;
+
+        default:    // RX_DATA_ESCAPED
+
+            if (symbol==PACKET_ESCAPE) {                                // Escaped escape is just a 63 in the packet
+                fp->rxState = RX_DATA;
+                receivePacketSymbol( face , fp , symbol , now );
+            } else if (symbol==PACKET_ACK) {                            // Ack slipped in between the symbols of the packet
+                receiveAck( fp );
+                fp->rxState = RX_DATA;
+            } else {
+
+                // We must have lost a symbol of the packet we were collecting, since a new one is starting.
+                // Drop what we had and pick up the new one. We don't know when its escape was sent, so its age is unknown.
+
+                fp->rxWait = PACKET_WAIT_MAX;
+
+                if ( receiveHeader( fp , symbol ) ) {
+                    fp->rxState = RX_DATA;
+                } else {
+                    fp->rxState = RX_IDLE;
+                }
+
+            }
+            break;
+
+    }
+
+}
+
+// Neighbor is gone, so forget any packets in progress rather than trickling them out at the probe rate
+
+static void forgetPackets( byte face ) {
+
+    facePackets[face].txLen = 0;
+    facePackets[face].txAckWait = 0;
+    facePackets[face].txAckState = 0;
+    facePackets[face].rxState = RX_IDLE;
+
+}
+
+// Get the next symbol to send on this face. Packets take priority over state values.
+
+static byte nextSymbol( byte face , uint32_t now ) {
+
+    facepacket_t *fp = &facePackets[face];
+
+    if (fp->txLiteralFlag) {
+
+        // Finish off an escaped state value of 63 before anything else can go out
+
+        fp->txLiteralFlag = 0;
+        return PACKET_ESCAPE;
+
+    }
+
+    // Acks jump the line, except they can't split the escape that starts a packet from its header
+
+    if ( fp->txAckState && !( fp->txLen && !fp->txAckWait && fp->txIndex==1 ) ) {
+
+        if ( fp->txAckState == 1 ) {
+            fp->txAckState = 2;
+            return PACKET_ESCAPE;
+        }
+
+        fp->txAckState = 0;
+        return PACKET_ACK;
+
+    }
+
+    if (fp->txAckWait) {
+
+        fp->txAckWait--;
+
+        if (!fp->txAckWait) {
+
+            if (fp->txRetries) {
+                fp->txRetries--;
+                fp->txIndex = 0;        // Send it again starting next symbol
+            } else {
+                fp->txLen = 0;          // Give up
+            }
+
+        }
+
+    } else if (fp->txLen) {
+
+        byte i = fp->txIndex++;
+
+        if (i==0) {
+
+            // Round to the nearest unit. Rounding down would make every packet look a few ms younger than it is.
+
+            uint16_t wait = ( (uint16_t) now - fp->txQueueTime + ( PACKET_WAIT_UNIT_MS / 2 ) ) / PACKET_WAIT_UNIT_MS;
+
+            fp->txWait = ( wait < PACKET_WAIT_MAX ) ? wait : PACKET_WAIT_MAX;
+
+            return PACKET_ESCAPE;
+        }
+
+        if (i==1) {
+            byte header = fp->txLen + ( fp->txWait * PACKET_MAX_LEN );
+            fp->txCheck = header;
+            return header;
+        }
+
+        byte n = i - 2;
+
+        byte symbol;
+
+        if ( n < PACKET_SYMBOL_COUNT( fp->txLen ) ) {
+            symbol = packetGetSymbol( fp->txBuffer , n );
+            fp->txCheck = packetCheckStep( fp->txCheck , symbol );
+        } else if ( n == PACKET_SYMBOL_COUNT( fp->txLen ) ) {
+            symbol = fp->txCheck & 0b00111111;
+        } else {
+            fp->txAckWait = PACKET_ACK_WAIT;    // High half of the check is the last one, so now we wait for the ack
+            symbol = fp->txCheck >> 6;
+        }
+
+        if (symbol==PACKET_ESCAPE) {
+
+            // A 63 inside a packet also goes out as two escapes. That way if the receiver lost a symbol and
+            // is out of step with us, it can still spot the start of the next packet.
+
+            fp->txLiteralFlag = 1;
+
+        }
+
+        return symbol;
+
+    }
+
+    byte value = outValue[face];
+
+    if (value==PACKET_ESCAPE) {
+
+        // A state value of 63 goes out as two escapes so it can't be confused with the start of a packet
+
+        fp->txLiteralFlag = 1;
+
+    }
+
+    return value;
+
+}
+
+// Same as receiveSymbol() for before the packet layer starts. We just step over packets, so
+// the state values that come after them don't get mixed up with the packet symbols.
+
+static void receivePlainSymbol( byte face , byte symbol , uint32_t ) {
+
+    faceescape_t *fe = &faceEscapes[face];
+
+    switch (fe->rxState) {
+
+        case RX_IDLE:
+
+            if (symbol==PACKET_ESCAPE) {
+                fe->rxState = RX_ESCAPED;
+            } else {
+                inValue[face] = symbol;
+            }
+            break;
+
+        case RX_ESCAPED:
+
+            if (symbol==PACKET_ESCAPE) {                                // Escaped escape is just a state value of 63
+                inValue[face] = symbol;
+                fe->rxState = RX_IDLE;
+            } else if ( isPacketHeader( symbol ) ) {
+                fe->rxSkip = packetTailLen( symbol );
+                fe->rxState = RX_DATA;
+            } else {                                                    // An ack (or garbled), so nothing follows
+                fe->rxState = RX_IDLE;
+            }
+            break;
+
+        case RX_DATA:
+
+            if (symbol==PACKET_ESCAPE) {
+                fe->rxState = RX_DATA_ESCAPED;
+            } else if ( !--fe->rxSkip ) {
+                fe->rxState = RX_IDLE;
+            }
+            break;
+
+        default:    // RX_DATA_ESCAPED
+
+            if (symbol==PACKET_ESCAPE) {                                // Escaped escape is just a 63 in the packet
+                fe->rxState = --fe->rxSkip ? RX_DATA : RX_IDLE;
+            } else if (symbol==PACKET_ACK) {
+                fe->rxState = RX_DATA;
+            } else if ( isPacketHeader( symbol ) ) {                    // Lost a symbol and a new packet is starting
+                fe->rxSkip = packetTailLen( symbol );
+                fe->rxState = RX_DATA;
+            } else {
+                fe->rxState = RX_IDLE;
+            }
+            break;
+
+    }
+
+}
+
+// Same as nextSymbol() for before the packet layer starts
+
+static byte nextPlainSymbol( byte face , uint32_t ) {
+
+    faceescape_t *fe = &faceEscapes[face];
+
+    if (fe->txLiteralFlag) {
+        fe->txLiteralFlag = 0;
+        return PACKET_ESCAPE;
+    }
+
+    byte value = outValue[face];
+
+    if (value==PACKET_ESCAPE) {
+        fe->txLiteralFlag = 1;
+    }
+
+    return value;
+
+}
+
+static void forgetPlainSymbols( byte face ) {
+
+    faceEscapes[face].rxState = RX_IDLE;
+
+}
+
+// The symbol handling we are using right now. These only point at the packet versions once startPackets() runs,
+// so the packet code and buffers do not get linked in unless something can call it.
+
+static void (*receiveSymbolHook)( byte face , byte symbol , uint32_t now ) = receivePlainSymbol;
+static byte (*nextSymbolHook)( byte face , uint32_t now ) = nextPlainSymbol;
+static void (*forgetFaceHook)( byte face ) = forgetPlainSymbols;
+
+static void startPackets(void) {
+
+    if ( nextSymbolHook == nextSymbol ) {
+        return;                             // Already running
+    }
+
+    // Finish any escaped 63 we are in the middle of, or the neighbor would take the next symbol for a packet header
+
+    FOREACH_FACE(f) {
+        facePackets[f].txLiteralFlag = faceEscapes[f].txLiteralFlag;
+    }
+
+    receiveSymbolHook = receiveSymbol;
+    nextSymbolHook    = nextSymbol;
+    forgetFaceHook    = forgetPackets;
+
+}
+
 
 // check and see if any states recently updated....
 
@@ -80,20 +622,27 @@ static void updateIRFaces(uint32_t now) {
             // Got something, so we know there is someone out there
             expireTime[f] = now + expireDurration_ms;
         
-            // Clear to send on this face immediately to ping-pong messages at max speed without collisions
-            neighboorSendTime[f] = 0;
-        
             byte receivedMessage = irGetData(f);
             
-            inValue[f] = receivedMessage;
+            receiveSymbolHook( f , receivedMessage , now );    // Do this first since it looks at when we last sent
+
+            // Clear to send on this face immediately to ping-pong messages at max speed without collisions
+            neighboorSendTime[f] = 0;
         
+        } else if ( expireTime[f] + sendprobeDurration_ms < now ) {
+
+            // Neighbor is gone. We wait an extra probe time before giving up on it since a single lost symbol
+            // stalls the link until the next probe.
+
+            forgetFaceHook( f );
+
         }
         
         // Send out if it is time....
         
         if ( neighboorSendTime[f] <= now ) {        // Time to send on this face?
         
-            irSendData( f , outValue[f]  );
+            irSendData( f , nextSymbolHook( f , now ) );
                     
             // Here we set a timeout to keep periodically probing on this face, but
             // if there is a neighbor, they will send back to us as soon as they get what we
@@ -249,3 +798,58 @@ void setValueSentOnFace( byte newState , byte face ) {
     
 }
 
+
+// Queue a packet to be sent on the indicated face.
+// Returns false if a packet is already being sent on this face, or if there is no neighbor there.
+
+bool sendPacketOnFace( byte face , const byte *data , byte len ) {
+
+    startPackets();
+
+    facepacket_t *fp = &facePackets[face];
+
+    if ( fp->txLen || len==0 || len>PACKET_MAX_LEN || isValueReceivedOnFaceExpired( face ) ) {
+        return false;
+    }
+
+    memcpy( fp->txBuffer , data , len );
+    memset( fp->txBuffer + len , 0 , sizeof( fp->txBuffer ) - len );
+
+    fp->txIndex     = 0;
+    fp->txRetries   = PACKET_RETRY_COUNT;
+    fp->txQueueTime = millis();
+    fp->txLen       = len;     // Set last since this is what makes it go
+
+    return true;
+
+}
+
+// Returns true if a previously queued packet has not finished sending on this face (or is still waiting for the ack)
+
+bool isPacketPendingOnFace( byte face ) {
+
+    return facePackets[face].txLen != 0;
+
+}
+
+// Add a handler to be called for every good packet received.
+// `cons` onto the linked list of handlers
+
+void addOnPacket( packethandler_t *packethandler ) {
+
+    startPackets();
+
+    packethandler->next = onPacketChain;
+    onPacketChain = packethandler;
+
+}
+
+// About how long ago the sender queued the packet currently being handed to the handlers,
+// or PACKET_AGE_UNKNOWN if symbols were lost along the way so we can't tell.
+// Only meaningful when called from inside a packet handler.
+
+uint16_t getPacketAge_ms(void) {
+
+    return dispatchAge_ms;
+
+}
@@ -13,6 +13,9 @@
  * Note that the beacon transmissions only occur when the loop() function returns, so it is important
  * that sketches using this model return from loop() frequently.
  *
+ * The cluster services built on the packets below (flood.h, timesync.h, discovery.h, election.h, aggregate.h,
+ * route.h, seed.h, and palette.h) live in this library too, so blinklib never depends on blinkstate.
+ *
  */
 
 #ifndef BLINKSTATE_H_
@@ -62,9 +65,81 @@ void setValueSentOnAllFaces( byte newState );
 
 // By default we power up with all faces sending the value 0.
 
+// A value of 63 goes out on the wire as two 63s, since a single 63 starts a packet (see below). Tiles running
+// blinkstate from before packets were added send 63 as a single symbol, so a 63 from one of them can swallow the next
+// few values it sends, and packets from us show up there as a burst of junk values. Don't mix the two in a cluster,
+// or stay away from 63 if you must.
+
 void setValueSentOnFace( byte value , byte face );
 
 
+// Packets are short strings of bytes sent to the neighbor on a single face.
+// They share the IR link with the state values above, so sending a packet briefly
+// pauses the state value repeats on that face (the neighbor does not expire while a packet is in flight).
+// Packets are sent one symbol per ping-pong, so a full length packet takes about 15 round trips.
+//
+// The packet code and its buffers (about 230 bytes of RAM) only get linked in if something calls addOnPacket() or
+// sendPacketOnFace(), and packets only start moving after the first call. Until then packets from the neighbors
+// are quietly stepped over and never acked, so the sender gives up on them after a few tries.
+
+// Max number of bytes in a packet. Each face gets a TX and an RX buffer this big, so keep it small.
+
+#define PACKET_MAX_LEN 8
+
+// The first byte of every packet is a type that says which service it belongs to.
+// Keep this list here so services do not step on each other.
+
+#define PACKET_TYPE_FLOOD       1
+#define PACKET_TYPE_TIMESYNC    2
+#define PACKET_TYPE_NEIGHBOR    3
+#define PACKET_TYPE_POSITION    4
+#define PACKET_TYPE_ELECTION    5
+#define PACKET_TYPE_AGGREGATE   6
+#define PACKET_TYPE_AGGREGATE_RESULT 7
+#define PACKET_TYPE_ROUTE       8
+#define PACKET_TYPE_ROUTE_ANNOUNCE 9
+#define PACKET_TYPE_SEED_STATUS 10
+#define PACKET_TYPE_SEED_DATA   11
+#define PACKET_TYPE_PALETTE     12
+
+// Queue a packet to be sent on the indicated face.
+// len must be 1-PACKET_MAX_LEN.
+// Returns false (and does not send) if a packet is already being sent on this face,
+// or if there is no neighbor on this face.
+// The neighbor acks every good packet and we resend a few times if we do not hear back, so a lost symbol
+// rarely loses a packet. Delivery is still not guaranteed though, and if the ack is lost the neighbor
+// will get the same packet twice.
+
+bool sendPacketOnFace( byte face , const byte *data , byte len );
+
+// Returns true if a previously queued packet has not finished sending on this face (or is still waiting for the ack)
+
+bool isPacketPendingOnFace( byte face );
+
+// Called from inside the blinkstate onLoop hook for every good packet received.
+// data[0] is the packet type. Each handler should ignore types it does not own.
+
+typedef struct packethandler_struct {
+
+    void (*callback)( byte face , const byte *data , byte len );
+
+    struct packethandler_struct *next;
+
+} packethandler_t;
+
+// Add a handler to be called for every good packet received
+
+void addOnPacket( packethandler_t *packethandler );
+
+// About how many milliseconds ago the sender queued the current packet, or PACKET_AGE_UNKNOWN if the
+// link hiccuped while it was being sent so we can't tell. Only valid when called from inside a packet handler.
+// Lets time sensitive services account for the time the packet spent on the wire.
+
+#define PACKET_AGE_UNKNOWN 0xffff
+
+uint16_t getPacketAge_ms(void);
+
+
 #ifndef BLINKSTATE_CANNARY
 
     // We need to hide the direct IR functions or else they might consume IR events that we need to read
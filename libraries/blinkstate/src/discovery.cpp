@@ -0,0 +1,372 @@
+/*
+ * discovery.cpp
+ *
+ * Neighbor ids and cluster coordinates.
+ *
+ * We send two kinds of packets on each face...
+ *
+ *    PACKET_TYPE_NEIGHBOR , id (2 bytes, LSB first) , face
+ *    PACKET_TYPE_POSITION , rootId (2 bytes, LSB first) , hops , q , r , face | ( rotation << 3 )
+ *
+ * ...where face is the face the packet was sent on. The neighbor packet fills in the neighbor table on the
+ * other side. The position packet tells the neighbor which root we are following, how far away it is, and
+ * where we sit on its grid.
+ *
+ * The root is the cluster leader from election.h. Every pass through loop() we look for the neighbor that is
+ * following the same root with the fewest hops, and take our position from it. If the neighbor with face nf
+ * touching our face f is at (q,r) with rotation nrot, then its face nf points in direction (nf + nrot), so we sit
+ * one step that way. Our face f points back at it, so...
+ *
+ *    ourPosition = theirPosition + direction[ ( nf + nrot ) % 6 ]
+ *    ourRotation = ( nf + nrot + 3 - f ) % 6
+ *
+ * When the root leaves, the election picks a new leader and everyone drops the old positions since they are
+ * for the wrong root. Until the new positions reach us we act as the root of our own little grid.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "discovery.h"
+#include "election.h"
+
+#define NEIGHBOR_PACKET_LEN 4
+#define POSITION_PACKET_LEN 7
+
+// How long a face has to be empty before we forget the neighbor that was there
+
+#define DISCOVERY_FORGET_MS 500
+
+#define ALL_FACES_MASK      (0b00111111)        // One bit per face
+
+// Axial steps for each direction. See discovery.h
+
+static const int8_t directionQ[FACE_COUNT] = { +1 , +1 ,  0 , -1 , -1 ,  0 };
+static const int8_t directionR[FACE_COUNT] = {  0 , -1 , -1 ,  0 , +1 , +1 };
+
+// What we know about the neighbor on each face
+
+typedef struct {
+
+    uint16_t id;
+    byte theirFace;             // Their face that is touching us
+
+    // Their most recent position report
+
+    uint16_t rootId;
+    byte hops;
+    int8_t q;
+    int8_t r;
+    byte rotation;
+
+} neighborinfo_t;
+
+static neighborinfo_t neighbors[FACE_COUNT];
+
+static byte idKnownMask;            // Faces where we have gotten a neighbor packet since the neighbor showed up
+static byte positionKnownMask;      // Faces where we have gotten a position packet since the neighbor showed up
+static byte presentMask;            // Faces that have a neighbor (or had one very recently)
+
+static uint16_t lastSeenTime[FACE_COUNT];   // Low bits of millis() when we last saw a neighbor on each face
+
+// Where we are
+
+static uint16_t rootId;
+static byte hops;
+static int8_t positionQ;
+static int8_t positionR;
+static byte rotation;
+static byte parentFace = FACE_COUNT;    // Face we got our position from. FACE_COUNT=we are the root.
+
+// What we still need to send
+
+static byte sendIdMask;
+static byte sendPositionMask;
+static uint32_t nextSendTime;
+
+// Called for every packet received by blinkstate
+
+static void discoveryOnPacket( byte face , const byte *data , byte len ) {
+
+    neighborinfo_t *n = &neighbors[face];
+
+    if ( data[0]==PACKET_TYPE_NEIGHBOR && len==NEIGHBOR_PACKET_LEN ) {
+
+        n->id        = data[1] | ( data[2] << 8 );
+        n->theirFace = data[3];
+
+        idKnownMask |= 1<<face;
+
+    } else if ( data[0]==PACKET_TYPE_POSITION && len==POSITION_PACKET_LEN ) {
+
+        n->rootId    = data[1] | ( data[2] << 8 );
+        n->hops      = data[3];
+        n->q         = data[4];
+        n->r         = data[5];
+        n->theirFace = data[6] & 0b00000111;
+        n->rotation  = data[6] >> 3;
+
+        positionKnownMask |= 1<<face;
+
+    }
+
+}
+
+// Find the neighbor closest to the leader and work out our position from it.
+// Returns true if anything changed.
+
+static bool updatePosition(void) {
+
+    uint16_t bestRoot = getLeaderId();
+    byte bestHops     = 0;
+    byte bestFace     = FACE_COUNT;
+
+    if ( !isLeader() ) {
+
+        FOREACH_FACE(f) {
+
+            if ( positionKnownMask & (1<<f) ) {
+
+                neighborinfo_t *n = &neighbors[f];
+
+                if ( n->rootId == bestRoot && n->hops < DISCOVERY_MAX_HOPS ) {
+
+                    byte h = n->hops + 1;
+
+                    // Fewest hops wins. On a tie we stick with our current parent so we don't flip back and forth.
+
+                    if ( bestFace == FACE_COUNT || h < bestHops || ( h == bestHops && f == parentFace ) ) {
+
+                        bestHops = h;
+                        bestFace = f;
+
+                    }
+
+                }
+
+            }
+
+        }
+
+        if ( bestFace == FACE_COUNT ) {
+            bestRoot = getTileId();         // Nobody near us has a position on the leader's grid yet, so we are on our own for now
+        }
+
+    }
+
+    int8_t q = 0;
+    int8_t r = 0;
+    byte rot = 0;
+
+    if ( bestFace != FACE_COUNT ) {
+
+        neighborinfo_t *n = &neighbors[bestFace];
+
+        byte dir = ( n->theirFace + n->rotation ) % FACE_COUNT;
+
+        q   = n->q + directionQ[dir];
+        r   = n->r + directionR[dir];
+        rot = ( dir + 3 + FACE_COUNT - bestFace ) % FACE_COUNT;
+
+    }
+
+    bool changedFlag = ( bestRoot != rootId || bestHops != hops || q != positionQ || r != positionR || rot != rotation );
+
+    rootId     = bestRoot;
+    hops       = bestHops;
+    positionQ  = q;
+    positionR  = r;
+    rotation   = rot;
+    parentFace = bestFace;
+
+    return changedFlag;
+
+}
+
+static void discoveryOnLoop(void) {
+
+    uint32_t now = millis();
+
+    // Forget anyone who left, and say hello to anyone new.
+    // A lost symbol can make a face look empty for a moment, so we wait a bit before forgetting a neighbor.
+
+    FOREACH_FACE(f) {
+
+        byte bit = 1<<f;
+
+        if ( !isValueReceivedOnFaceExpired(f) ) {
+
+            lastSeenTime[f] = now;
+
+            if ( !(presentMask & bit) ) {
+
+                presentMask      |= bit;
+                sendIdMask       |= bit;
+                sendPositionMask |= bit;
+
+            }
+
+        } else if ( (uint16_t) ( now - lastSeenTime[f] ) > DISCOVERY_FORGET_MS ) {
+
+            presentMask       &= ~bit;
+            idKnownMask       &= ~bit;
+            positionKnownMask &= ~bit;
+
+        }
+
+    }
+
+    if ( updatePosition() ) {
+        sendPositionMask = ALL_FACES_MASK;          // Tell everyone right away so the news spreads quickly
+    }
+
+    if ( (int32_t) ( now - nextSendTime ) >= 0 ) {
+        sendIdMask       = ALL_FACES_MASK;
+        sendPositionMask = ALL_FACES_MASK;
+        nextSendTime     = now + DISCOVERY_PERIOD_MS;
+    }
+
+    sendIdMask       &= presentMask;
+    sendPositionMask &= presentMask;
+
+    // Only one packet can be in flight per face, so id goes first and position waits its turn
+
+    FOREACH_FACE(f) {
+
+        byte bit = 1<<f;
+
+        if ( sendIdMask & bit ) {
+
+            uint16_t id = getTileId();
+
+            byte packet[NEIGHBOR_PACKET_LEN] = { PACKET_TYPE_NEIGHBOR , (byte) id , (byte) (id >> 8) , (byte) f };
+
+            if ( sendPacketOnFace( f , packet , NEIGHBOR_PACKET_LEN ) ) {
+                sendIdMask &= ~bit;
+            }
+
+        } else if ( sendPositionMask & bit ) {
+
+            byte packet[POSITION_PACKET_LEN] = { PACKET_TYPE_POSITION , (byte) rootId , (byte) (rootId >> 8) , hops , (byte) positionQ , (byte) positionR , (byte) ( f | ( rotation << 3 ) ) };
+
+            if ( sendPacketOnFace( f , packet , POSITION_PACKET_LEN ) ) {
+                sendPositionMask &= ~bit;
+            }
+
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct discoveryOnLoopChain = {
+     .callback = discoveryOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static packethandler_t discoveryOnPacketChain = {
+     .callback = discoveryOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any discovery function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        addOnLoop( &discoveryOnLoopChain );
+        addOnPacket( &discoveryOnPacketChain );
+        hookRegisteredFlag=1;
+        rootId = getLeaderId();             // Gets the election going. Do this after we hook in so it runs first and its heartbeats get first dibs on the faces.
+    }
+}
+
+bool isNeighborKnownOnFace( byte face ) {
+
+    registerHook();
+
+    return idKnownMask & (1<<face);
+
+}
+
+uint16_t getNeighborIdOnFace( byte face ) {
+
+    registerHook();
+
+    return neighbors[face].id;
+
+}
+
+byte getNeighborFaceOnFace( byte face ) {
+
+    registerHook();
+
+    return neighbors[face].theirFace;
+
+}
+
+uint16_t getRootId(void) {
+
+    registerHook();
+
+    return rootId;
+
+}
+
+bool isRoot(void) {
+
+    registerHook();
+
+    return parentFace == FACE_COUNT;
+
+}
+
+byte getHopsFromRoot(void) {
+
+    registerHook();
+
+    return hops;
+
+}
+
+byte getRootFace(void) {
+
+    registerHook();
+
+    return parentFace;
+
+}
+
+int8_t getPositionQ(void) {
+
+    registerHook();
+
+    return positionQ;
+
+}
+
+int8_t getPositionR(void) {
+
+    registerHook();
+
+    return positionR;
+
+}
+
+byte getRotation(void) {
+
+    registerHook();
+
+    return rotation;
+
+}
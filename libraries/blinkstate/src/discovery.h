@@ -0,0 +1,91 @@
+/*
+ * discovery.h
+ *
+ * Find out who our neighbors are and where we sit in the cluster.
+ *
+ * Tiles tell each neighbor their id (see getTileId()) and which of their faces is touching. With this a
+ * sketch can tell apart two neighbors that are sending the same value, or notice that a neighbor was swapped
+ * out for a different tile.
+ *
+ * Tiles also work out a shared hex grid for the cluster. The cluster leader (see election.h) becomes the root at
+ * position (0,0) with rotation 0, and every other tile works out its position and rotation from a neighbor
+ * that is one step closer to the root. Positions use axial hex coordinates (q,r) where...
+ *
+ *    direction 0 = ( +1 ,  0 )
+ *    direction 1 = ( +1 , -1 )
+ *    direction 2 = (  0 , -1 )
+ *    direction 3 = ( -1 ,  0 )
+ *    direction 4 = ( -1 , +1 )
+ *    direction 5 = (  0 , +1 )
+ *
+ * ...and direction d is the way face d points on the root tile. Face f on our tile points in direction
+ * (f + getRotation()) % FACE_COUNT. The distance between two tiles is ( |dq| + |dr| + |dq+dr| ) / 2.
+ *
+ * RAM use is fixed at a few bytes per face no matter how big the cluster gets.
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so updates
+ * only happen when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ */
+
+#ifndef DISCOVERY_H_
+#define DISCOVERY_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before discovery.h
+#endif
+
+// How often we repeat our info to the neighbors. We also send right away whenever a new neighbor
+// shows up or our position changes, and blinkstate resends packets that do not get through, so
+// this only matters for catching the rare packet that is lost anyway.
+
+#define DISCOVERY_PERIOD_MS     4000
+
+// Tiles further than this many steps from the root give up and become their own root. This stops
+// a loop of tiles that lost their way to the root from counting up forever.
+
+#define DISCOVERY_MAX_HOPS      24
+
+// Do we know the id of the neighbor on this face yet?
+// Goes false about half a second after the neighbor goes away.
+
+bool isNeighborKnownOnFace( byte face );
+
+// Id of the neighbor on this face. Only valid if isNeighborKnownOnFace() is true.
+
+uint16_t getNeighborIdOnFace( byte face );
+
+// Which of the neighbor's faces is touching our face. Only valid if isNeighborKnownOnFace() is true.
+
+byte getNeighborFaceOnFace( byte face );
+
+// Id of the root of our cluster. This is our own id if we are the root (or alone).
+// Once things settle this is the same as getLeaderId().
+
+uint16_t getRootId(void);
+
+// Are we the root of our cluster?
+
+bool isRoot(void);
+
+// How many steps we are from the root (0=we are the root)
+
+byte getHopsFromRoot(void);
+
+// Which face leads one step closer to the root (the neighbor we got our position from).
+// FACE_COUNT if we are the root. This only changes when the tree does, so it is a steadier
+// path to the root than getLeaderFace().
+
+byte getRootFace(void);
+
+// Our position on the cluster hex grid. The root is at (0,0).
+
+int8_t getPositionQ(void);
+int8_t getPositionR(void);
+
+// Which direction our face 0 points on the cluster grid (0-5)
+
+byte getRotation(void);
+
+#endif /* DISCOVERY_H_ */
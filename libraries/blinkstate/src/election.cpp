@@ -0,0 +1,269 @@
+/*
+ * election.cpp
+ *
+ * Max-id leader election with flooded heartbeats.
+ *
+ * A heartbeat packet looks like...
+ *
+ *    PACKET_TYPE_ELECTION , leaderId (2 bytes, LSB first) , seq , hops
+ *
+ * ...where seq goes up by one with each heartbeat the leader sends, and hops is how many times it was
+ * passed along before this one.
+ *
+ * Every tile starts out as its own leader. When we hear a heartbeat...
+ *
+ *    (1) From a higher id than our leader, or our leader with a newer seq, we take it and pass it on to
+ *        every face except the one it came in on.
+ *    (2) The same one we already have, that neighbor is up to date. Since we do not pass these on, this is
+ *        what keeps the flood from going forever.
+ *    (3) From a lower id or an older seq, that neighbor is behind, so we send them our latest heartbeat.
+ *
+ * blinkstate resends any packet that the neighbor does not ack, so one unlucky link is very unlikely to make
+ * every tile past it think the leader was gone. We also send our latest heartbeat to any new neighbor, so tiles
+ * that are added catch on right away.
+ *
+ * When the leader goes away its heartbeats stop, and after ELECTION_TIMEOUT_MS every tile starts over as its
+ * own leader. The neighbors will not all time out at exactly the same moment, so for a while afterwards we
+ * ignore anything from the old leader that is not newer than the last heartbeat we saw from it. Otherwise the
+ * stragglers would keep handing the dead leader back to us.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "election.h"
+
+#define ELECTION_PACKET_LEN 5
+
+// Extra time to wait before giving up on the leader for each hop away it is. A packet takes about 200ms to cross
+// a link, and can take twice that if it gets garbled or has to wait for another packet to go first.
+
+#define ELECTION_HOP_TIMEOUT_MS 200
+
+// How long a face has to be empty before we forget the neighbor that was there
+
+#define ELECTION_FORGET_MS  500
+
+#define ALL_FACES_MASK      (0b00111111)        // One bit per face
+
+// Our current leader
+
+static uint16_t leaderId;
+static byte leaderSeq;
+static byte leaderHops;
+static byte leaderFace = FACE_COUNT;    // Face the latest heartbeat came in on. FACE_COUNT=we are the leader.
+static uint32_t lastHeardTime;          // millis() when we last got a new heartbeat
+
+// The leader that most recently timed out, so we can ignore stale heartbeats from it
+
+static uint16_t deadId;
+static byte deadSeq;
+static uint32_t deadTime;               // millis() when it timed out
+
+// What we still need to send
+
+static byte sendMask;                   // Faces to send our latest heartbeat on next chance we get
+static byte presentMask;                // Faces that have a neighbor (or had one very recently)
+static uint16_t lastSeenTime[FACE_COUNT];   // Low bits of millis() when we last saw a neighbor on each face
+static uint32_t nextBeatTime;           // When to send our next heartbeat (only when we are the leader)
+
+// Is seq a later heartbeat than `than`? Works across wrap as long as they are less than 128 apart.
+
+static bool isNewerSeq( byte seq , byte than ) {
+
+    return (int8_t) ( seq - than ) > 0;
+
+}
+
+static void becomeLeader( uint32_t now ) {
+
+    leaderId     = getTileId();
+    leaderHops   = 0;
+    leaderFace   = FACE_COUNT;
+    nextBeatTime = now;                 // Tell everyone right away
+
+}
+
+// Called for every packet received by blinkstate
+
+static void electionOnPacket( byte face , const byte *data , byte len ) {
+
+    if ( data[0]!=PACKET_TYPE_ELECTION || len!=ELECTION_PACKET_LEN ) {
+        return;
+    }
+
+    uint16_t id = data[1] | ( data[2] << 8 );
+    byte seq    = data[3];
+    byte hops   = data[4];
+    byte bit    = 1<<face;
+
+    if ( id == getTileId() ) {
+        return;                         // Our own heartbeat coming back around
+    }
+
+    if ( deadId && id == deadId && !isNewerSeq( seq , deadSeq ) ) {
+        return;                         // Leftover from a leader that is gone
+    }
+
+    if ( id > leaderId || ( id == leaderId && isNewerSeq( seq , leaderSeq ) ) ) {
+
+        leaderId      = id;
+        leaderSeq     = seq;
+        leaderHops    = hops < 255 ? hops + 1 : 255;
+        leaderFace    = face;
+        lastHeardTime = millis();
+
+        // Pass it on to everyone except the one we got it from
+
+        sendMask = ALL_FACES_MASK & ~bit;
+
+    } else if ( id < leaderId || seq != leaderSeq ) {
+
+        // They are following a loser or are behind, so set them straight
+
+        sendMask |= bit;
+
+    } else {
+
+        // Same heartbeat we already have, so they are up to date and we don't need to send it to them
+
+        sendMask &= ~bit;
+
+    }
+
+}
+
+static void electionOnLoop(void) {
+
+    uint32_t now = millis();
+
+    // Heartbeats get more jittery with each hop they take, so far away tiles wait a bit longer before giving up
+
+    if ( leaderFace != FACE_COUNT && now - lastHeardTime > (uint32_t) ( ELECTION_TIMEOUT_MS + leaderHops * ELECTION_HOP_TIMEOUT_MS ) ) {
+
+        deadId   = leaderId;
+        deadSeq  = leaderSeq;
+        deadTime = now;
+
+        becomeLeader( now );
+
+    }
+
+    if ( leaderFace == FACE_COUNT && (int32_t) ( now - nextBeatTime ) >= 0 ) {
+
+        leaderSeq++;
+
+        sendMask     = ALL_FACES_MASK;
+        nextBeatTime = now + ELECTION_PERIOD_MS;
+
+    }
+
+    // By now every tile has timed out the dead leader, so nobody is going to send it to us anymore.
+    // Forget it so that if that tile comes back with a fresh seq we do not ignore it.
+
+    if ( deadId && now - deadTime > ELECTION_TIMEOUT_MS * 2 ) {
+        deadId = 0;
+    }
+
+    // A lost symbol can make a face look empty for a moment, so we wait a bit before forgetting a neighbor.
+    // Otherwise every lost symbol would look like a new neighbor and we would send them a heartbeat they already have.
+
+    FOREACH_FACE(f) {
+
+        byte bit = 1<<f;
+
+        if ( !isValueReceivedOnFaceExpired(f) ) {
+
+            lastSeenTime[f] = now;
+
+            if ( !(presentMask & bit) ) {
+
+                presentMask |= bit;
+                sendMask    |= bit;     // New neighbor, tell them who is in charge
+
+            }
+
+        } else if ( (uint16_t) ( now - lastSeenTime[f] ) > ELECTION_FORGET_MS ) {
+
+            presentMask &= ~bit;
+            sendMask    &= ~bit;
+
+        }
+
+        if ( ( sendMask & bit ) && ( presentMask & bit ) ) {
+
+            byte packet[ELECTION_PACKET_LEN] = { PACKET_TYPE_ELECTION , (byte) leaderId , (byte) (leaderId >> 8) , leaderSeq , leaderHops };
+
+            if ( sendPacketOnFace( f , packet , ELECTION_PACKET_LEN ) ) {
+                sendMask &= ~bit;
+            }
+
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct electionOnLoopChain = {
+     .callback = electionOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static packethandler_t electionOnPacketChain = {
+     .callback = electionOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any election function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        becomeLeader( millis() );
+        addOnLoop( &electionOnLoopChain );
+        addOnPacket( &electionOnPacketChain );
+        hookRegisteredFlag=1;
+    }
+}
+
+bool isLeader(void) {
+
+    registerHook();
+
+    return leaderFace == FACE_COUNT;
+
+}
+
+uint16_t getLeaderId(void) {
+
+    registerHook();
+
+    return leaderId;
+
+}
+
+byte getLeaderFace(void) {
+
+    registerHook();
+
+    return leaderFace;
+
+}
+
+byte getHopsFromLeader(void) {
+
+    registerHook();
+
+    return leaderHops;
+
+}
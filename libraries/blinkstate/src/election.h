@@ -0,0 +1,54 @@
+/*
+ * election.h
+ *
+ * Pick a single leader for a cluster.
+ *
+ * Every tile in a connected cluster agrees on one leader, which is the tile with the highest id (see getTileId()).
+ * Games can use the leader as the coordinator that deals out teams, keeps score, or starts a round.
+ *
+ * The leader sends out a heartbeat every ELECTION_PERIOD_MS that gets flooded across the cluster. If a tile
+ * stops hearing heartbeats for ELECTION_TIMEOUT_MS then it assumes the leader is gone and starts sending
+ * heartbeats of its own, and the highest id left wins again. When two clusters are joined, the lower leader
+ * hears about the higher one and gives up.
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so updates
+ * only happen when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ */
+
+#ifndef ELECTION_H_
+#define ELECTION_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before election.h
+#endif
+
+// How often the leader sends a heartbeat.
+
+#define ELECTION_PERIOD_MS      1000
+
+// How long without a heartbeat before we decide the leader is gone.
+// This is how long it takes the cluster to notice that the leader was removed.
+// Must be a few periods so that one lost heartbeat does not start a new election.
+
+#define ELECTION_TIMEOUT_MS     3000
+
+// Are we the leader of our cluster? Always true if we are alone.
+
+bool isLeader(void);
+
+// Id of the leader of our cluster. This is our own id if we are the leader.
+
+uint16_t getLeaderId(void);
+
+// Which face the most recent heartbeat came in on. Following this face leads back towards the leader.
+// FACE_COUNT if we are the leader.
+
+byte getLeaderFace(void);
+
+// How many steps the most recent heartbeat took to get to us (0=we are the leader).
+
+byte getHopsFromLeader(void);
+
+#endif /* ELECTION_H_ */
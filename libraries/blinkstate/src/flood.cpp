@@ -0,0 +1,257 @@
+/*
+ * flood.cpp
+ *
+ * Cluster-wide flood broadcast with duplicate suppression.
+ *
+ * A flood packet looks like...
+ *
+ *    PACKET_TYPE_FLOOD , id , hopsLeft , hopsTaken , value
+ *
+ * When we get a flood packet with an id that we have not seen recently, we remember the id, post it for
+ * the sketch to read, and (if it has hops left) queue it to be sent on every face except the face it came
+ * in on. We keep trying to send on each face every pass though loop() until it gets out, or until that face
+ * has had no neighbor for FLOOD_ABSENT_MS.
+ *
+ * We can't just skip faces that look empty when the packet comes in. A single lost symbol stalls a blinkstate
+ * link until the next probe, which is longer than the expire time, so a neighbor that is really there can
+ * look gone for a moment. If a flood came in right then, it would never cross that link.
+ *
+ */
+
+#include <stddef.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "flood.h"
+
+#define FLOOD_PACKET_LEN 5
+
+// How long we keep trying a face that has no neighbor before giving up on it.
+// Longer than the blinkstate probe time, so a link that lost a symbol is back by then.
+
+#define FLOOD_ABSENT_MS 400
+
+// Recently seen ids. This is a ring so the oldest gets overwritten.
+
+static byte seenIds[FLOOD_SEEN_CACHE_SIZE];
+static byte seenCount;             // How many entries in seenIds are valid (saturates at FLOOD_SEEN_CACHE_SIZE)
+static byte seenNext;              // Next slot to overwrite
+
+// Messages waiting to go out
+
+typedef struct {
+    byte faceMask;                 // Faces we still need to send on. 0=slot empty.
+    uint16_t queueTime;            // Low bits of millis() when we queued it
+    byte packet[FLOOD_PACKET_LEN];
+} floodqueue_t;
+
+static floodqueue_t queue[FLOOD_QUEUE_SIZE];
+static byte queueNext;             // Next slot to use (oldest if full)
+
+// Most recently received message
+
+static bool receivedFlag;
+static byte lastId;
+static byte lastValue;
+static byte lastHops;
+static byte lastFace;
+
+static bool isSeen( byte id ) {
+
+    for( byte i=0; i<seenCount; i++ ) {
+        if (seenIds[i]==id) {
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+static void markSeen( byte id ) {
+
+    seenIds[seenNext] = id;
+
+    seenNext++;
+    if (seenNext==FLOOD_SEEN_CACHE_SIZE) {
+        seenNext=0;
+    }
+
+    if (seenCount<FLOOD_SEEN_CACHE_SIZE) {
+        seenCount++;
+    }
+
+}
+
+// Queue a message to go out on all faces except `exclude`
+
+static void queueFlood( byte id , byte hopsLeft , byte hopsTaken , byte value , byte exclude ) {
+
+    byte faceMask = 0;
+
+    FOREACH_FACE(f) {
+        if ( f!=exclude ) {
+            faceMask |= 1 << f;
+        }
+    }
+
+    floodqueue_t *q = &queue[queueNext];
+
+    q->packet[0] = PACKET_TYPE_FLOOD;
+    q->packet[1] = id;
+    q->packet[2] = hopsLeft;
+    q->packet[3] = hopsTaken;
+    q->packet[4] = value;
+    q->queueTime = millis();
+    q->faceMask  = faceMask;
+
+    queueNext++;
+    if (queueNext==FLOOD_QUEUE_SIZE) {
+        queueNext=0;
+    }
+
+}
+
+// Called for every packet received by blinkstate
+
+static void floodOnPacket( byte face , const byte *data , byte len ) {
+
+    if ( data[0]!=PACKET_TYPE_FLOOD || len!=FLOOD_PACKET_LEN ) {
+        return;
+    }
+
+    byte id = data[1];
+
+    if (isSeen(id)) {
+        return;
+    }
+
+    markSeen(id);
+
+    byte hopsLeft  = data[2];
+    byte hopsTaken = data[3] + 1;
+
+    lastId    = id;
+    lastValue = data[4];
+    lastHops  = hopsTaken;
+    lastFace  = face;
+    receivedFlag = true;
+
+    if (hopsLeft > 1) {
+        queueFlood( id , hopsLeft-1 , hopsTaken , data[4] , face );
+    }
+
+}
+
+// Try to get any queued messages out
+
+static void floodOnLoop(void) {
+
+    uint16_t now = millis();
+
+    for( byte i=0; i<FLOOD_QUEUE_SIZE; i++ ) {
+
+        floodqueue_t *q = &queue[i];
+
+        if (q->faceMask) {
+
+            bool absentTooLong = (uint16_t) ( now - q->queueTime ) > FLOOD_ABSENT_MS;
+
+            FOREACH_FACE(f) {
+
+                byte bit = 1 << f;
+
+                if ( q->faceMask & bit ) {
+
+                    if ( isValueReceivedOnFaceExpired(f) ) {
+
+                        if (absentTooLong) {
+                            q->faceMask &= ~bit;    // Nobody there
+                        }
+
+                    } else if ( sendPacketOnFace( f , q->packet , FLOOD_PACKET_LEN ) ) {
+
+                        q->faceMask &= ~bit;        // Sent
+
+                    }
+
+                }
+
+            }
+
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct floodOnLoopChain = {
+     .callback = floodOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static packethandler_t floodOnPacketChain = {
+     .callback = floodOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any flood function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        addOnLoop( &floodOnLoopChain );
+        addOnPacket( &floodOnPacketChain );
+        hookRegisteredFlag=1;
+    }
+}
+
+// Start a new flood
+
+void floodBroadcast( byte id , byte hops , byte value ) {
+
+    registerHook();
+
+    markSeen( id );         // So we do not repeat it when it echoes back to us
+
+    if (hops) {
+        queueFlood( id , hops , 0 , value , FACE_COUNT );       // FACE_COUNT matches no face, so goes out everywhere
+    }
+
+}
+
+bool floodReceived(void) {
+
+    registerHook();
+
+    if (receivedFlag) {
+        receivedFlag=false;
+        return true;
+    }
+
+    return false;
+
+}
+
+byte floodGetId(void) {
+    return lastId;
+}
+
+byte floodGetValue(void) {
+    return lastValue;
+}
+
+byte floodGetHops(void) {
+    return lastHops;
+}
+
+byte floodGetFace(void) {
+    return lastFace;
+}
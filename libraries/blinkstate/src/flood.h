@@ -0,0 +1,68 @@
+/*
+ * flood.h
+ *
+ * Cluster-wide flood broadcast.
+ *
+ * A flood message starts on one tile and is passed along by every tile that receives it, so it
+ * quickly reaches every tile in the cluster. Each tile forwards a message only once (on every face
+ * except the one it arrived on), so it is safe to use in clusters with loops.
+ *
+ * Messages are identified by an 8-bit id. Tiles remember the last few ids they have seen and quietly drop
+ * repeats, so use a new id for each new message. Mixing in a byte of the serial number is an easy way
+ * to keep two tiles from picking the same id at the same time.
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so forwarding
+ * only happens when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ * That first call is also what starts this tile forwarding floods. A tile whose sketch never calls anything
+ * here does not even have the flood code linked in, so it drops flood packets and a flood can not cross it,
+ * even if it is running blinkstate for something else. For a flood to reach the whole cluster, every tile
+ * needs a sketch that calls into flood.h. A tile that only passes floods along can just call
+ * floodReceived() once in setup().
+ *
+ */
+
+#ifndef FLOOD_H_
+#define FLOOD_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before flood.h
+#endif
+
+// How many recently seen message ids we remember to suppress duplicates
+
+#define FLOOD_SEEN_CACHE_SIZE 8
+
+// How many messages we can be forwarding at the same time.
+// If more arrive while these are still going out, the oldest is dropped.
+
+#define FLOOD_QUEUE_SIZE 2
+
+// Start a new flood. `hops` is how many tiles away the message can travel (1=only our immediate neighbors).
+// `value` is carried along with the message and is 8 bits wide.
+
+void floodBroadcast( byte id , byte hops , byte value );
+
+// Did we receive a new flood message since the last time we checked?
+// The floodGet*() functions then return info about that message.
+
+bool floodReceived(void);
+
+// Id of the most recently received flood message
+
+byte floodGetId(void);
+
+// Value carried by the most recently received flood message
+
+byte floodGetValue(void);
+
+// How many hops the most recently received flood message took to get to us (1=sent by a neighbor)
+
+byte floodGetHops(void);
+
+// Face the most recently received flood message arrived on
+
+byte floodGetFace(void);
+
+#endif /* FLOOD_H_ */
@@ -0,0 +1,168 @@
+/*
+ * palette.cpp
+ *
+ * Send palette entries to neighbors.
+ *
+ * A palette packet looks like...
+ *
+ *    PACKET_TYPE_PALETTE , first index , color (2 bytes, LSB first) , color , color
+ *
+ * ...with up to 3 colors for the entries starting at the first index. The last packet of a palette is
+ * shorter since 16 does not divide by 3.
+ *
+ * For each face we remember the next entry to send, and keep sending one packet each pass though loop()
+ * until we get to the end or that neighbor goes away.
+ *
+ */
+
+#include <stddef.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "palette.h"
+
+#define PALETTE_ENTRIES_PER_PACKET 3
+
+#define PALETTE_PACKET_LEN(count) ( 2 + ( 2 * (count) ) )
+
+// Next entry to send on each face, plus 1. 0=nothing to send.
+
+static byte sendNext[FACE_COUNT];
+
+static bool changedFlag;
+
+// Called for every packet received by blinkstate
+
+static void paletteOnPacket( byte , const byte *data , byte len ) {     // Entries are the same whichever face they came in on
+
+    if ( data[0]!=PACKET_TYPE_PALETTE || len < PALETTE_PACKET_LEN(1) || ( len & 1 ) ) {
+        return;
+    }
+
+    byte index = data[1];
+
+    for( const byte *p = &data[2] ; p < data + len ; p+=2 ) {
+
+        if ( index >= PALETTE_SIZE ) {
+            break;
+        }
+
+        setPaletteColor( index , p[0] | ( p[1] << 8 ) );
+
+        index++;
+
+    }
+
+    changedFlag = true;
+
+}
+
+// Send the next packet on any face that has more to go
+
+static void paletteOnLoop(void) {
+
+    FOREACH_FACE(f) {
+
+        if (!sendNext[f]) {
+            continue;
+        }
+
+        if ( isValueReceivedOnFaceExpired(f) ) {
+
+            sendNext[f] = 0;            // Nobody there anymore
+            continue;
+
+        }
+
+        byte first = sendNext[f] - 1;
+
+        byte count = PALETTE_SIZE - first;
+
+        if ( count > PALETTE_ENTRIES_PER_PACKET ) {
+            count = PALETTE_ENTRIES_PER_PACKET;
+        }
+
+        byte packet[ PALETTE_PACKET_LEN( PALETTE_ENTRIES_PER_PACKET ) ];
+
+        packet[0] = PACKET_TYPE_PALETTE;
+        packet[1] = first;
+
+        for( byte i=0; i<count; i++ ) {
+
+            Color c = getPaletteColor( first + i );
+
+            packet[ 2 + (i*2)     ] = (byte) c;
+            packet[ 2 + (i*2) + 1 ] = (byte) ( c >> 8 );
+
+        }
+
+        if ( sendPacketOnFace( f , packet , PALETTE_PACKET_LEN( count ) ) ) {
+
+            sendNext[f] += count;
+
+            if ( sendNext[f] > PALETTE_SIZE ) {
+                sendNext[f] = 0;        // All sent
+            }
+
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct paletteOnLoopChain = {
+     .callback = paletteOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static packethandler_t paletteOnPacketChain = {
+     .callback = paletteOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any palette function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        addOnLoop( &paletteOnLoopChain );
+        addOnPacket( &paletteOnPacketChain );
+        hookRegisteredFlag=1;
+    }
+}
+
+void sendPaletteOnFace( byte face ) {
+
+    registerHook();
+
+    sendNext[face] = 1;
+
+}
+
+void sendPalette(void) {
+
+    FOREACH_FACE(f) {
+        sendPaletteOnFace( f );
+    }
+
+}
+
+bool didPaletteChange(void) {
+
+    registerHook();
+
+    if (changedFlag) {
+        changedFlag=false;
+        return true;
+    }
+
+    return false;
+
+}
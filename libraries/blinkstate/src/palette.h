@@ -0,0 +1,40 @@
+/*
+ * palette.h
+ *
+ * Share the palette (see setPaletteColor() in blinklib.h) with neighbors.
+ *
+ * Once both tiles have the same palette, a face color is just a 4 bit index, which fits in a single
+ * setValueSentOnFace() value. The palette itself goes over as a handful of packets, 3 entries per packet.
+ *
+ * A tile that receives palette entries puts them right into its own palette, so any of its faces showing those
+ * entries change color too. Nothing gets passed along, so each tile needs to be sent the palette by its neighbor.
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so sending
+ * and receiving only happen when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ */
+
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before palette.h
+#endif
+
+// Send our whole palette to the neighbor on `face`. Goes out over the next few passes though loop().
+// Starts over from the top if we were already sending on that face.
+
+void sendPaletteOnFace( byte face );
+
+// Send our whole palette to every neighbor
+
+void sendPalette(void);
+
+// Did we receive any palette entries from a neighbor since the last time we checked?
+// We only start listening once this (or one of the send functions) has been called, so call it in setup()
+// if you want to accept palettes from neighbors.
+
+bool didPaletteChange(void);
+
+#endif /* PALETTE_H_ */
@@ -0,0 +1,462 @@
+/*
+ * route.cpp
+ *
+ * Unicast routing over the discovery tree.
+ *
+ * We send two kinds of packets...
+ *
+ *    PACKET_TYPE_ROUTE , destId (2 bytes, LSB first) , sourceId (2 bytes, LSB first) , hopsTaken , value (2 bytes, LSB first)
+ *    PACKET_TYPE_ROUTE_ANNOUNCE , id (2 bytes, LSB first) , ...up to ROUTE_ANNOUNCE_MAX_IDS ids
+ *
+ * Announce packets only ever go up the tree to the face returned by getRootFace(). Every ROUTE_ANNOUNCE_PERIOD_MS
+ * each tile announces its own id, and when we get an announce from below we remember which face each id came in on
+ * and pass the ids on up. Ids are packed a few to a packet so that the tiles near the root are not swamped.
+ *
+ * When we get a route packet we also remember the face it came in on as the way back to the sender. Then...
+ *
+ *    (1) If it is for us, we post it for the sketch to read.
+ *    (2) If we know the way to the destination, we send it down that face.
+ *    (3) Otherwise we send it up towards the root, unless that is where it came from.
+ *    (4) If it came from above (or we are the root) and we do not know the way, the tile we want is somewhere below
+ *        us but got pushed out of our table. We send it to every neighbor that has announced to us, and they do
+ *        the same. The root sends it back down the face it came in on too, since the tiles it passed on the way
+ *        up might have lost track of a tile below them.
+ *
+ * The table doubles as the list of ids we still need to pass up, so there is no extra queue to overflow.
+ * Entries are forgotten if we do not hear about them for ROUTE_MAX_AGE periods. When the table is full the
+ * entry closest to being forgotten gets replaced, so in a big cluster the tiles near the root end up
+ * with whichever tiles they heard about most recently and fall back on (4) for the rest.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "route.h"
+#include "discovery.h"
+
+#define ROUTE_PACKET_LEN 8
+
+#define ROUTE_ANNOUNCE_MAX_IDS ( ( PACKET_MAX_LEN - 1 ) / 2 )
+
+// How long a face has to be empty before we give up on the neighbor that was there
+
+#define ROUTE_FORGET_MS     500
+
+#define ROUTE_FACE_MASK     0b00000111
+#define ROUTE_ANNOUNCE_BIT  0x80            // Set in the face byte of entries we still need to pass up the tree
+
+// One remembered way to a tile
+
+typedef struct {
+    uint16_t id;
+    byte face;                  // Face that leads to this tile, plus ROUTE_ANNOUNCE_BIT
+    byte life;                  // Announce periods left before we forget it. 0=entry unused.
+} routeentry_t;
+
+static routeentry_t table[ROUTE_TABLE_SIZE];
+
+static byte presentMask;                    // Faces that have a neighbor (or had one very recently)
+static uint16_t lastSeenTime[FACE_COUNT];   // Low bits of millis() when we last saw a neighbor on each face
+
+static byte childLife[FACE_COUNT];          // Announce periods left before we stop counting the neighbor on each face as below us
+
+static bool announceSelfFlag;               // Do we still need to tell the tile above us that we are here?
+static byte parentFace = FACE_COUNT;        // Face we last sent announces up. FACE_COUNT=we are the root.
+static uint32_t nextAnnounceTime;
+
+// Messages waiting to go out
+
+typedef struct {
+    byte faceMask;              // Faces we still need to send on. 0=slot empty.
+    byte packet[ROUTE_PACKET_LEN];
+} routequeue_t;
+
+static routequeue_t queue[ROUTE_QUEUE_SIZE];
+static byte queueNext;                      // Next slot to use (oldest if full)
+
+// Most recently received message
+
+static bool receivedFlag;
+static uint16_t lastSource;
+static uint16_t lastValue;
+static byte lastHops;
+
+static routeentry_t *findEntry( uint16_t id ) {
+
+    for( byte i=0; i<ROUTE_TABLE_SIZE; i++ ) {
+        if ( table[i].life && table[i].id==id ) {
+            return &table[i];
+        }
+    }
+
+    return NULL;
+
+}
+
+// Remember that `id` is through `face`
+
+static void learn( uint16_t id , byte face , bool announceFlag ) {
+
+    if ( id == getTileId() ) {
+        return;
+    }
+
+    routeentry_t *e = findEntry( id );
+
+    if (!e) {
+
+        // Take the entry closest to being forgotten. Unused ones have life 0 so they go first.
+
+        e = &table[0];
+
+        for( byte i=1; i<ROUTE_TABLE_SIZE; i++ ) {
+            if ( table[i].life < e->life ) {
+                e = &table[i];
+            }
+        }
+
+        e->id = id;
+
+    }
+
+    e->face = face | ( announceFlag ? ROUTE_ANNOUNCE_BIT : ( e->face & ROUTE_ANNOUNCE_BIT ) );
+    e->life = ROUTE_MAX_AGE;
+
+}
+
+// Which faces to send a message for `destId` out on, given that it came in on `fromFace`.
+// Returns 0 if there is nowhere to send it.
+
+static byte nextHopMask( uint16_t destId , byte fromFace ) {
+
+    routeentry_t *e = findEntry( destId );
+
+    if (e) {
+
+        byte f = e->face & ROUTE_FACE_MASK;
+
+        if ( !( presentMask & ( 1 << f ) ) ) {
+
+            e->life = 0;            // That tile (or the way to it) went away
+
+        } else if ( f != fromFace ) {
+
+            return 1 << f;
+
+        }
+
+    }
+
+    byte up = getRootFace();
+
+    if ( up != FACE_COUNT && up != fromFace ) {
+        return 1 << up;
+    }
+
+    // It should be somewhere below us, but we don't know where. Maybe it got pushed out of our
+    // table, so ask all the tiles below us and let them sort it out. If we are the root that includes
+    // the face it came up from, since the tiles on that side only sent it up because they did not know either.
+
+    byte mask = 0;
+
+    FOREACH_FACE(f) {
+        if ( childLife[f] && ( f != fromFace || up == FACE_COUNT ) ) {
+            mask |= 1 << f;
+        }
+    }
+
+    return mask;
+
+}
+
+// Queue a message to go out on all the faces in `faceMask`
+
+static void queueRoute( byte faceMask , uint16_t destId , uint16_t sourceId , byte hopsTaken , uint16_t value ) {
+
+    if ( !faceMask ) {
+        return;             // Nowhere to go
+    }
+
+    routequeue_t *q = &queue[queueNext];
+
+    q->packet[0] = PACKET_TYPE_ROUTE;
+    q->packet[1] = (byte) destId;
+    q->packet[2] = (byte) ( destId >> 8 );
+    q->packet[3] = (byte) sourceId;
+    q->packet[4] = (byte) ( sourceId >> 8 );
+    q->packet[5] = hopsTaken;
+    q->packet[6] = (byte) value;
+    q->packet[7] = (byte) ( value >> 8 );
+    q->faceMask  = faceMask;
+
+    queueNext++;
+    if (queueNext==ROUTE_QUEUE_SIZE) {
+        queueNext=0;
+    }
+
+}
+
+static void deliver( uint16_t sourceId , uint16_t value , byte hops ) {
+
+    lastSource   = sourceId;
+    lastValue    = value;
+    lastHops     = hops;
+    receivedFlag = true;
+
+}
+
+// Called for every packet received by blinkstate
+
+static void routeOnPacket( byte face , const byte *data , byte len ) {
+
+    if ( data[0]==PACKET_TYPE_ROUTE && len==ROUTE_PACKET_LEN ) {
+
+        uint16_t destId   = data[1] | ( data[2] << 8 );
+        uint16_t sourceId = data[3] | ( data[4] << 8 );
+        byte hopsTaken    = data[5] + 1;
+        uint16_t value    = data[6] | ( data[7] << 8 );
+
+        learn( sourceId , face , false );
+
+        if ( destId == getTileId() ) {
+
+            deliver( sourceId , value , hopsTaken );
+
+        } else if ( hopsTaken < ROUTE_MAX_HOPS ) {
+
+            queueRoute( nextHopMask( destId , face ) , destId , sourceId , hopsTaken , value );
+
+        }
+
+    } else if ( data[0]==PACKET_TYPE_ROUTE_ANNOUNCE && ( len & 1 ) ) {
+
+        childLife[face] = ROUTE_MAX_AGE;
+
+        for( byte i=1; i<len; i+=2 ) {
+            learn( data[i] | ( data[i+1] << 8 ) , face , true );
+        }
+
+    }
+
+}
+
+// Messages get their own hook that runs ahead of discovery and election (see registerHook()), since they are
+// what people are waiting on. Otherwise on a busy face the heartbeats and position updates would take every
+// free slot and a message could wait for seconds at each hop.
+
+static void routeSendOnLoop(void) {
+
+    uint32_t now = millis();
+
+    // A lost symbol can make a face look empty for a moment, so we wait a bit before giving up on a neighbor
+
+    FOREACH_FACE(f) {
+
+        if ( !isValueReceivedOnFaceExpired(f) ) {
+            lastSeenTime[f] = now;
+            presentMask |= 1<<f;
+        } else if ( (uint16_t) ( now - lastSeenTime[f] ) > ROUTE_FORGET_MS ) {
+            presentMask &= ~(1<<f);
+        }
+
+    }
+
+    for( byte i=0; i<ROUTE_QUEUE_SIZE; i++ ) {
+
+        routequeue_t *q = &queue[i];
+
+        if (q->faceMask) {
+
+            FOREACH_FACE(f) {
+
+                if ( q->faceMask & ( 1 << f ) ) {
+
+                    if ( !( presentMask & ( 1 << f ) ) || sendPacketOnFace( f , q->packet , ROUTE_PACKET_LEN ) ) {
+
+                        q->faceMask &= ~( 1 << f ); // Either sent or nobody there anymore
+
+                    }
+
+                }
+
+            }
+
+        }
+
+    }
+
+}
+
+// Everything else happens after the other services have had their turn
+
+static void routeOnLoop(void) {
+
+    uint32_t now = millis();
+
+    if ( (int32_t) ( now - nextAnnounceTime ) >= 0 ) {
+
+        for( byte i=0; i<ROUTE_TABLE_SIZE; i++ ) {
+            if ( table[i].life ) {
+                table[i].life--;
+            }
+        }
+
+        FOREACH_FACE(f) {
+            if ( childLife[f] ) {
+                childLife[f]--;
+            }
+        }
+
+        announceSelfFlag = true;
+        nextAnnounceTime = now + ROUTE_ANNOUNCE_PERIOD_MS;
+
+    }
+
+    byte up = getRootFace();
+
+    if ( up != parentFace ) {
+
+        // A new tile above us needs to hear about everyone below us right away
+
+        parentFace = up;
+        announceSelfFlag = true;
+
+        for( byte i=0; i<ROUTE_TABLE_SIZE; i++ ) {
+            table[i].face |= ROUTE_ANNOUNCE_BIT;
+        }
+
+    }
+
+    if ( up == FACE_COUNT || isPacketPendingOnFace( up ) ) {
+        return;
+    }
+
+    // Pack as many ids as fit into one announce
+
+    byte packet[ 1 + ( ROUTE_ANNOUNCE_MAX_IDS * 2 ) ] = { PACKET_TYPE_ROUTE_ANNOUNCE };
+    byte len = 1;
+
+    routeentry_t *sent[ROUTE_ANNOUNCE_MAX_IDS];
+    byte sentCount = 0;
+
+    if ( announceSelfFlag ) {
+
+        uint16_t id = getTileId();
+
+        packet[len++] = (byte) id;
+        packet[len++] = (byte) ( id >> 8 );
+
+    }
+
+    for( byte i=0; i<ROUTE_TABLE_SIZE && len < sizeof( packet ); i++ ) {
+
+        routeentry_t *e = &table[i];
+
+        if ( e->face & ROUTE_ANNOUNCE_BIT ) {
+
+            if ( e->life && ( e->face & ROUTE_FACE_MASK ) != up ) {
+
+                packet[len++] = (byte) e->id;
+                packet[len++] = (byte) ( e->id >> 8 );
+
+                sent[sentCount++] = e;
+
+            } else {
+
+                e->face &= ~ROUTE_ANNOUNCE_BIT;     // Forgotten, or it is above us so announcing it up would make a loop
+
+            }
+
+        }
+
+    }
+
+    if ( len > 1 && sendPacketOnFace( up , packet , len ) ) {
+
+        announceSelfFlag = false;
+
+        while (sentCount) {
+            sent[--sentCount]->face &= ~ROUTE_ANNOUNCE_BIT;
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct routeOnLoopChain = {
+     .callback = routeOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static struct chainfunction_struct routeSendOnLoopChain = {
+     .callback = routeSendOnLoop,
+     .next     = NULL
+};
+
+static packethandler_t routeOnPacketChain = {
+     .callback = routeOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any route function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        addOnLoop( &routeOnLoopChain );
+        addOnPacket( &routeOnPacketChain );
+        hookRegisteredFlag=1;
+        getRootFace();                      // Gets discovery going. Do this after we hook in so it runs first and the tree gets first dibs on the faces.
+        addOnLoop( &routeSendOnLoopChain ); // ...except for messages, which go ahead of everything
+    }
+}
+
+void routeSend( uint16_t destId , uint16_t value ) {
+
+    registerHook();
+
+    uint16_t ourId = getTileId();
+
+    if ( destId == ourId ) {
+        deliver( ourId , value , 0 );
+        return;
+    }
+
+    queueRoute( nextHopMask( destId , FACE_COUNT ) , destId , ourId , 0 , value );
+
+}
+
+bool routeReceived(void) {
+
+    registerHook();
+
+    if (receivedFlag) {
+        receivedFlag=false;
+        return true;
+    }
+
+    return false;
+
+}
+
+uint16_t routeGetSource(void) {
+    return lastSource;
+}
+
+uint16_t routeGetValue(void) {
+    return lastValue;
+}
+
+byte routeGetHops(void) {
+    return lastHops;
+}
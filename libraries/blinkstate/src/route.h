@@ -0,0 +1,75 @@
+/*
+ * route.h
+ *
+ * Send a message to one particular tile anywhere in the cluster.
+ *
+ * Messages are addressed by tile id (see getTileId()) and passed along from tile to tile until they get there.
+ * Use getNeighborIdOnFace() or a flood to find out the ids of other tiles in the first place.
+ *
+ * Routes follow the tree that discovery.h builds from the cluster root. Every tile tells the tile above it
+ * that it is there, and each tile passes these along up the tree, so every tile learns which face leads to each
+ * of the tiles below it. A message for a tile we know about goes down that face, and anything else goes up
+ * towards the root until it meets a tile that knows the way.
+ *
+ * RAM use is fixed. Each tile remembers the way to at most ROUTE_TABLE_SIZE tiles below it. In a cluster
+ * with more tiles than that, the tiles near the root will not know the way to some of them and have to send
+ * those messages to every tile below them instead, which is slower and uses up more of the IR links.
+ *
+ * Delivery is not guaranteed. A message can be lost to a garbled packet, a full queue, or a route that has
+ * not settled yet after tiles move around. Have the other side answer if you need to know that it got there.
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so forwarding
+ * only happens when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ */
+
+#ifndef ROUTE_H_
+#define ROUTE_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before route.h
+#endif
+
+// How many tiles below us we can remember the way to. Each entry takes 4 bytes.
+
+#define ROUTE_TABLE_SIZE        16
+
+// How many messages we can be forwarding at the same time.
+// If more arrive while these are still going out, the oldest is dropped.
+
+#define ROUTE_QUEUE_SIZE        4
+
+// How often each tile tells the tile above it that it is there.
+// We forget a tile if we do not hear about it for ROUTE_MAX_AGE of these.
+
+#define ROUTE_ANNOUNCE_PERIOD_MS 3000
+#define ROUTE_MAX_AGE           3
+
+// Messages that take more than this many steps are dropped. This stops a message from going
+// around in circles forever while the tree is changing.
+
+#define ROUTE_MAX_HOPS          32
+
+// Send `value` to the tile with id `destId`.
+
+void routeSend( uint16_t destId , uint16_t value );
+
+// Did we receive a new message since the last time we checked?
+// The routeGet*() functions then return info about that message.
+
+bool routeReceived(void);
+
+// Id of the tile that sent the most recently received message
+
+uint16_t routeGetSource(void);
+
+// Value carried by the most recently received message
+
+uint16_t routeGetValue(void);
+
+// How many steps the most recently received message took to get to us (1=sent by a neighbor)
+
+byte routeGetHops(void);
+
+#endif /* ROUTE_H_ */
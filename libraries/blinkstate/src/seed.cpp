@@ -0,0 +1,801 @@
+/*
+ * seed.cpp
+ *
+ * Pipelined image transfer between neighbors.
+ *
+ * We send two kinds of packets on each face...
+ *
+ *    PACKET_TYPE_SEED_STATUS , imageCrc (2 bytes, LSB first) , blockCount (2 bytes) , have (2 bytes) , ( generation << 2 ) | flags
+ *    PACKET_TYPE_SEED_DATA , ( block << 2 ) | chunk , 6 bytes
+ *
+ * The status packet says which image we are carrying and that we have its first `have` blocks. The flags are set
+ * per face. SEED_SOURCE_FLAG asks that neighbor to send us blocks, and SEED_RESEND_FLAG tells it to go back and start
+ * again from `have` because something went missing.
+ *
+ * The generation goes up by one with each seedStart(), so a tile that hears about a different image with a newer
+ * generation than its own drops what it has and picks that one up. It is only 6 bits, so "newer" means up to half way
+ * around. Two images with the same generation (two tiles started at once) never replace each other, so each tile
+ * just keeps whichever one it heard about first.
+ *
+ * Each block is followed by its CRC (LSB first) and the whole thing is cut into SEED_CHUNKS data packets. Only the
+ * low 6 bits of the block number fit in a data packet, but we never send a neighbor a block far enough from the one
+ * it is waiting for to mix them up. The block CRC covers the whole block number to be sure.
+ *
+ * Every pass through loop() each tile picks the neighbor furthest ahead on the same image as its source, and sends
+ * the next few blocks to every neighbor that picked it. As soon as we have a block we can pass it on, so the image
+ * flows through the cluster like a pipeline.
+ *
+ * We only keep the last SEED_WINDOW blocks, so we stop taking new blocks while a neighbor is so far behind that
+ * taking one would push out a block it still needs. The tile furthest behind never waits on anyone, so
+ * this can not lock up.
+ *
+ * With SEED_FLASH each block also goes into the staging area as it comes in (see seedflash.cpp). Once the image is
+ * complete and the staged copy checks out, we keep passing it along until our neighbors have it and then install it.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "seed.h"
+
+#if SEED_FLASH
+    #include "seedflash.h"
+#endif
+
+#define STATUS_PACKET_LEN   8
+#define DATA_HEADER_LEN     2
+
+#define SEED_CHUNK_SIZE     ( PACKET_MAX_LEN - DATA_HEADER_LEN )                    // Bytes of block per data packet
+#define SEED_CHUNKS         ( ( SEED_BLOCK_SIZE + 2 + SEED_CHUNK_SIZE - 1 ) / SEED_CHUNK_SIZE )
+#define ALL_CHUNKS_MASK     ( ( 1 << SEED_CHUNKS ) - 1 )
+
+#define BLOCK_TAG_MASK      0x3f                // Low bits of the block number that go in a data packet
+
+#if SEED_CHUNKS > 4
+    #error SEED_BLOCK_SIZE is too big to send in 4 chunks
+#endif
+
+#define SEED_SOURCE_FLAG    0x01
+#define SEED_RESEND_FLAG    0x02
+#define SEED_FLAGS_MASK     0x03
+
+#define GENERATION_SHIFT    2                   // The generation goes in the top bits of the flags byte
+#define GENERATION_MASK     0x3f
+
+#define CRC_INIT            0xffff
+
+// How long a face has to be empty before we forget the neighbor that was there
+
+#define SEED_FORGET_MS      500
+
+#define ALL_FACES_MASK      (0b00111111)        // One bit per face
+
+// The image we are carrying. blockCount=0 means none.
+
+static uint16_t imageCrc;
+static uint16_t blockCount;
+static byte generation;                         // Newest image wins (see above)
+static uint16_t have;                           // We have blocks 0 to have-1
+static uint16_t haveCrc;                        // CRC over those blocks so far
+
+static bool originFlag;                         // We started the seed, so every block comes right out of our flash
+static uint16_t originLength;
+
+// The last SEED_WINDOW blocks we got, indexed by block % SEED_WINDOW
+
+static byte window[SEED_WINDOW][SEED_BLOCK_SIZE];
+
+// The block we are putting together from chunks (block data followed by its CRC)
+
+static byte assembly[SEED_BLOCK_SIZE+2];
+static uint16_t assemblyBlock;
+static byte assemblyMask;                       // Chunks we have so far
+
+// What we know about the neighbor on each face
+
+typedef struct {
+    uint16_t have;                  // From their latest status
+    byte flags;                     // From their latest status
+    uint16_t nextBlock;             // Next block we will send them
+    byte nextChunk;
+    uint16_t lastActivityTime;      // Low bits of millis() when we last sent them a chunk or they got a new block
+} seedface_t;
+
+static seedface_t neighbors[FACE_COUNT];
+
+static byte knownMask;                      // Faces where we have gotten a status for our image since the neighbor showed up
+static byte presentMask;                    // Faces that have a neighbor (or had one very recently)
+static uint16_t lastSeenTime[FACE_COUNT];   // Low bits of millis() when we last saw a neighbor on each face
+
+static byte sourceFace = FACE_COUNT;        // Neighbor we are getting blocks from. FACE_COUNT=none.
+static bool acceptingFlag;                  // Were we taking new blocks last time we looked?
+
+// What we still need to send
+
+static byte sendStatusMask;
+static byte resendMask;                     // Faces we need to ask to start again from `have`
+static uint32_t nextStatusTime;
+
+static uint32_t lastMoveTime;               // When we last got or sent part of a block (or heard about a new image)
+
+#if SEED_FLASH
+
+static bool installFlag;                    // We have a complete image in the staging area waiting to be installed
+static uint32_t installTime;                // When it got there
+
+#endif
+
+// How many bytes of the block (and its CRC) go in each chunk. The last chunk is short.
+
+static byte chunkLen( byte chunk ) {
+
+    byte start = chunk * SEED_CHUNK_SIZE;
+
+    return ( SEED_BLOCK_SIZE + 2 - start ) < SEED_CHUNK_SIZE ? ( SEED_BLOCK_SIZE + 2 - start ) : SEED_CHUNK_SIZE;
+
+}
+
+static uint16_t blockCrc( uint16_t block , const byte *data ) {
+
+    uint16_t crc = _crc_ccitt_update( CRC_INIT , (byte) block );
+    crc = _crc_ccitt_update( crc , (byte) ( block >> 8 ) );
+
+    for( byte i=0; i<SEED_BLOCK_SIZE; i++ ) {
+        crc = _crc_ccitt_update( crc , data[i] );
+    }
+
+    return crc;
+
+}
+
+static uint16_t imageCrcUpdate( uint16_t crc , const byte *data ) {
+
+    for( byte i=0; i<SEED_BLOCK_SIZE; i++ ) {
+        crc = _crc_ccitt_update( crc , data[i] );
+    }
+
+    return crc;
+
+}
+
+// Fill `data` with a block we have. The end of the last block is padded with 0xff like erased flash.
+
+static void readBlock( uint16_t block , byte *data ) {
+
+    if (originFlag) {
+
+        uint16_t address = block * SEED_BLOCK_SIZE;
+
+        for( byte i=0; i<SEED_BLOCK_SIZE; i++ , address++ ) {
+            data[i] = address < originLength ? pgm_read_byte( (const byte *) address ) : 0xff;
+        }
+
+    } else {
+
+        memcpy( data , window[ block % SEED_WINDOW ] , SEED_BLOCK_SIZE );
+
+    }
+
+}
+
+// Can we still hand out this block?
+
+static bool isBlockAvailable( uint16_t block ) {
+
+    return block < have && ( originFlag || block + SEED_WINDOW >= have );
+
+}
+
+// We can take a new block unless it would push a block out of the window that a neighbor still needs from us.
+// Neighbors that are already further behind than the window can't get anything from us anyway, so they don't count.
+
+static bool isAccepting(void) {
+
+    if ( originFlag || have >= blockCount ) {
+        return false;
+    }
+
+    FOREACH_FACE(f) {
+
+        if ( knownMask & (1<<f) ) {
+
+            uint16_t theirHave = neighbors[f].have;
+
+            if ( theirHave < have && theirHave + SEED_WINDOW == have ) {
+                return false;
+            }
+
+        }
+
+    }
+
+    return true;
+
+}
+
+#if SEED_FLASH
+
+// CRC over `length` bytes of our flash starting at `address`, figured the same way as the image CRC
+
+static uint16_t flashCrc( uint16_t address , uint16_t length ) {
+
+    uint16_t crc = CRC_INIT;
+
+    while ( length-- ) {
+        crc = _crc_ccitt_update( crc , pgm_read_byte( (const byte *) address++ ) );
+    }
+
+    return crc;
+
+}
+
+#endif
+
+// Is `theirGeneration` newer than ours?
+
+static bool isNewerGeneration( byte theirGeneration ) {
+
+    byte ahead = ( theirGeneration - generation ) & GENERATION_MASK;
+
+    return ahead && ahead <= GENERATION_MASK / 2;
+
+}
+
+// Forget our image and get ready for a new one
+
+static void startImage( uint16_t crc , uint16_t blocks ) {
+
+    imageCrc       = crc;
+    blockCount     = blocks;
+    have           = 0;
+    haveCrc        = CRC_INIT;
+    assemblyMask   = 0;
+    knownMask      = 0;
+    sourceFace     = FACE_COUNT;
+    sendStatusMask = ALL_FACES_MASK;
+    lastMoveTime   = millis();
+
+    FOREACH_FACE(f) {
+        neighbors[f].nextBlock = 0;             // Anything we were sending was for the old image
+        neighbors[f].nextChunk = 0;
+    }
+
+    #if SEED_FLASH
+        installFlag = false;
+    #endif
+
+}
+
+// Called when a full block has come together in `assembly`
+
+static void onBlockAssembled( byte face ) {
+
+    if ( blockCrc( have , assembly ) != ( assembly[SEED_BLOCK_SIZE] | ( assembly[SEED_BLOCK_SIZE+1] << 8 ) ) ) {
+
+        resendMask     |= 1<<face;
+        sendStatusMask |= 1<<face;
+        return;
+
+    }
+
+    if ( !isAccepting() ) {
+        resendMask |= 1<<face;          // No room. We will ask for it again once the neighbor behind us catches up.
+        return;
+    }
+
+    memcpy( window[ have % SEED_WINDOW ] , assembly , SEED_BLOCK_SIZE );
+
+    haveCrc = imageCrcUpdate( haveCrc , assembly );
+
+    #if SEED_FLASH
+        seedFlashBlock( have * SEED_BLOCK_SIZE , assembly );
+    #endif
+
+    if ( seed_callback_onBlock ) {
+        seed_callback_onBlock( have * SEED_BLOCK_SIZE , assembly );
+    }
+
+    have++;
+
+    lastMoveTime = millis();
+
+    // Tell everyone so the neighbors behind us can start pulling and the ones ahead of us know we moved up. Neighbors
+    // already pulling from us see that from the blocks we send them, so we save the link for the blocks.
+
+    FOREACH_FACE(f) {
+
+        if ( !( (knownMask & (1<<f)) && (neighbors[f].flags & SEED_SOURCE_FLAG) ) ) {
+            sendStatusMask |= 1<<f;
+        }
+
+    }
+
+    if ( have == blockCount ) {
+
+        if ( haveCrc == imageCrc ) {
+
+            #if SEED_FLASH
+
+                // Check what actually landed in flash before we trust it
+
+                uint16_t length = blockCount * SEED_BLOCK_SIZE;
+
+                if ( seedFlashFinish( length ) && flashCrc( SEED_FLASH_STAGING , length ) == imageCrc ) {
+                    installFlag = true;
+                    installTime = millis();
+                }
+
+            #endif
+
+            if ( seed_callback_onComplete ) {
+                seed_callback_onComplete( blockCount * SEED_BLOCK_SIZE );
+            }
+
+        } else {
+
+            startImage( imageCrc , blockCount );        // Something got past the block CRCs, so start over
+
+        }
+
+    }
+
+}
+
+// Called for every packet received by blinkstate
+
+static void seedOnPacket( byte face , const byte *data , byte len ) {
+
+    byte bit = 1<<face;
+
+    if ( data[0]==PACKET_TYPE_SEED_STATUS && len==STATUS_PACKET_LEN ) {
+
+        uint16_t crc       = data[1] | ( data[2] << 8 );
+        uint16_t blocks    = data[3] | ( data[4] << 8 );
+        uint16_t theirHave = data[5] | ( data[6] << 8 );
+        byte theirGeneration = data[7] >> GENERATION_SHIFT;
+
+        if ( crc == imageCrc && blocks == blockCount ) {
+
+            // Same image seeded again. Nothing to fetch, we just pass the newer generation along.
+
+            if ( isNewerGeneration( theirGeneration ) ) {
+                generation     = theirGeneration;
+                sendStatusMask = ALL_FACES_MASK;
+            } else if ( theirGeneration != generation ) {
+                sendStatusMask |= bit;
+            }
+
+        } else {
+
+            if ( blocks == 0 || ( blockCount && !isNewerGeneration( theirGeneration ) ) ) {
+
+                // Someone else's image that is not newer than ours. We stick with the one we have, and if theirs
+                // is older we let them know about ours right away.
+
+                if ( blocks && theirGeneration != generation ) {
+                    sendStatusMask |= bit;
+                }
+
+                knownMask &= ~bit;
+                return;
+
+            }
+
+            // First image we have seen, or a newer one than we have, so pick it up. Whatever we had (even one
+            // we started ourselves) is dropped.
+
+            originFlag = false;
+
+            startImage( crc , blocks );
+
+            generation = theirGeneration;
+
+            #if SEED_FLASH
+
+                // If we are already running it, we can hand it out right from our own flash like the tile that started it
+
+                if ( (uint32_t) blocks * SEED_BLOCK_SIZE <= SEED_FLASH_BOOT && flashCrc( 0 , blocks * SEED_BLOCK_SIZE ) == crc ) {
+
+                    originFlag   = true;
+                    originLength = blocks * SEED_BLOCK_SIZE;
+
+                    have    = blocks;
+                    haveCrc = crc;
+
+                }
+
+            #endif
+
+        }
+
+        seedface_t *n = &neighbors[face];
+
+        if ( !(knownMask & bit) || theirHave != n->have ) {
+            n->lastActivityTime = millis();
+        }
+
+        n->have  = theirHave;
+        n->flags = data[7] & SEED_FLAGS_MASK;
+
+        if ( ( n->flags & SEED_RESEND_FLAG ) || theirHave > n->nextBlock ) {
+            n->nextBlock = theirHave;
+            n->nextChunk = 0;
+        }
+
+        knownMask |= bit;
+
+    } else if ( data[0]==PACKET_TYPE_SEED_DATA && len > DATA_HEADER_LEN ) {
+
+        if ( originFlag || have >= blockCount ) {
+            return;
+        }
+
+        byte chunk = data[1] & 0x03;
+        byte start = chunk * SEED_CHUNK_SIZE;
+
+        // How far past the block we are waiting for is this one? Anything in the top half is really from before it.
+
+        byte ahead = ( ( data[1] >> 2 ) - have ) & BLOCK_TAG_MASK;
+
+        if ( ahead > BLOCK_TAG_MASK / 2 ) {
+            return;                                     // Old news, probably a resend that crossed with our status
+        }
+
+        // Anyone sending us a block must have it
+
+        if ( (knownMask & bit) && neighbors[face].have < have + ahead + 1 ) {
+            neighbors[face].have = have + ahead + 1;
+        }
+
+        if ( ahead ) {
+            resendMask     |= bit;                      // We missed something
+            sendStatusMask |= bit;
+            return;
+        }
+
+        uint16_t block = have;
+
+        if ( chunk >= SEED_CHUNKS || len - DATA_HEADER_LEN != chunkLen( chunk ) ) {
+            return;
+        }
+
+        if ( block != assemblyBlock ) {
+            assemblyBlock = block;
+            assemblyMask  = 0;
+        }
+
+        memcpy( assembly + start , data + DATA_HEADER_LEN , len - DATA_HEADER_LEN );
+
+        assemblyMask |= 1<<chunk;
+
+        if ( assemblyMask == ALL_CHUNKS_MASK ) {
+            assemblyMask = 0;
+            onBlockAssembled( face );
+        }
+
+    }
+
+}
+
+// Pick the neighbor furthest ahead of us on our image. We stick with the one we have as long as it is still ahead.
+
+static void updateSource(void) {
+
+    byte bestFace = FACE_COUNT;
+    uint16_t bestHave = have;
+
+    if ( sourceFace != FACE_COUNT && (knownMask & (1<<sourceFace)) && neighbors[sourceFace].have > have ) {
+
+        bestFace = sourceFace;
+
+    } else if ( !originFlag ) {
+
+        FOREACH_FACE(f) {
+
+            if ( (knownMask & (1<<f)) && neighbors[f].have > bestHave ) {
+
+                bestHave = neighbors[f].have;
+                bestFace = f;
+
+            }
+
+        }
+
+    }
+
+    bool accepting = isAccepting();
+
+    if ( bestFace != sourceFace ) {
+
+        if ( sourceFace != FACE_COUNT ) {
+            sendStatusMask |= 1<<sourceFace;            // Tell the old one to stop
+        }
+
+        if ( bestFace != FACE_COUNT ) {
+            sendStatusMask |= 1<<bestFace;
+        }
+
+        sourceFace = bestFace;
+
+    } else if ( accepting != acceptingFlag && sourceFace != FACE_COUNT ) {
+
+        sendStatusMask |= 1<<sourceFace;            // Start or stop the flow
+
+    }
+
+    acceptingFlag = accepting;
+
+}
+
+static void seedOnLoop(void) {
+
+    uint32_t now = millis();
+
+    // Forget anyone who left.
+    // A lost symbol can make a face look empty for a moment, so we wait a bit before forgetting a neighbor.
+
+    FOREACH_FACE(f) {
+
+        byte bit = 1<<f;
+
+        if ( !isValueReceivedOnFaceExpired(f) ) {
+
+            lastSeenTime[f] = now;
+
+            if ( !(presentMask & bit) ) {
+
+                presentMask    |= bit;
+                sendStatusMask |= bit;
+
+            }
+
+        } else if ( (uint16_t) ( now - lastSeenTime[f] ) > SEED_FORGET_MS ) {
+
+            presentMask &= ~bit;
+            knownMask   &= ~bit;
+
+            neighbors[f].nextBlock = 0;
+            neighbors[f].nextChunk = 0;
+
+        }
+
+    }
+
+    if ( !blockCount ) {
+        return;                                     // Nothing to send until we hear about an image
+    }
+
+    // A seed can take longer than the sleep timeout, and a tile that sleeps drops out of it
+
+    bool awakeFlag = now - lastMoveTime < SEED_AWAKE_MS;
+
+    #if SEED_FLASH
+        awakeFlag = awakeFlag || installFlag;
+    #endif
+
+    if ( awakeFlag ) {
+        postponeSleep();
+    }
+
+    #if SEED_FLASH
+
+        // Install once every neighbor we can see has the whole image, since we stop passing it along when we restart
+
+        if ( installFlag ) {
+
+            bool waitingFlag = false;
+
+            FOREACH_FACE(f) {
+
+                if ( (presentMask & (1<<f)) && !( (knownMask & (1<<f)) && neighbors[f].have >= blockCount ) ) {
+                    waitingFlag = true;
+                }
+
+            }
+
+            if ( !waitingFlag || now - installTime > SEED_INSTALL_TIMEOUT_MS ) {
+                seedFlashInstall( blockCount * SEED_BLOCK_SIZE );
+            }
+
+        }
+
+    #endif
+
+    updateSource();
+
+    if ( (int32_t) ( now - nextStatusTime ) >= 0 ) {
+        sendStatusMask = ALL_FACES_MASK;
+        nextStatusTime = now + SEED_STATUS_PERIOD_MS;
+    }
+
+    sendStatusMask &= presentMask;
+    resendMask     &= presentMask;
+
+    // Only one packet can be in flight per face, so status goes first and blocks wait their turn
+
+    FOREACH_FACE(f) {
+
+        byte bit = 1<<f;
+
+        seedface_t *n = &neighbors[f];
+
+        if ( sendStatusMask & bit ) {
+
+            byte flags = generation << GENERATION_SHIFT;
+
+            if ( f == sourceFace && acceptingFlag ) {
+                flags |= SEED_SOURCE_FLAG;
+            }
+
+            if ( resendMask & bit ) {
+                flags |= SEED_RESEND_FLAG;
+            }
+
+            byte packet[STATUS_PACKET_LEN] = {
+                PACKET_TYPE_SEED_STATUS ,
+                (byte) imageCrc , (byte) ( imageCrc >> 8 ) ,
+                (byte) blockCount , (byte) ( blockCount >> 8 ) ,
+                (byte) have , (byte) ( have >> 8 ) ,
+                flags
+            };
+
+            if ( sendPacketOnFace( f , packet , STATUS_PACKET_LEN ) ) {
+                sendStatusMask &= ~bit;
+                resendMask     &= ~bit;
+            }
+
+        } else if ( (knownMask & bit) && (n->flags & SEED_SOURCE_FLAG) ) {
+
+            // If we are waiting on them and have not heard anything in a while then something must have been lost
+
+            if ( n->nextBlock > n->have && (uint16_t) ( now - n->lastActivityTime ) > SEED_RESEND_MS ) {
+
+                n->nextBlock        = n->have;
+                n->nextChunk        = 0;
+                n->lastActivityTime = now;
+
+            }
+
+            if ( n->nextBlock < n->have + SEED_PIPELINE && isBlockAvailable( n->nextBlock ) ) {
+
+                byte block[SEED_BLOCK_SIZE+2];
+
+                readBlock( n->nextBlock , block );
+
+                uint16_t crc = blockCrc( n->nextBlock , block );
+
+                block[SEED_BLOCK_SIZE]   = (byte) crc;
+                block[SEED_BLOCK_SIZE+1] = (byte) ( crc >> 8 );
+
+                byte start = n->nextChunk * SEED_CHUNK_SIZE;
+                byte len   = chunkLen( n->nextChunk );
+
+                byte packet[PACKET_MAX_LEN] = { PACKET_TYPE_SEED_DATA , (byte) ( ( n->nextBlock << 2 ) | n->nextChunk ) };
+
+                memcpy( packet + DATA_HEADER_LEN , block + start , len );
+
+                if ( sendPacketOnFace( f , packet , DATA_HEADER_LEN + len ) ) {
+
+                    n->nextChunk++;
+                    n->lastActivityTime = now;
+                    lastMoveTime = now;
+
+                    if ( n->nextChunk == SEED_CHUNKS ) {
+                        n->nextChunk = 0;
+                        n->nextBlock++;
+                    }
+
+                }
+
+            }
+
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct seedOnLoopChain = {
+     .callback = seedOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static packethandler_t seedOnPacketChain = {
+     .callback = seedOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any seed function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        addOnLoop( &seedOnLoopChain );
+        addOnPacket( &seedOnPacketChain );
+        hookRegisteredFlag=1;
+    }
+}
+
+void seedStart( uint16_t length ) {
+
+    registerHook();
+
+    uint16_t blocks = ( length + SEED_BLOCK_SIZE - 1 ) / SEED_BLOCK_SIZE;
+
+    if ( blocks == 0 ) {
+        return;
+    }
+
+    originFlag   = true;
+    originLength = length;
+
+    uint16_t crc = CRC_INIT;
+
+    generation = ( generation + 1 ) & GENERATION_MASK;
+
+    for( uint16_t b=0; b<blocks; b++ ) {
+
+        byte block[SEED_BLOCK_SIZE];
+
+        readBlock( b , block );
+
+        crc = imageCrcUpdate( crc , block );
+
+    }
+
+    startImage( crc , blocks );
+
+    have    = blocks;
+    haveCrc = crc;
+
+}
+
+bool isSeeding(void) {
+
+    registerHook();
+
+    return have < blockCount;
+
+}
+
+bool isSeedComplete(void) {
+
+    registerHook();
+
+    return blockCount && have == blockCount;
+
+}
+
+#if SEED_FLASH
+
+bool isSeedInstallPending(void) {
+
+    registerHook();
+
+    return installFlag;
+
+}
+
+#endif
+
+uint16_t getSeedBytesReceived(void) {
+
+    registerHook();
+
+    return have * SEED_BLOCK_SIZE;
+
+}
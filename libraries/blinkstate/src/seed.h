@@ -0,0 +1,148 @@
+/*
+ * seed.h
+ *
+ * Pass a program image from tile to tile across the whole cluster ("seeding").
+ *
+ * One tile calls seedStart() to offer the first `length` bytes of its own flash. Every neighbor that is
+ * listening picks up the image and starts passing it along to its own neighbors as soon as the first blocks
+ * arrive, so the image streams across the cluster rather than going one whole tile at a time.
+ *
+ * The image travels in SEED_BLOCK_SIZE byte blocks, each with its own CRC. Bad blocks are sent again. When the
+ * last block arrives we check a CRC over the whole image before calling seed_callback_onComplete().
+ *
+ * A tile only listens for seeds after the first call to any of the seed functions, so call isSeeding() in setup()
+ * on tiles that should pick up an image.
+ *
+ * By default nothing here writes to flash, so the image just passes through the cluster and the seed_callback_*()
+ * hooks below are the only place it shows up. Turn on SEED_FLASH (below) to have each tile install the image.
+ *
+ * RAM use is fixed. Tiles only keep the last SEED_WINDOW blocks around to pass along, so a tile that runs too far
+ * ahead of a neighbor waits for it to catch up. A tile that shows up after its neighbors have moved on will not get
+ * that image, but it will get the next one.
+ *
+ * Each seedStart() gets a generation one past the newest one the starting tile has heard of, and a tile drops the
+ * image it has (whether it is finished, half way through, or stuck) as soon as it hears about one with a newer
+ * generation. So seeding a new image replaces the old one across the cluster. A tile only learns the current
+ * generation from its neighbors' status, which they repeat every SEED_STATUS_PERIOD_MS, so a tile that just woke up
+ * or restarted should wait that long before calling seedStart(). Otherwise its image can lose to the old one.
+ *
+ * Seeding is slow. In the cluster simulator (extras/sim, seed_bench) an image crosses one link at about 17 bytes a
+ * second, and about half that when a tile is passing it to several neighbors at once, which is the usual case in a
+ * packed cluster. Each extra hop only adds a few seconds after that. So a full size image (SEED_FLASH_MAX_LENGTH)
+ * takes about 7.5 minutes to get from one tile to its neighbor, and about 20 minutes to get across a 19 tile
+ * hexagon. That is longer than the 10 minutes tiles normally stay awake without a button press, so a tile keeps
+ * postponing sleep while blocks are moving to or from it and while it has an install pending (see SEED_AWAKE_MS).
+ * A tile that is already asleep does not wake up for a seed, so wake every tile before seedStart().
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so blocks
+ * only move when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ */
+
+#ifndef SEED_H_
+#define SEED_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before seed.h
+#endif
+
+// Bytes per block. Must divide the flash page size so pages are always filled by whole blocks.
+
+#define SEED_BLOCK_SIZE         16
+
+// How many blocks each tile keeps to pass along to neighbors that are behind it. Each takes SEED_BLOCK_SIZE bytes of RAM.
+
+#define SEED_WINDOW             4
+
+// How many blocks we send a neighbor before we hear that the first one got there.
+// More keeps the link busier but wastes more time when a block is lost.
+
+#define SEED_PIPELINE           2
+
+// How often we repeat our progress to the neighbors in case a status packet is lost
+
+#define SEED_STATUS_PERIOD_MS   5000
+
+// If this long goes by after the last chunk we sent a neighbor without it getting a new block, we go back and
+// resend from the last block it has
+
+#define SEED_RESEND_MS          2000
+
+// We keep the tile awake as long as we got or sent a block in the last SEED_AWAKE_MS. Once the seed is done (or
+// stuck, say because our source left) nothing moves, so the tile goes back to sleeping 10 minutes after its last
+// button press or this long after the last block, whichever is later.
+
+#define SEED_AWAKE_MS           60000
+
+// Set SEED_FLASH to 1 (in build.extra_flags) to have every tile that gets a complete image install it and restart
+// into it. Blocks are staged in the top half of the application flash as they arrive, so the program that is passing
+// the image along keeps running. That means...
+//
+//   - The sketch doing the passing must end below SEED_FLASH_STAGING, and an image can be at most
+//     SEED_FLASH_MAX_LENGTH bytes. Otherwise the image still passes through, it just does not get installed.
+//   - The flash writer sits in the boot section at SEED_FLASH_BOOT, so the extended fuse must have BOOTSZ set
+//     to a boot section of at least 256 words (the factory setting of 1024 words is fine) and BOOTRST unprogrammed.
+//     It gets programmed along with the sketch the first time, and a seeded image never replaces it. So images call
+//     it through a jump table that is the same in every build, and a tile only stages an image if the table's
+//     version matches SEED_FLASH_BOOT_VERSION. A tile with some other writer (or none) just passes images along.
+//   - A tile waits to install until every neighbor it can see has the whole image (or SEED_INSTALL_TIMEOUT_MS goes
+//     by), since it stops passing blocks along once it restarts.
+//   - A tile that is already running the image (checked by CRC against its own flash) just offers it to its
+//     neighbors, so tiles do not keep installing the same image over and over.
+//   - The copy takes about half a second. If the power goes out during it, the tile needs to be programmed again.
+//
+// Flashing is off by default since it takes the top half of the flash away from the sketch.
+
+#ifndef SEED_FLASH
+    #define SEED_FLASH 0
+#endif
+
+#define SEED_FLASH_STAGING      0x1f00                                  // Where images get staged while they arrive
+#define SEED_FLASH_BOOT         0x3e00                                  // Flash writer jump table (see platform.txt)
+#define SEED_FLASH_BOOT_CODE    0x3e10                                  // Flash writer code, just past the table
+#define SEED_FLASH_BOOT_VERSION 0x5301                                  // First word of the jump table
+#define SEED_FLASH_MAX_LENGTH   ( SEED_FLASH_BOOT - SEED_FLASH_STAGING )  // Biggest image we can install
+
+#define SEED_INSTALL_TIMEOUT_MS 60000
+
+#if SEED_FLASH
+
+// How many bytes of flash our own program takes. Pass this to seedStart() to send our own sketch.
+
+uint16_t getSeedImageLength(void);
+
+// Returns true once we have a complete image that we will install as soon as our neighbors have it too
+
+bool isSeedInstallPending(void);
+
+#endif
+
+// Start offering the first `length` bytes of our own flash to the cluster. This replaces any image we already have.
+
+void seedStart( uint16_t length );
+
+// Returns true while we are in the middle of receiving an image
+
+bool isSeeding(void);
+
+// Returns true if we have a complete, checked image (or we started the seed)
+
+bool isSeedComplete(void);
+
+// How many bytes of the image we have received so far (counting the padding at the end of the last block)
+
+uint16_t getSeedBytesReceived(void);
+
+// Called with each good block as it arrives, in order. `offset` is where in the image the block goes.
+// Blocks from an image that later fails the whole image CRC have already been passed in, so only switch
+// over to the new image after seed_callback_onComplete().
+
+void seed_callback_onBlock( uint16_t offset , const byte *data ) __attribute__((weak));
+
+// Called once the whole image has arrived and checked out. `length` is rounded up to a full block.
+// With SEED_FLASH the image gets installed some time after this returns.
+
+void seed_callback_onComplete( uint16_t length ) __attribute__((weak));
+
+#endif /* SEED_H_ */
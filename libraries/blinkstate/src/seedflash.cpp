@@ -0,0 +1,249 @@
+/*
+ * seedflash.cpp
+ *
+ * The flash writer behind SEED_FLASH.
+ *
+ * On this chip the SPM instruction only works when it runs from the boot section, so the few functions that actually
+ * touch flash go in the .bootcode section, which the linker puts at SEED_FLASH_BOOT_CODE, just past a jump table (see
+ * platform.txt). They only use inline code (the avr/boot.h macros and pgm_read_word), so nothing in them calls back
+ * into the application flash that they might be writing over.
+ *
+ * The boot section gets programmed once along with the first sketch, and a seeded image never replaces it. So an
+ * installed image is calling the boot code from some other build, and where each function landed in that build
+ * depends on the compiler, the flags, and this file. The application never calls them directly. It calls through the
+ * jump table in the .bootloader section, which is always at SEED_FLASH_BOOT and always has the same layout...
+ *
+ *     SEED_FLASH_BOOT+0   SEED_FLASH_BOOT_VERSION
+ *     SEED_FLASH_BOOT+2   rjmp seedBootFill( address , word )
+ *     SEED_FLASH_BOOT+4   rjmp seedBootWritePage( address )
+ *     SEED_FLASH_BOOT+6   rjmp seedBootClearBuffer()
+ *     SEED_FLASH_BOOT+8   rjmp seedBootInstall( length )
+ *
+ * Before we stage anything we check that the version word in the tile's boot section matches ours. If it does not
+ * (an older writer, or no writer at all) the image still passes through, it just does not get installed.
+ * Change SEED_FLASH_BOOT_VERSION any time an entry moves or its arguments change, and only ever add entries at the end.
+ * There is room for 7 entries before the table runs into the code at SEED_FLASH_BOOT_CODE (the link fails if it does).
+ *
+ * We fill the chip's page buffer straight from each block as it arrives, so staging takes no RAM. The page gets
+ * erased and written when the last block for it comes in. Writing anything to EEPROM while an image is coming in
+ * would clear the page buffer, but the whole image CRC is checked again from flash before we install, so at worst the
+ * image just fails to install.
+ *
+ * Every flash function runs with interrupts off, since the vectors live in the application flash and can not be read
+ * while a page there is being written. A page erase and write takes about 9ms, so once every 8 blocks the display and
+ * the IR link miss a beat. The link resends whatever gets lost.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <avr/boot.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+
+#include "blinklib.h"
+
+#include "seed.h"
+
+#if SEED_FLASH
+
+#include "seedflash.h"
+
+#if ( SPM_PAGESIZE % SEED_BLOCK_SIZE ) || ( SEED_FLASH_STAGING % SPM_PAGESIZE ) || ( SEED_FLASH_BOOT % SPM_PAGESIZE )
+    #error The seed blocks and the staging area must line up with flash pages
+#endif
+
+#define BOOTSECTION __attribute__((section(".bootcode"),noinline,used))
+
+#define SEED_FLASH_BOOT_STR2(x) #x
+#define SEED_FLASH_BOOT_STR(x)  SEED_FLASH_BOOT_STR2(x)
+
+// Word address of jump table entry `n`, for calling through a function pointer
+
+#define SEED_FLASH_BOOT_ENTRY(n) ( ( SEED_FLASH_BOOT + 2 + ( (n) * 2 ) ) / 2 )
+
+typedef void (*bootfill_t)( uint16_t address , uint16_t word );
+typedef void (*bootwritepage_t)( uint16_t address );
+typedef void (*bootclearbuffer_t)(void);
+typedef void (*bootinstall_t)( uint16_t length ) __attribute__((noreturn));
+
+#define bootFill        ( (bootfill_t)        SEED_FLASH_BOOT_ENTRY(0) )
+#define bootWritePage   ( (bootwritepage_t)   SEED_FLASH_BOOT_ENTRY(1) )
+#define bootClearBuffer ( (bootclearbuffer_t) SEED_FLASH_BOOT_ENTRY(2) )
+#define bootInstall     ( (bootinstall_t)     SEED_FLASH_BOOT_ENTRY(3) )
+
+// The end of our own program in flash (code plus the starting values of variables), from the linker
+
+extern char __data_load_end[];
+
+static bool stagingFlag;                // Every block of this image so far made it into the staging area
+
+// The boot code. These are extern "C" so the jump table below can name them.
+
+extern "C" {
+
+// Load one word into the page buffer
+
+void BOOTSECTION seedBootFill( uint16_t address , uint16_t word ) {
+
+    uint8_t sreg = SREG;
+    cli();
+
+    boot_page_fill( address , word );
+
+    SREG = sreg;
+
+}
+
+// Erase the page and write the page buffer into it
+
+void BOOTSECTION seedBootWritePage( uint16_t address ) {
+
+    uint8_t sreg = SREG;
+    cli();
+
+    boot_page_erase( address );
+    boot_spm_busy_wait();
+
+    boot_page_write( address );
+    boot_spm_busy_wait();
+
+    boot_rww_enable();              // Lets us read (and run) the application flash again
+
+    SREG = sreg;
+
+}
+
+// Throw away anything in the page buffer
+
+void BOOTSECTION seedBootClearBuffer(void) {
+
+    uint8_t sreg = SREG;
+    cli();
+
+    boot_rww_enable();              // Setting RWWSRE also clears the page buffer
+
+    SREG = sreg;
+
+}
+
+// Copy the staging area down over the application and restart. This runs entirely in the boot section since the
+// application is gone by the time we finish.
+
+void BOOTSECTION __attribute__((noreturn)) seedBootInstall( uint16_t length ) {
+
+    cli();
+
+    for( uint16_t page=0; page < length; page += SPM_PAGESIZE ) {
+
+        for( uint8_t i=0; i < SPM_PAGESIZE; i += 2 ) {
+            boot_page_fill( page + i , pgm_read_word( SEED_FLASH_STAGING + page + i ) );
+        }
+
+        boot_page_erase( page );
+        boot_spm_busy_wait();
+
+        boot_page_write( page );
+        boot_spm_busy_wait();
+
+        boot_rww_enable();          // The erase and write lock the RWW section, and the next page gets read out of it
+
+    }
+
+    // Same as power_soft_reset(), but that lives in the flash we just wrote over
+
+    wdt_enable( WDTO_1S );
+    while (1);
+
+}
+
+// The jump table. The version word also keeps the linker from dropping the table, since we read it through this
+// symbol (see bootVersion()). Either way it is at SEED_FLASH_BOOT, which --section-start pins in every build.
+
+extern const uint16_t seedBootTable[];
+
+}
+
+asm (
+    "    .section .bootloader,\"ax\",@progbits\n"
+    "    .global seedBootTable\n"
+    "seedBootTable:\n"
+    "    .word " SEED_FLASH_BOOT_STR( SEED_FLASH_BOOT_VERSION ) "\n"
+    "    rjmp seedBootFill\n"
+    "    rjmp seedBootWritePage\n"
+    "    rjmp seedBootClearBuffer\n"
+    "    rjmp seedBootInstall\n"
+    "    .previous\n"
+);
+
+// The version of the flash writer that is actually in this tile's boot section, which is not necessarily ours
+
+static uint16_t bootVersion(void) {
+
+    return pgm_read_word( seedBootTable );
+
+}
+
+bool seedFlashBlock( uint16_t offset , const byte *data ) {
+
+    if ( offset == 0 ) {
+
+        // New image. We can only stage it if our own program ends below the staging area, and the tile has the
+        // flash writer that we know how to call.
+
+        stagingFlag = (uintptr_t) __data_load_end <= SEED_FLASH_STAGING && bootVersion() == SEED_FLASH_BOOT_VERSION;
+
+        if ( !stagingFlag ) {
+            return false;
+        }
+
+        bootClearBuffer();
+
+    }
+
+    if ( !stagingFlag || offset + SEED_BLOCK_SIZE > SEED_FLASH_MAX_LENGTH ) {
+        stagingFlag = false;
+        return false;
+    }
+
+    uint16_t address = SEED_FLASH_STAGING + offset;
+
+    for( uint8_t i=0; i < SEED_BLOCK_SIZE; i += 2 ) {
+        bootFill( address + i , data[i] | ( data[i+1] << 8 ) );
+    }
+
+    address += SEED_BLOCK_SIZE;
+
+    if ( address % SPM_PAGESIZE == 0 ) {
+        bootWritePage( address - SPM_PAGESIZE );
+    }
+
+    return true;
+
+}
+
+bool seedFlashFinish( uint16_t length ) {
+
+    if ( stagingFlag && length % SPM_PAGESIZE ) {
+        bootWritePage( SEED_FLASH_STAGING + ( length - ( length % SPM_PAGESIZE ) ) );
+    }
+
+    return stagingFlag;
+
+}
+
+void seedFlashInstall( uint16_t length ) {
+
+    bootInstall( length );
+
+}
+
+uint16_t getSeedImageLength(void) {
+
+    return (uintptr_t) __data_load_end;
+
+}
+
+#endif
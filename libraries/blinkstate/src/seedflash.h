@@ -0,0 +1,30 @@
+/*
+ * seedflash.h
+ *
+ * Staging and installing a seeded image. Only used by seed.cpp, and only with SEED_FLASH on.
+ *
+ * Blocks get written into the staging area (the top half of the application flash) as they arrive, so the
+ * program that is running and passing the image along is never touched. Once the whole image is in and checks
+ * out, seedFlashInstall() copies it down over the running program and restarts the tile.
+ *
+ */
+
+#ifndef SEEDFLASH_H_
+#define SEEDFLASH_H_
+
+// Write one block into the staging area. Blocks must come in order starting from offset 0.
+// Returns false if the block can not be staged (the image is too big, or our own program runs into the staging area),
+// in which case this image can not be installed.
+
+bool seedFlashBlock( uint16_t offset , const byte *data );
+
+// Write out whatever is left of the last page. Call once after the last block.
+// Returns false if any block could not be staged.
+
+bool seedFlashFinish( uint16_t length );
+
+// Copy the first `length` bytes of the staging area over our program and restart. Never returns.
+
+void seedFlashInstall( uint16_t length ) __attribute__((noreturn));
+
+#endif /* SEEDFLASH_H_ */
@@ -0,0 +1,312 @@
+/*
+ * timesync.cpp
+ *
+ * Keep a shared clock across a cluster.
+ *
+ * A timesync packet looks like...
+ *
+ *    PACKET_TYPE_TIMESYNC , time (4 bytes, LSB first) , smooth time (2 bytes, LSB first)
+ *
+ * ...where time is the sender's clusterMillis() at the moment the packet was queued, and smooth time is
+ * the same clock but without any of the forward jumps added in (see below).
+ *
+ * Our cluster time is kept as an anchor point plus a rate correction...
+ *
+ *    clusterMillis = anchorCluster + elapsed + ( elapsed * skew ) / 65536
+ *
+ * ...where elapsed is the millis() since the anchor was set. We re-anchor anytime we change the skew
+ * or jump forward so that the clock stays continuous.
+ *
+ * When a packet comes in, we first add on the time it spent on the wire (blinkstate tells us this).
+ * Then if the neighbor is ahead we jump forward to it. Packets that hit a hiccup on the link don't have a
+ * trustworthy age, so we just skip them.
+ *
+ * We also keep a sample of the neighbor's smooth time against our own millis() for each face. Once a sample
+ * is TIMESYNC_RATE_WINDOW_MS old, the difference tells us how fast the neighbor's clock runs compared to
+ * our millis(). If the neighbor is ahead of us we move our skew a quarter of the way towards theirs (or all the
+ * way if we are way off). If they are behind, we only move a sixteenth of the way. Without this, noise would
+ * make some tile a hair fast, everyone would follow it, then some other tile would end up a hair faster still,
+ * and the cluster would creep faster and faster.
+ *
+ * We use the smooth time here because a tile that is behind and keeps jumping forward would otherwise look
+ * like it was running fast, and the tiles it was following would speed up to match it, and so on forever.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blinklib.h"
+#include "blinkstate.h"
+
+#include "chainfunction.h"
+
+#include "timesync.h"
+
+#define TIMESYNC_PACKET_LEN 7
+
+// Keep skew within +/-25%. Two tiles can be 20% apart when one is 10% fast and the other is 10% slow.
+
+#define TIMESYNC_SKEW_MAX   (65536/4)
+
+// If we are following a neighbor whose rate is more than this far from ours (about 1.5%), just take their rate
+
+#define TIMESYNC_SKEW_SNAP  (65536/64)
+
+// Jumps bigger than this need to be seen twice before we believe them
+
+#define TIMESYNC_BIG_JUMP_MS 250
+
+#define ALL_FACES_MASK      (0b00111111)        // One bit per face
+
+// Our clock
+
+static uint32_t anchorLocal;            // millis() at the anchor
+static uint32_t anchorCluster;          // clusterMillis() at the anchor
+static int16_t skew;                    // Rate correction in 1/65536ths. Positive means our cluster clock runs faster than millis()
+static uint16_t jumpTotal;              // Sum of all the forward jumps. Smooth time is clusterMillis() minus this.
+
+// When to next send our time to the neighbors
+
+static uint32_t nextSendTime;
+static byte sendMask;                   // Faces we still need to send on this round
+
+// Per-neighbor samples used to estimate their rate
+
+typedef struct {
+    uint32_t sampleLocal;               // Our millis() when we took the sample. 0=no sample.
+    uint16_t sampleSmooth;              // Their smooth time at that moment
+    int32_t bigJumpBehind;              // A big jump from this neighbor waiting for a second opinion. 0=none.
+} timesyncface_t;
+
+static timesyncface_t faceSamples[FACE_COUNT];
+
+static uint32_t clusterMillisAt( uint32_t now ) {
+
+    int32_t elapsed = now - anchorLocal;
+
+    return anchorCluster + elapsed + ( ( elapsed * skew ) >> 16 );
+
+}
+
+// Move the anchor up to now. Must be done before changing the skew or else the clock would jump.
+// Also keeps `elapsed * skew` from overflowing.
+
+static void reanchor( uint32_t now ) {
+
+    anchorCluster = clusterMillisAt( now );
+    anchorLocal   = now;
+
+}
+
+// Update our rate estimate for the neighbor on this face with a new reading of its smooth clock
+
+static void updateRate( byte face , uint32_t now , uint16_t theirSmooth , bool followFlag ) {
+
+    timesyncface_t *fs = &faceSamples[face];
+
+    if (fs->sampleLocal) {
+
+        int32_t ourElapsed = now - fs->sampleLocal;
+
+        if ( ourElapsed < TIMESYNC_RATE_WINDOW_MS ) {
+            return;                     // Keep waiting for a long enough baseline
+        }
+
+        int32_t drift = (uint16_t) ( theirSmooth - fs->sampleSmooth ) - ourElapsed;
+
+        // Skip readings that are way out of range. These happen when a sample gets too old to
+        // fit in 16 bits, and would overflow the math below anyway.
+
+        if ( ourElapsed < TIMESYNC_RATE_WINDOW_MS * 2 && drift < ourElapsed/4 && drift > -ourElapsed/4 ) {
+
+            int16_t theirSkew = ( drift * 65536L ) / ourElapsed;
+
+            reanchor( now );
+
+            int32_t error = theirSkew - skew;
+
+            if ( followFlag && ( error > TIMESYNC_SKEW_SNAP || error < -TIMESYNC_SKEW_SNAP ) ) {
+                skew = theirSkew;                       // Way off, so just take it. This gets us locked in quickly at power up.
+            } else if (followFlag) {
+                skew += error / 4;
+            } else {
+                skew += error / 16;
+            }
+
+            if (skew > TIMESYNC_SKEW_MAX) {
+                skew = TIMESYNC_SKEW_MAX;
+            } else if (skew < -TIMESYNC_SKEW_MAX) {
+                skew = -TIMESYNC_SKEW_MAX;
+            }
+
+        }
+
+    }
+
+    fs->sampleLocal   = now | 1;        // Never 0 so we can tell it is valid
+    fs->sampleSmooth  = theirSmooth;
+
+}
+
+// Called for every packet received by blinkstate
+
+static void timeSyncOnPacket( byte face , const byte *data , byte len ) {
+
+    if ( data[0]!=PACKET_TYPE_TIMESYNC || len!=TIMESYNC_PACKET_LEN ) {
+        return;
+    }
+
+    uint32_t now = millis();
+
+    uint32_t theirTime   = (uint32_t) data[1] | ( (uint32_t) data[2] << 8 ) | ( (uint32_t) data[3] << 16 ) | ( (uint32_t) data[4] << 24 );
+    uint16_t theirSmooth = data[5] | ( data[6] << 8 );
+
+    // Account for the time the packet spent on the wire, in cluster time
+
+    uint16_t age = getPacketAge_ms();
+
+    if (age == PACKET_AGE_UNKNOWN) {
+        return;                         // Link hiccuped so we can't trust the timing on this one. Another will be along shortly.
+    }
+
+    age += ( (int32_t) age * skew ) >> 16;
+
+    theirTime   += age;
+    theirSmooth += age;
+
+    int32_t behind = theirTime - clusterMillisAt( now );
+
+    timesyncface_t *fs = &faceSamples[face];
+
+    if ( behind > TIMESYNC_BIG_JUMP_MS ) {
+
+        // A garbled packet that slips past the check could send the whole cluster flying forward, and we can never
+        // take that back. So big jumps need a second packet from the same face that agrees with the first one.
+
+        int32_t diff = behind - fs->bigJumpBehind;
+
+        if ( diff > TIMESYNC_BIG_JUMP_MS || diff < -TIMESYNC_BIG_JUMP_MS ) {
+
+            fs->bigJumpBehind = behind;
+
+            sendMask |= 1<<face;        // Our time will look way behind to them, so they will answer right away
+
+            return;
+
+        }
+
+    } else if ( behind < -TIMESYNC_BIG_JUMP_MS ) {
+
+        sendMask |= 1<<face;            // They are way behind us, so give them a quick second opinion
+
+    }
+
+    fs->bigJumpBehind = 0;              // Either confirmed or they changed their mind
+
+    updateRate( face , now , theirSmooth , behind > 0 );
+
+    if (behind > 0) {
+
+        // They are ahead of us, so jump forward to them and pass the news on
+
+        anchorCluster = theirTime;
+        anchorLocal   = now;
+
+        jumpTotal += behind;
+
+        sendMask = ALL_FACES_MASK;
+
+    }
+
+}
+
+// Send our time to any neighbors that are due
+
+static void timeSyncOnLoop(void) {
+
+    uint32_t now = millis();
+
+    if ( now - anchorLocal > TIMESYNC_RATE_WINDOW_MS ) {
+        reanchor( now );                // Keep `elapsed` small
+    }
+
+    if ( (int32_t) ( now - nextSendTime ) >= 0 ) {
+        sendMask = ALL_FACES_MASK;
+        nextSendTime = now + TIMESYNC_PERIOD_MS;
+    }
+
+    FOREACH_FACE(f) {
+
+        if ( isValueReceivedOnFaceExpired(f) ) {
+
+            // Note that we keep the rate sample since a lost symbol can make a face blink out for a moment.
+            // If a different tile shows up here, its first reading will almost always be way out of range and get tossed.
+
+            sendMask &= ~(1<<f);
+
+        } else if ( sendMask & (1<<f) ) {
+
+            uint32_t t = clusterMillisAt( now );
+            uint16_t smooth = t - jumpTotal;
+
+            byte packet[TIMESYNC_PACKET_LEN] = { PACKET_TYPE_TIMESYNC , (byte) t , (byte) (t >> 8) , (byte) (t >> 16) , (byte) (t >> 24) , (byte) smooth , (byte) (smooth >> 8) };
+
+            if ( sendPacketOnFace( f , packet , TIMESYNC_PACKET_LEN ) ) {
+                sendMask &= ~(1<<f);
+            }
+
+        }
+
+    }
+
+}
+
+// Make a record to add to the callback chain
+
+static struct chainfunction_struct timeSyncOnLoopChain = {
+     .callback = timeSyncOnLoop,
+     .next     = NULL                  // This is a waste because it gets overwritten, but no way to make this un-initialized in C
+};
+
+static packethandler_t timeSyncOnPacketChain = {
+     .callback = timeSyncOnPacket,
+     .next     = NULL
+};
+
+// Same hack as blinkstate - we hook in the first time any timesync function is called
+
+static uint8_t hookRegisteredFlag=0;        // Did we already register?
+
+static void registerHook(void) {
+    if (!hookRegisteredFlag) {
+        blinkStateBegin();                  // We ride on blinkstate packets, so make sure its loop hook is running
+        addOnLoop( &timeSyncOnLoopChain );
+        addOnPacket( &timeSyncOnPacketChain );
+        hookRegisteredFlag=1;
+    }
+}
+
+unsigned long clusterMillis(void) {
+
+    registerHook();
+
+    return clusterMillisAt( millis() );
+
+}
+
+byte timeSyncNeighborCount(void) {
+
+    registerHook();
+
+    byte count=0;
+
+    FOREACH_FACE(f) {
+        if ( faceSamples[f].sampleLocal && !isValueReceivedOnFaceExpired(f) ) {
+            count++;
+        }
+    }
+
+    return count;
+
+}
@@ -0,0 +1,56 @@
+/*
+ * timesync.h
+ *
+ * Shared cluster time.
+ *
+ * The millis() clock on each tile can be off by as much as +/-10%, so two tiles that start an animation
+ * at the same time will be visibly out of step after just a few seconds. This service has neighboring tiles
+ * swap timestamps so that every tile in a cluster agrees on a single clock, which you read with clusterMillis().
+ *
+ * Each tile keeps its cluster time as a rate and an offset from its own millis() clock...
+ *
+ *   (1) The offset follows the maximum. If a neighbor is ahead of us, we jump forward to match it. We never
+ *       jump backwards, so clusterMillis() never goes backwards, and the whole cluster ends up on the time of
+ *       whichever tile was furthest ahead.
+ *
+ *   (2) The rate follows the neighbors. We watch how fast each neighbor's cluster time runs against our own
+ *       millis() clock and nudge our rate towards theirs, so the clocks stay together between updates.
+ *
+ * When two clusters are joined, the one that is behind jumps forward to the other. Big jumps have to be
+ * seen twice before a tile believes them, so this takes a couple of packets per tile of distance.
+ *
+ * Note that this service talks to neighbors with blinkstate packets, so updates
+ * only happen when loop() returns.
+ * The first call to any function here runs blinkStateBegin() for you, so there is nothing else to set up.
+ *
+ */
+
+#ifndef TIMESYNC_H_
+#define TIMESYNC_H_
+
+#ifndef BLINKLIB_H_
+    #error You must #include blinklib.h before timesync.h
+#endif
+
+// How often we send our cluster time to each neighbor.
+// We also send right away anytime we jump forward so news travels quickly.
+
+#define TIMESYNC_PERIOD_MS          1000
+
+// How long we watch a neighbor's clock before we trust our estimate of its rate.
+// Longer is more accurate but slower to lock in.
+
+#define TIMESYNC_RATE_WINDOW_MS     4000
+
+// Number of milliseconds since power up on the shared cluster clock.
+// Starts out the same as millis() and then gets pulled into step with the neighbors.
+// Never goes backwards, but can jump forward when we learn that the cluster is ahead of us.
+
+unsigned long clusterMillis(void);
+
+// How many faces have a neighbor whose clock we are currently tracking.
+// 0 means we are on our own and clusterMillis() is just our own clock.
+
+byte timeSyncNeighborCount(void);
+
+#endif /* TIMESYNC_H_ */